@@ -84,10 +84,18 @@ extensions = [
             "src/columnindexingscheme.cpp",
             "src/entry.cpp",
             "src/graycodes.cpp",
+            "src/bitgather.cpp",
+            "src/scratchmemory.cpp",
             "src/read.cpp",
             "src/readset.cpp",
             "src/columniterator.cpp",
+            "src/columnsource.cpp",
             "src/indexset.cpp",
+            "src/componentfinder.cpp",
+            "src/geneticmap.cpp",
+            "src/phasedblocks.cpp",
+            "src/readbuilder.cpp",
+            "src/readmerger.cpp",
             "src/genotype.cpp",
             "src/binomial.cpp",
             "src/pedigreepartitions.cpp",
@@ -117,6 +125,7 @@ extensions = [
     CppExtension("whatshap.priorityqueue", sources=["whatshap/priorityqueue.pyx"]),
     CppExtension("whatshap.align", sources=["whatshap/align.pyx"]),
     CppExtension("whatshap._variants", sources=["whatshap/_variants.pyx"]),
+    CppExtension("whatshap._pileup", sources=["whatshap/_pileup.pyx"]),
 ]
 
 
@@ -176,7 +185,6 @@ else:
     install_requires = [
         "pysam~=0.16.0",
         "pyfaidx>=0.5.5.2",
-        "networkx",
         "biopython>=1.73",  # pyfaidx needs this for reading bgzipped FASTA files
         "scipy",
         "xopen",
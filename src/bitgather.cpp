@@ -0,0 +1,113 @@
+#include <cstdint>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_PEXT_DISPATCH
+#include <immintrin.h>
+#endif
+
+#include "bitgather.h"
+
+using namespace std;
+
+int count_trailing_zeros(unsigned long long x) {
+#ifdef __GNUC__
+	return __builtin_ctzll(x);
+#else
+	int n = 0;
+	while ((x & 1) == 0) {
+		x >>= 1;
+		n += 1;
+	}
+	return n;
+#endif
+}
+
+
+int count_bits(unsigned int x) {
+#ifdef __GNUC__
+	return __builtin_popcount(x);
+#else
+	int n = 0;
+	for (; x != 0; x &= x - 1) {
+		n += 1;
+	}
+	return n;
+#endif
+}
+
+
+namespace {
+
+/** For each pair of a mask byte and a value byte, the gathered bits. */
+class ByteGatherTable {
+public:
+	ByteGatherTable() : table(256 * 256) {
+		for (unsigned int mask = 0; mask < 256; ++mask) {
+			for (unsigned int value = 0; value < 256; ++value) {
+				uint8_t result = 0;
+				int k = 0;
+				for (int bit = 0; bit < 8; ++bit) {
+					if (mask & (1u << bit)) {
+						if (value & (1u << bit)) {
+							result |= 1u << k;
+						}
+						k += 1;
+					}
+				}
+				table[(mask << 8) | value] = result;
+			}
+		}
+	}
+
+	uint8_t get(unsigned int mask, unsigned int value) const {
+		return table[(mask << 8) | value];
+	}
+
+private:
+	vector<uint8_t> table;
+};
+
+const ByteGatherTable byte_gather_table;
+
+typedef unsigned int (*gather_function_t)(unsigned int, unsigned int);
+
+#ifdef HAVE_PEXT_DISPATCH
+__attribute__((target("bmi2")))
+unsigned int gather_bits_pext(unsigned int value, unsigned int mask) {
+	return _pext_u32(value, mask);
+}
+#endif
+
+gather_function_t select_gather_function() {
+#ifdef HAVE_PEXT_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("bmi2")) {
+		return gather_bits_pext;
+	}
+#endif
+	return gather_bits_portable;
+}
+
+const gather_function_t gather_function = select_gather_function();
+
+}
+
+
+unsigned int gather_bits_portable(unsigned int value, unsigned int mask) {
+	unsigned int result = 0;
+	int shift = 0;
+	for (; mask != 0; mask >>= 8, value >>= 8) {
+		unsigned int mask_byte = mask & 0xff;
+		if (mask_byte != 0) {
+			result |= ((unsigned int)byte_gather_table.get(mask_byte, value & 0xff)) << shift;
+			shift += count_bits(mask_byte);
+		}
+	}
+	return result;
+}
+
+
+unsigned int gather_bits(unsigned int value, unsigned int mask) {
+	return gather_function(value, mask);
+}
@@ -0,0 +1,21 @@
+#ifndef BITGATHER_H
+#define BITGATHER_H
+
+/** Bit manipulation helpers used for indexing DP columns. */
+
+/** Returns the number of trailing zero bits of x, which must not be zero. */
+int count_trailing_zeros(unsigned long long x);
+
+/** Returns the number of bits set in x. */
+int count_bits(unsigned int x);
+
+/** Gathers the bits of value selected by mask into the low-order bits of the result,
+ *  preserving their order (like the PEXT instruction). PEXT is used if the CPU supports
+ *  it (checked at runtime), otherwise a table-driven implementation.
+ */
+unsigned int gather_bits(unsigned int value, unsigned int mask);
+
+/** Table-driven implementation of gather_bits, exposed for testing. */
+unsigned int gather_bits_portable(unsigned int value, unsigned int mask);
+
+#endif
@@ -1,6 +1,7 @@
 #include <cassert>
 #include "columnindexingscheme.h"
 #include "columnindexingiterator.h"
+#include "bitgather.h"
 
 using namespace std;
 
@@ -35,12 +36,11 @@ void ColumnIndexingIterator::advance(int* bit_changed) {
 			forward_projection = 0;
 		}
 	} else {
-		if (parent->forward_projection_mask != 0) {
-			// index of bit in the forward_projection
-			int bit_index = parent->forward_projection_mask->at(graycode_bit_changed);
-			if (bit_index >= 0) {
-				forward_projection = forward_projection ^ (((unsigned int)1) << bit_index);
-			}
+		unsigned int bit = ((unsigned int)1) << graycode_bit_changed;
+		if ((parent->forward_projection_bits & bit) != 0) {
+			// index of bit in the forward_projection: number of shared reads before it
+			int bit_index = count_bits(parent->forward_projection_bits & (bit - 1));
+			forward_projection = forward_projection ^ (((unsigned int)1) << bit_index);
 		}
 	}
 	if (bit_changed != 0) {
@@ -57,7 +57,7 @@ unsigned int ColumnIndexingIterator::get_forward_projection() {
 
 unsigned int ColumnIndexingIterator::get_backward_projection() {
 	assert(index >= 0);
-	return index & ((((unsigned int)1)<<parent->backward_projection_width) - 1);
+	return index & parent->backward_projection_bits;
 }
 
 
@@ -74,26 +74,15 @@ unsigned int ColumnIndexingIterator::get_partition() {
 
 
 unsigned int ColumnIndexingIterator::index_backward_projection(unsigned int i) {
-	assert(i >= 0); // assert the proper boundaries
 	assert(i < (((unsigned int)1) << parent->read_ids.size()));
 
-	return i & ((((unsigned int)1) << parent->backward_projection_width) -1);
+	return i & parent->backward_projection_bits;
 }
 
 
 unsigned int ColumnIndexingIterator::index_forward_projection(unsigned int i) {
-	assert(i >= 0);
 	assert(i < (((unsigned int)1) << parent->read_ids.size()));
+	assert(parent->forward_projection_mask != 0);
 
-	unsigned int i_forward_projection = 0;
-	unsigned int s = 1;
-	for(int j=0; j< parent->read_ids.size(); ++j) {
-		unsigned int m = parent->forward_projection_mask->at(j);
-		if(m != -1) {
-			unsigned int s = (((unsigned int)1) << m);
-			i_forward_projection += (s&i);
-		}
-	}
-
-	return i_forward_projection;
+	return gather_bits(i, parent->forward_projection_bits);
 }
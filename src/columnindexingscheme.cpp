@@ -16,6 +16,8 @@ ColumnIndexingScheme::ColumnIndexingScheme(const ColumnIndexingScheme* previous_
 	this->forward_projection_mask = 0;
 	this->backward_projection_width = 0;
 	this->forward_projection_width = 0;
+	this->forward_projection_bits = 0;
+	this->backward_projection_bits = 0;
 	if (previous_column != 0) {
 		int i = 0;
 		int j = 0;
@@ -30,6 +32,7 @@ ColumnIndexingScheme::ColumnIndexingScheme(const ColumnIndexingScheme* previous_
 				j += 1;
 			}
 		}
+		backward_projection_bits = (((unsigned int)1) << backward_projection_width) - 1;
 	}
 }
 
@@ -39,13 +42,14 @@ ColumnIndexingScheme::~ColumnIndexingScheme() {
 }
 
 
-unsigned int ColumnIndexingScheme::column_size() {
-	return ((unsigned int)1) << read_ids.size();
+size_t ColumnIndexingScheme::column_size() {
+	return ((size_t)1) << read_ids.size();
 }
 
 
-unsigned int ColumnIndexingScheme::forward_projection_size() {
-	return ((unsigned int)1) << forward_projection_mask->size();
+size_t ColumnIndexingScheme::forward_projection_size() {
+	assert(forward_projection_mask != 0);
+	return ((size_t)1) << (forward_projection_width - 1);
 }
 
 
@@ -64,6 +68,7 @@ void ColumnIndexingScheme::set_next_column(const ColumnIndexingScheme* next_colu
 	this->next_column = next_column;
 	if (forward_projection_mask != 0) delete forward_projection_mask;
 	forward_projection_width = 0;
+	forward_projection_bits = 0;
 	forward_projection_mask = new vector<unsigned int>(read_ids.size(),-1);
 	int i = 0;
 	int j = 0;
@@ -71,6 +76,7 @@ void ColumnIndexingScheme::set_next_column(const ColumnIndexingScheme* next_colu
 	while ((i<next_column->read_ids.size()) && (j<read_ids.size())) {
 		if (next_column->read_ids[i] == read_ids[j]) {
 			forward_projection_mask->at(j) = n;
+			forward_projection_bits |= ((unsigned int)1) << j;
 			n += 1;
 			i += 1;
 			j += 1;
@@ -14,6 +14,9 @@ private:
 	unsigned int backward_projection_width;
 	unsigned int forward_projection_width;
 	std::vector<unsigned int>* forward_projection_mask;
+	// bits of a row index that belong to reads shared with the next/previous column
+	unsigned int forward_projection_bits;
+	unsigned int backward_projection_bits;
 
 public:
 
@@ -30,9 +33,11 @@ public:
 
 	std::unique_ptr<ColumnIndexingIterator> get_iterator();
 
-	unsigned int column_size();
+	/** Number of rows (bipartitions) of the column. */
+	size_t column_size();
 
-	unsigned int forward_projection_size();
+	/** Number of rows of the projection onto the reads shared with the next column. */
+	size_t forward_projection_size();
  
 	unsigned int get_forward_projection_width();
 
@@ -0,0 +1,120 @@
+#include <cassert>
+#include <stdexcept>
+
+#include "columnsource.h"
+
+using namespace std;
+
+ColumnSource::ColumnSource(const ReadSet& set, const std::vector<unsigned int>* positions) : set(set) {
+	if (positions == nullptr) {
+		unique_ptr<vector<unsigned int> > all_positions(set.get_positions());
+		this->positions = *all_positions;
+	} else {
+		this->positions.assign(positions->begin(), positions->end());
+	}
+
+	// one blank entry per read, handed out whenever a read spans a column it does not cover
+	int pos = 0;
+	blank_entries.reserve(set.size());
+	for (size_t i=0; i<set.size(); ++i) {
+		const Read* read = set.get(i);
+		if (read->firstPosition() < pos) {
+			throw std::runtime_error("ColumnSource: reads in ReadSet are not sorted.");
+		}
+		if (!read->isSorted()) {
+			throw std::runtime_error("ColumnSource: encountered read with unsorted variants.");
+		}
+		blank_entries.emplace_back(new Entry(read->getID(), Entry::BLANK, 0));
+		pos = read->firstPosition();
+	}
+
+	// sweep over all columns once, keeping track of the reads that are currently active
+	// and of the next entry of each of them
+	offsets.reserve(this->positions.size() + 1);
+	offsets.push_back(0);
+	vector<size_t> active_reads;
+	vector<size_t> active_entries;
+	size_t next_read_index = 0;
+	for (size_t n=0; n<this->positions.size(); ++n) {
+		int next_pos = this->positions[n];
+		size_t kept = 0;
+		for (size_t j=0; j<active_reads.size(); ++j) {
+			const Read* read = set.get(active_reads[j]);
+			if (read->lastPosition() < next_pos) {
+				continue;
+			}
+			size_t active_entry = active_entries[j];
+			while (read->getPosition(active_entry) < next_pos) {
+				active_entry += 1;
+				assert(active_entry < read->getVariantCount());
+			}
+			active_reads[kept] = active_reads[j];
+			active_entries[kept] = active_entry;
+			kept += 1;
+		}
+		active_reads.resize(kept);
+		active_entries.resize(kept);
+
+		while (next_read_index < set.size()) {
+			int read_start = set.get(next_read_index)->firstPosition();
+			if (read_start == next_pos) {
+				active_reads.push_back(next_read_index);
+				active_entries.push_back(0);
+				next_read_index += 1;
+			} else {
+				assert(read_start > next_pos);
+				break;
+			}
+		}
+
+		for (size_t j=0; j<active_reads.size(); ++j) {
+			const Read* read = set.get(active_reads[j]);
+			if (read->getPosition(active_entries[j]) == next_pos) {
+				entries.push_back(read->getEntry(active_entries[j]));
+			} else {
+				entries.push_back(blank_entries[active_reads[j]].get());
+			}
+		}
+		offsets.push_back(entries.size());
+	}
+	entries.shrink_to_fit();
+}
+
+
+unsigned int ColumnSource::get_column_count() const {
+	return positions.size();
+}
+
+
+unsigned int ColumnSource::get_read_count() const {
+	return set.size();
+}
+
+
+const vector<unsigned int>* ColumnSource::get_positions() const {
+	return &positions;
+}
+
+
+size_t ColumnSource::get_column_size(size_t k) const {
+	assert(k < positions.size());
+	return offsets[k+1] - offsets[k];
+}
+
+
+const Entry* const* ColumnSource::column_begin(size_t k) const {
+	assert(k < positions.size());
+	return entries.data() + offsets[k];
+}
+
+
+unique_ptr<vector<const Entry*> > ColumnSource::get_column(size_t k) const {
+	assert(k < positions.size());
+	return unique_ptr<vector<const Entry*> >(new vector<const Entry*>(entries.begin() + offsets[k], entries.begin() + offsets[k+1]));
+}
+
+shared_ptr<const ColumnSource> make_column_source(ReadSet* read_set, const vector<unsigned int>* positions) {
+	// blank entries in the columns carry read ids, so these need to be assigned first
+	read_set->reassignReadIds();
+	return make_shared<const ColumnSource>(*read_set, positions);
+}
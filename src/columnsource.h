@@ -0,0 +1,47 @@
+#ifndef COLUMNSOURCE_H
+#define COLUMNSOURCE_H
+
+#include <vector>
+#include <memory>
+
+#include "entry.h"
+#include "readset.h"
+
+/** Immutable, random-access view of the columns of the input matrix.
+ *
+ *  All columns are computed once on construction and stored contiguously (entries of
+ *  column k are found at offsets[k] to offsets[k+1]). Reads that are active in a column but
+ *  do not cover it contribute a blank entry; there is one such entry per read.
+ *  Since the object is never modified after construction, it can be shared by any number
+ *  of iterators and threads. Blank entries take the read ids at construction time, so
+ *  ReadSet::reassignReadIds() must be called before, not after, creating the source.
+ */
+class ColumnSource {
+public:
+	ColumnSource(const ReadSet& set, const std::vector<unsigned int>* positions = nullptr);
+	/** Returns the total number of columns. */
+	unsigned int get_column_count() const;
+	/** Returns the total number of reads. */
+	unsigned int get_read_count() const;
+	const std::vector<unsigned int>* get_positions() const;
+	/** Returns the number of entries in column k. */
+	size_t get_column_size(size_t k) const;
+	/** Returns a pointer to the first entry of column k; get_column_size(k) entries follow.
+	 *  Entries are owned by the ReadSet or by this ColumnSource. */
+	const Entry* const* column_begin(size_t k) const;
+	/** Returns a copy of column k. */
+	std::unique_ptr<std::vector<const Entry*> > get_column(size_t k) const;
+
+private:
+	const ReadSet& set;
+	std::vector<unsigned int> positions;
+	std::vector<size_t> offsets;
+	std::vector<const Entry*> entries;
+	std::vector<std::unique_ptr<Entry> > blank_entries;
+};
+
+/** Assigns read ids to the reads of read_set (see above) and creates a ColumnSource for it
+ *  that can be shared by the column iterators of a DP table. */
+std::shared_ptr<const ColumnSource> make_column_source(ReadSet* read_set, const std::vector<unsigned int>* positions = nullptr);
+
+#endif
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include "componentfinder.h"
+
+using namespace std;
+
+ComponentFinder::ComponentFinder(const vector<unsigned int>& positions) : positions(positions) {
+	sort(this->positions.begin(), this->positions.end());
+	this->positions.erase(unique(this->positions.begin(), this->positions.end()), this->positions.end());
+	size_t n = this->positions.size();
+	parent.resize(n);
+	smallest.resize(n);
+	rank.assign(n, 0);
+	for (size_t i = 0; i < n; ++i) {
+		parent[i] = i;
+		smallest[i] = i;
+	}
+}
+
+
+size_t ComponentFinder::size() const {
+	return positions.size();
+}
+
+
+int ComponentFinder::indexOf(unsigned int position) const {
+	vector<unsigned int>::const_iterator it = lower_bound(positions.begin(), positions.end(), position);
+	if ((it == positions.end()) || (*it != position)) {
+		return -1;
+	}
+	return it - positions.begin();
+}
+
+
+uint32_t ComponentFinder::findIndex(uint32_t index) {
+	uint32_t root = index;
+	while (parent[root] != root) {
+		root = parent[root];
+	}
+	// path compression
+	while (parent[index] != root) {
+		uint32_t next = parent[index];
+		parent[index] = root;
+		index = next;
+	}
+	return root;
+}
+
+
+void ComponentFinder::mergeIndices(uint32_t index1, uint32_t index2) {
+	uint32_t root1 = findIndex(index1);
+	uint32_t root2 = findIndex(index2);
+	if (root1 == root2) {
+		return;
+	}
+	// union by rank
+	if (rank[root1] < rank[root2]) {
+		swap(root1, root2);
+	}
+	parent[root2] = root1;
+	if (rank[root1] == rank[root2]) {
+		rank[root1] += 1;
+	}
+	smallest[root1] = min(smallest[root1], smallest[root2]);
+}
+
+
+void ComponentFinder::merge(unsigned int position1, unsigned int position2) {
+	int index1 = indexOf(position1);
+	int index2 = indexOf(position2);
+	if ((index1 < 0) || (index2 < 0)) {
+		return;
+	}
+	mergeIndices(index1, index2);
+}
+
+
+unsigned int ComponentFinder::find(unsigned int position) {
+	int index = indexOf(position);
+	if (index < 0) {
+		throw std::runtime_error("ComponentFinder::find: unknown position.");
+	}
+	return positions[smallest[findIndex(index)]];
+}
+
+
+void ComponentFinder::restrictToHeterozygous(int sample_id, const vector<unsigned int>& positions) {
+	vector<bool>& mask = heterozygous[sample_id];
+	mask.assign(this->positions.size(), false);
+	for (unsigned int position : positions) {
+		int index = indexOf(position);
+		if (index >= 0) {
+			mask[index] = true;
+		}
+	}
+}
+
+
+void ComponentFinder::restrictToHeterozygous(int sample_id, const ReadSet& superreads, vector<unsigned int>* homozygous) {
+	if (superreads.size() != 2) {
+		throw std::runtime_error("ComponentFinder::restrictToHeterozygous: expected two super reads.");
+	}
+	const Read* read1 = superreads.get(0);
+	const Read* read2 = superreads.get(1);
+	assert(read1->getVariantCount() == read2->getVariantCount());
+	vector<bool>& mask = heterozygous[sample_id];
+	mask.assign(positions.size(), false);
+	for (int i = 0; i < read1->getVariantCount(); ++i) {
+		assert(read1->getPosition(i) == read2->getPosition(i));
+		int index = indexOf(read1->getPosition(i));
+		if (index < 0) {
+			continue;
+		}
+		int allele1 = read1->getAllele(i);
+		int allele2 = read2->getAllele(i);
+		if ((allele1 < 0) || (allele1 > 1) || (allele2 < 0) || (allele2 > 1)) {
+			continue;
+		}
+		if (allele1 != allele2) {
+			mask[index] = true;
+		} else if (homozygous != nullptr) {
+			homozygous->push_back(positions[index]);
+		}
+	}
+}
+
+
+void ComponentFinder::addReads(const ReadSet& reads) {
+	bool restricted = !heterozygous.empty();
+	for (size_t i = 0; i < reads.size(); ++i) {
+		const Read* read = reads.get(i);
+		const vector<bool>* mask = nullptr;
+		if (restricted) {
+			unordered_map<int, vector<bool> >::const_iterator it = heterozygous.find(read->getSampleID());
+			if (it == heterozygous.end()) {
+				continue;
+			}
+			mask = &(it->second);
+		}
+		int first = -1;
+		for (int j = 0; j < read->getVariantCount(); ++j) {
+			int index = indexOf(read->getPosition(j));
+			if ((index < 0) || ((mask != nullptr) && !(*mask)[index])) {
+				continue;
+			}
+			if (first < 0) {
+				first = index;
+			} else {
+				mergeIndices(first, index);
+			}
+		}
+	}
+}
+
+
+void ComponentFinder::mergeBlock(const vector<unsigned int>& positions) {
+	int first = -1;
+	for (unsigned int position : positions) {
+		int index = indexOf(position);
+		if (index < 0) {
+			continue;
+		}
+		if (first < 0) {
+			first = index;
+		} else {
+			mergeIndices(first, index);
+		}
+	}
+}
+
+
+vector<unsigned int> ComponentFinder::getComponents() {
+	vector<unsigned int> result(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i) {
+		result[i] = positions[smallest[findIndex(i)]];
+	}
+	return result;
+}
@@ -0,0 +1,65 @@
+#ifndef COMPONENTFINDER_H
+#define COMPONENTFINDER_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "readset.h"
+
+/** Finds connected components of variant positions, i.e. phased blocks.
+ *
+ *  Positions are mapped to dense indices and partitioned using union-find with
+ *  path compression and union by rank. Each set additionally remembers its
+ *  smallest index, so that a component is identified by its leftmost position.
+ */
+class ComponentFinder {
+public:
+	/** @param positions Variant positions; need not be sorted and may contain duplicates. */
+	ComponentFinder(const std::vector<unsigned int>& positions);
+
+	/** Returns the number of distinct positions. */
+	size_t size() const;
+
+	/** Returns the dense index of the given position or -1 if it is unknown. */
+	int indexOf(unsigned int position) const;
+
+	/** Merges the components containing the two given positions. Unknown positions are ignored. */
+	void merge(unsigned int position1, unsigned int position2);
+
+	/** Returns the leftmost position of the component containing the given position. */
+	unsigned int find(unsigned int position);
+
+	/** Restrict merging by reads of the given sample to the given positions.
+	 *  Reads of samples for which no restriction has been set are then ignored.
+	 */
+	void restrictToHeterozygous(int sample_id, const std::vector<unsigned int>& positions);
+
+	/** Same as restrictToHeterozygous(), but derive the heterozygous positions from a pair of
+	 *  super reads. Positions at which both super reads carry the same allele (0 or 1) are
+	 *  appended to homozygous.
+	 */
+	void restrictToHeterozygous(int sample_id, const ReadSet& superreads, std::vector<unsigned int>* homozygous);
+
+	/** Merges all positions covered by a read into one component. */
+	void addReads(const ReadSet& reads);
+
+	/** Merges all given positions into one component. */
+	void mergeBlock(const std::vector<unsigned int>& positions);
+
+	/** Returns, for each position in ascending order, the leftmost position of its component. */
+	std::vector<unsigned int> getComponents();
+
+private:
+	uint32_t findIndex(uint32_t index);
+	void mergeIndices(uint32_t index1, uint32_t index2);
+
+	std::vector<unsigned int> positions;
+	std::vector<uint32_t> parent;
+	std::vector<uint8_t> rank;
+	// smallest index in the set, valid for root entries only
+	std::vector<uint32_t> smallest;
+	std::unordered_map<int, std::vector<bool> > heterozygous;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+#include "geneticmap.h"
+
+using namespace std;
+
+GeneticMap::GeneticMap(const vector<unsigned int>& positions, const vector<double>& cumulative_distances) :
+	positions(positions),
+	distances(cumulative_distances)
+{
+	if (positions.empty()) {
+		throw invalid_argument("Genetic map must not be empty");
+	}
+	if (positions.size() != cumulative_distances.size()) {
+		throw invalid_argument("Genetic map needs one cumulative distance per position");
+	}
+	if (!is_sorted(positions.begin(), positions.end())) {
+		throw invalid_argument("Positions of genetic map must be sorted");
+	}
+}
+
+
+size_t GeneticMap::size() const {
+	return positions.size();
+}
+
+
+static double interpolate(unsigned int point, unsigned int start_pos, unsigned int end_pos, double start_value, double end_value) {
+	assert(start_pos <= point && point <= end_pos);
+	if (start_pos == end_pos) {
+		return start_value;
+	}
+	return start_value + (double(point - start_pos) * (end_value - start_value) / double(end_pos - start_pos));
+}
+
+
+vector<double> GeneticMap::cumulative_distances(const vector<unsigned int>& query) const {
+	vector<double> result;
+	result.reserve(query.size());
+	const size_t n = positions.size();
+	const double average_rate = distances[n - 1] / positions[n - 1];
+	// j is the first map entry with a position not smaller than the current position;
+	// since the positions are sorted, it only moves forward.
+	size_t j = 0;
+	for (unsigned int position : query) {
+		while (j < n && positions[j] < position) {
+			++j;
+		}
+		if (j == n) {
+			// Right of the map: extrapolate using the average recombination rate
+			result.push_back(distances[n - 1] + (double(position) - positions[n - 1]) * average_rate);
+		} else if (positions[j] == position) {
+			// Use the last of several entries at the same position (like the interpolation does)
+			size_t i = j;
+			while (i + 1 < n && positions[i + 1] == position) {
+				++i;
+			}
+			result.push_back(interpolate(position, positions[i], positions[j], distances[i], distances[j]));
+		} else if (j == 0) {
+			result.push_back(interpolate(position, 0, positions[0], 0.0, distances[0]));
+		} else {
+			result.push_back(interpolate(position, positions[j - 1], positions[j], distances[j - 1], distances[j]));
+		}
+	}
+	return result;
+}
+
+
+vector<unsigned int> GeneticMap::recombination_costs(const vector<unsigned int>& query) const {
+	vector<double> d = cumulative_distances(query);
+	vector<unsigned int> result;
+	result.reserve(query.size());
+	if (query.empty()) {
+		return result;
+	}
+	result.push_back(0);
+	for (size_t i = 1; i < d.size(); ++i) {
+		double distance = max(d[i] - d[i - 1], MINIMUM_GENETIC_DISTANCE);
+		result.push_back(static_cast<unsigned int>(nearbyint(centimorgen_to_phred(distance))));
+	}
+	return result;
+}
+
+
+double centimorgen_to_phred(double distance) {
+	if (distance < 0) {
+		throw invalid_argument("Genetic distance must not be negative");
+	}
+	if (distance == 0) {
+		throw invalid_argument("Cannot convert genetic distance of zero to phred.");
+	} else if (distance < 1e-10) {
+		return -10 * (log10(distance) - 2);
+	} else {
+		double p = (1.0 - exp(-(2.0 * distance) / 100)) / 2.0;
+		return -10 * log10(p);
+	}
+}
+
+
+vector<unsigned int> uniform_recombination_costs(double recombination_rate, const vector<unsigned int>& positions) {
+	vector<unsigned int> result;
+	result.reserve(positions.size());
+	if (positions.empty()) {
+		return result;
+	}
+	result.push_back(0);
+	for (size_t i = 1; i < positions.size(); ++i) {
+		double distance = double(positions[i] - positions[i - 1]) * 1e-6 * recombination_rate;
+		result.push_back(static_cast<unsigned int>(nearbyint(centimorgen_to_phred(distance))));
+	}
+	return result;
+}
@@ -0,0 +1,48 @@
+#ifndef GENETICMAP_H
+#define GENETICMAP_H
+
+#include <vector>
+
+/** Genetic map of a chromosome used to compute phred-scaled recombination costs
+ *  between consecutive variants.
+ *
+ *  The cumulative genetic distance (in cM) of a position is interpolated linearly
+ *  between the neighbouring map entries. Left of the first entry, it is interpolated
+ *  between (0, 0) and the first entry; right of the last entry, it is extrapolated
+ *  using the average recombination rate of the whole map.
+ */
+class GeneticMap {
+public:
+	/** @param positions Positions of the map entries in ascending order.
+	 *  @param cumulative_distances Cumulative genetic distance (in cM) at each position.
+	 */
+	GeneticMap(const std::vector<unsigned int>& positions, const std::vector<double>& cumulative_distances);
+
+	/** Returns the number of map entries. */
+	size_t size() const;
+
+	/** Returns the cumulative genetic distance (in cM) at each of the given (sorted) positions. */
+	std::vector<double> cumulative_distances(const std::vector<unsigned int>& positions) const;
+
+	/** Returns the phred-scaled recombination cost between each position and the previous one
+	 *  (sorted positions; the cost of the first position is 0).
+	 */
+	std::vector<unsigned int> recombination_costs(const std::vector<unsigned int>& positions) const;
+
+private:
+	std::vector<unsigned int> positions;
+	std::vector<double> distances;
+};
+
+/** Smallest genetic distance (in cM) assumed between two variants. */
+const double MINIMUM_GENETIC_DISTANCE = 1e-10;
+
+/** Converts a genetic distance (in cM) into a phred-scaled recombination probability. */
+double centimorgen_to_phred(double distance);
+
+/** Returns the phred-scaled recombination cost between each position and the previous one
+ *  for a constant recombination rate (in cM/Mb).
+ */
+std::vector<unsigned int> uniform_recombination_costs(double recombination_rate, const std::vector<unsigned int>& positions);
+
+#endif
@@ -14,19 +14,87 @@
 
 using namespace std;
 
-GenotypeDPTable::GenotypeDPTable(ReadSet* read_set, const vector<unsigned int>& recombcost, const Pedigree* pedigree, const vector<unsigned int>* positions)
+namespace {
+// Keeps the cost computers of a column at the bipartition of the column indexing iterator.
+// Updating can be deferred while rows are skipped. The bits flipped in the meantime are
+// applied later, or, if there are too many of them, the bipartition is set from scratch.
+class PartitioningUpdater {
+public:
+    PartitioningUpdater(vector<GenotypeColumnCostComputer>& cost_computers, size_t column_size)
+        :cost_computers(cost_computers),
+         max_pending(std::max<size_t>(1, column_size / 2)),
+         reset(true)
+    {}
+
+    // record the bit changed by advancing the iterator (-1 if the bipartition was changed otherwise)
+    void advance(int bit_changed) {
+        if ((bit_changed < 0) || reset || (pending_flips.size() >= max_pending)) {
+            reset = true;
+            pending_flips.clear();
+        } else {
+            pending_flips.push_back(bit_changed);
+        }
+    }
+
+    // bring the cost computers to the current bipartition
+    void apply(ColumnIndexingIterator& iterator) {
+        if (reset) {
+            for(auto& cost_computer : cost_computers) {
+                cost_computer.set_partitioning(iterator.get_partition());
+            }
+        } else {
+            for(int bit : pending_flips) {
+                for(auto& cost_computer : cost_computers) {
+                    cost_computer.update_partitioning(bit);
+                }
+            }
+        }
+        reset = false;
+        pending_flips.clear();
+    }
+
+private:
+    vector<GenotypeColumnCostComputer>& cost_computers;
+    size_t max_pending;
+    bool reset;
+    vector<int> pending_flips;
+};
+}
+
+// store a projection column, dropping entries below epsilon times the largest entry.
+// If epsilon is 0, the column is kept as it is.
+static SparseVector2D<long double>* sparsify(Vector2D<long double>* column, long double epsilon, long double* discarded_fraction)
+{
+    if (epsilon == 0.0L) {
+        return new SparseVector2D<long double>(std::move(*column));
+    }
+    long double sum = 0.0L;
+    long double max = 0.0L;
+    for (size_t i = 0; i < column->get_size0(); ++i) {
+        for (size_t j = 0; j < column->get_size1(); ++j) {
+            sum += column->at(i, j);
+            max = std::max(max, column->at(i, j));
+        }
+    }
+    SparseVector2D<long double>* result = new SparseVector2D<long double>(std::move(*column), epsilon * max);
+    *discarded_fraction = (sum > 0.0L) ? result->get_discarded() / sum : 0.0L;
+    return result;
+}
+
+GenotypeDPTable::GenotypeDPTable(ReadSet* read_set, const vector<unsigned int>& recombcost, const Pedigree* pedigree, const vector<unsigned int>* positions, long double epsilon)
     :read_set(read_set),
      recombcost(recombcost),
      pedigree(pedigree),
-     input_column_iterator(*read_set, positions),
-     backward_input_column_iterator(*read_set, positions),
+     epsilon(epsilon),
+     input_column_source(make_column_source(read_set, positions)),
+     input_column_iterator(input_column_source),
+     backward_input_column_iterator(input_column_source),
      transition_probability_table(input_column_iterator.get_column_count(),nullptr),
      scaling_parameters(input_column_iterator.get_column_count(),-1.0L)
 {
+   forward_discarded.assign(input_column_iterator.get_column_count(), 0.0L);
+   backward_discarded.assign(input_column_iterator.get_column_count(), 0.0L);
    genotype_likelihood_table = Vector2D<genotype_likelihood_t>(pedigree->size(),input_column_iterator.get_column_count(),genotype_likelihood_t());
-   read_set->reassignReadIds();
-
-   assert(input_column_iterator.get_column_count() == backward_input_column_iterator.get_column_count());
 
    // create all pedigree partitions
    for(size_t i = 0; i < pow(4,pedigree->triple_count()); ++i)
@@ -216,7 +284,7 @@ void GenotypeDPTable::compute_backward_column(size_t column_index, unique_ptr<ve
    }
 
    // obtain previous projection column (same index as current column!)
-   Vector2D<long double>* previous_projection_column = nullptr;
+   SparseVector2D<long double>* previous_projection_column = nullptr;
    // check if there is a projection column
    if(column_index < backward_input_column_iterator.get_column_count()-1){
        previous_projection_column = backward_projection_column_table[column_index];
@@ -239,21 +307,17 @@ void GenotypeDPTable::compute_backward_column(size_t column_index, unique_ptr<ve
    long double scaling_sum = 0.0L;
 
    // iterate over all bipartitions
+   PartitioningUpdater partitioning_updater(cost_computers, current_input_column->size());
    unique_ptr<ColumnIndexingIterator> iterator = current_indexer->get_iterator();
    while (iterator->has_next()){
        int bit_changed = -1;
        iterator->advance(&bit_changed);
-       if (bit_changed >= 0) {
-           // update bipartition in the cost computers
-           for(auto& cost_computer : cost_computers) {
-               cost_computer.update_partitioning(bit_changed);
-           }
-       } else {
-           // set bipartition in the cost computers
-           for(auto& cost_computer : cost_computers) {
-              cost_computer.set_partitioning(iterator->get_partition());
-           }
+       partitioning_updater.advance(bit_changed);
+       // in approximate mode, skip bipartitions whose states have all been dropped
+       if ((epsilon > 0.0L) && (previous_projection_column != nullptr) && previous_projection_column->is_row_empty(iterator->get_forward_projection())) {
+           continue;
        }
+       partitioning_updater.apply(*iterator);
 
        // Determine index in forward projection column from where to fetch the current cost
        long double backward_prob = 1.0L;
@@ -268,6 +332,8 @@ void GenotypeDPTable::compute_backward_column(size_t column_index, unique_ptr<ve
            if (column_index + 1 < backward_input_column_iterator.get_column_count()) {
                forward_projection_index = iterator->get_forward_projection();
                backward_prob = previous_projection_column->at(forward_projection_index,i);
+               // dropped or impossible state: contributes nothing
+               if (backward_prob == 0.0L) continue;
            }
 
            size_t backward_projection_index = iterator->get_backward_projection();
@@ -291,7 +357,8 @@ void GenotypeDPTable::compute_backward_column(size_t column_index, unique_ptr<ve
    }
    if(current_projection_column != 0){
        current_projection_column->divide_entries_by(scaling_sum);
-       backward_projection_column_table[column_index-1] = current_projection_column;
+       backward_projection_column_table[column_index-1] = sparsify(current_projection_column, epsilon, &backward_discarded[column_index-1]);
+       delete current_projection_column;
    }
    scaling_parameters[column_index] = scaling_sum;
 }
@@ -314,7 +381,7 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
     }
 
     // obtain previous projection column (which is assumed to have already been computed)
-    Vector2D<long double>* previous_projection_column = nullptr;
+    SparseVector2D<long double>* previous_projection_column = nullptr;
     if (column_index > 0) {
         previous_projection_column = forward_projection_column_table[0];
         assert(previous_projection_column != nullptr);
@@ -322,7 +389,7 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
 
     // obtain the backward projection table, from where to get the backward probabilities
     size_t k = (size_t)sqrt(input_column_iterator.get_column_count());
-    Vector2D<long double>* backward_probabilities = nullptr;
+    SparseVector2D<long double>* backward_probabilities = nullptr;
     if(column_index + 1 < input_column_iterator.get_column_count()){
         backward_probabilities = backward_projection_column_table[column_index];
         // if column is not stored, recompute it
@@ -355,29 +422,31 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
 
     // sum of alpha*beta, used to normalize the likelihoods
     long double normalization = 0.0L;
+    // in approximate mode, the forward states that are kept may all have dropped backward
+    // probabilities. Marginals of the forward probabilities alone are then used instead.
+    vector<array<long double, 3>> forward_only_likelihoods;
+    if (epsilon > 0.0L) {
+        forward_only_likelihoods.assign(pedigree->size(), {0.0L, 0.0L, 0.0L});
+    }
 
     // iterate over all bipartitions
+    PartitioningUpdater partitioning_updater(cost_computers, current_input_column->size());
     unique_ptr<ColumnIndexingIterator> iterator = current_indexer->get_iterator();
     while (iterator->has_next()) {
         int bit_changed = -1;
         iterator->advance(&bit_changed);
-        if (bit_changed >= 0) {
-            // update bipartition in the cost computers
-            for(auto& cost_computer : cost_computers) {
-                cost_computer.update_partitioning(bit_changed);
-            }
-        } else {
-            // set bipartition in the cost computers
-            for(auto& cost_computer : cost_computers) {
-               cost_computer.set_partitioning(iterator->get_partition());
-            }
-        }
+        partitioning_updater.advance(bit_changed);
 
         // Determine index in backward projection column from where to fetch the previous cost
         size_t backward_projection_index = 0;
         if (column_index > 0) {
             backward_projection_index = iterator->get_backward_projection();
+            // in approximate mode, skip bipartitions whose states have all been dropped
+            if ((epsilon > 0.0L) && previous_projection_column->is_row_empty(backward_projection_index)) {
+                continue;
+            }
         }
+        partitioning_updater.apply(*iterator);
 
         // iterate over all transmission vectors
         for(size_t i = 0; i < transmission_configurations; ++i){
@@ -385,22 +454,26 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
             long double sum_prev_values = 0.0L;
             unsigned int number_of_allele_assignments = 1<<pedigree_partitions[i]->count();
             if(column_index > 0){
-                for(size_t j = 0; j < transmission_configurations; ++j){
+                TransitionProbabilityComputer* transition_probabilities = transition_probability_table[column_index];
+                previous_projection_column->for_each_in_row(backward_projection_index, [&](size_t j, long double previous_value){
                     // add product of previous cost * transition_probability
-                    sum_prev_values += ((previous_projection_column->at(backward_projection_index,j)) * (transition_probability_table[column_index]->get_prob_transmission(j,i)) );
-                }
+                    sum_prev_values += previous_value * transition_probabilities->get_prob_transmission(j,i);
+                });
+                // all predecessors dropped or impossible
+                if (sum_prev_values == 0.0L) continue;
             } else {
                 sum_prev_values = 1.0L;
             }
 
+            // get already computed backward probability from table
+            long double backward_probability = 1.0L;
+            if(backward_probabilities != nullptr){
+                size_t forward_projection_index = iterator->get_forward_projection();
+                backward_probability = backward_probabilities->at(forward_projection_index,i);
+            }
+
             // iterate over all allele assignments
             for(unsigned int a = 0; a < number_of_allele_assignments; ++a){
-                // get already computed backward probability from table
-                long double backward_probability = 1.0L;
-                if(backward_probabilities != nullptr){
-                    size_t forward_projection_index = iterator->get_forward_projection();
-                    backward_probability = backward_probabilities->at(forward_projection_index,i);
-                }
 
                 long double forward_probability = ( sum_prev_values * cost_computers[i].get_cost(a) * (transition_probability_table[column_index]->get_prob_allele_assignment(i,a)) ) / scaling_parameters[column_index];
                 long double forward_backward = forward_probability * backward_probability;
@@ -413,6 +486,9 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
                     unsigned int allele0 = (a >> partition0) & 1;
                     unsigned int allele1 = (a >> partition1) & 1;
                     genotype_likelihood_table.at(individuals_index,column_index).likelihoods[allele0 + allele1] += forward_backward;
+                    if (epsilon > 0.0L) {
+                        forward_only_likelihoods[individuals_index][allele0 + allele1] += forward_probability;
+                    }
                 }
 
                 // set forward projections
@@ -426,7 +502,8 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
     // store the computed projection column (in case there is one)
     if(current_projection_column != 0){
         delete forward_projection_column_table[0];
-        forward_projection_column_table[0] = current_projection_column;
+        forward_projection_column_table[0] = sparsify(current_projection_column, epsilon, &forward_discarded[column_index]);
+        delete current_projection_column;
     }
 
     // we can remove the backward-probability column
@@ -435,6 +512,18 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
         backward_projection_column_table[column_index] = nullptr;
     }
 
+    if ((epsilon > 0.0L) && (normalization == 0.0L)) {
+        for(size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index){
+            const array<long double, 3>& likelihoods = forward_only_likelihoods[individuals_index];
+            genotype_likelihood_table.at(individuals_index,column_index).likelihoods.assign(likelihoods.begin(), likelihoods.end());
+        }
+        // every individual has the same total
+        if (pedigree->size() > 0) {
+            const array<long double, 3>& likelihoods = forward_only_likelihoods[0];
+            normalization = likelihoods[0] + likelihoods[1] + likelihoods[2];
+        }
+    }
+
     // scale the likelihoods
     for(size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index){
         genotype_likelihood_table.at(individuals_index,column_index).divide_likelihoods_by(normalization);
@@ -449,3 +538,12 @@ vector<long double> GenotypeDPTable::get_genotype_likelihoods(unsigned int indiv
     return genotype_likelihood_table.at(pedigree->id_to_index(individual_id),position).likelihoods;
 
 }
+
+long double GenotypeDPTable::get_max_discarded_fraction() const
+{
+    long double discarded = 0.0L;
+    for (size_t i = 0; i < forward_discarded.size(); ++i) {
+        discarded = std::max(discarded, std::max(forward_discarded[i], backward_discarded[i]));
+    }
+    return discarded;
+}
@@ -7,12 +7,14 @@
 
 #include "columnindexingscheme.h"
 #include "columniterator.h"
+#include "columnsource.h"
 #include "entry.h"
 #include "read.h"
 #include "readset.h"
 #include "pedigree.h"
 #include "pedigreepartitions.h"
 #include "vector2d.h"
+#include "sparsevector2d.h"
 #include "backwardcolumniterator.h"
 #include "transitionprobabilitycomputer.h"
 
@@ -56,10 +58,17 @@ private:
   // indexing schemes
   std::vector<ColumnIndexingScheme*> indexers;
   // projection_column_table[c] contains the projection column between columns c and c+1
-  std::vector<Vector2D<long double>* > forward_projection_column_table;
-  std::vector<Vector2D<long double>* > backward_projection_column_table;
+  std::vector<SparseVector2D<long double>* > forward_projection_column_table;
+  std::vector<SparseVector2D<long double>* > backward_projection_column_table;
+  // entries of a projection column below epsilon times its largest entry are dropped
+  long double epsilon;
+  // fraction of the probability mass dropped from the forward/backward projection column of each column
+  std::vector<long double> forward_discarded;
+  std::vector<long double> backward_discarded;
   // genotype likelihoods for each individual at each position
   Vector2D<genotype_likelihood_t> genotype_likelihood_table;
+  // columns of the input matrix, shared by the forward and backward iterators
+  std::shared_ptr<const ColumnSource> input_column_source;
   //iterator used to iterate the columns of the input matrix (forward)
   ColumnIterator input_column_iterator;
   // iterator used to iterate the columns of the input matrix (backward)
@@ -113,12 +122,19 @@ public:
    * @param pedigree the pedigree giving individuals and their relationships
    * @param positions positions to work on. If 0, all positions given in the read_set are used.
    * 		      caller retains ownership.
+   * @param epsilon if positive, states whose scaled forward or backward probability is below
+   *                epsilon times that of the most likely state in their projection column are
+   *                dropped. This approximates the likelihoods, but is much faster at high coverage.
    */
-  GenotypeDPTable(ReadSet* read_set, const std::vector<unsigned int>& recombcost, const Pedigree* pedigree, const std::vector<unsigned int>* positions = nullptr);
+  GenotypeDPTable(ReadSet* read_set, const std::vector<unsigned int>& recombcost, const Pedigree* pedigree, const std::vector<unsigned int>* positions = nullptr, long double epsilon = 0.0L);
   ~GenotypeDPTable();
 
   // returns the computed genotype likelihoods for a given individual and a given SNP position
   std::vector<long double> get_genotype_likelihoods(unsigned int individual, unsigned int position);
 
+  // returns the largest fraction of probability mass dropped from a single forward or backward
+  // projection column (0 unless epsilon is positive)
+  long double get_max_discarded_fraction() const;
+
 };
 #endif
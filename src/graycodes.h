@@ -3,9 +3,12 @@
 
 #include <iostream>
 
-/** A class to generate Gray codes. 
-  * Implementation is based on
+/** A class to generate Gray codes.
+  * Codes are generated in the order of the binary reflected Gray code,
+  * as by the algorithm in
   * "An Algorithm for Gray Codes", S. Mossige, Computing (18), pp. 89-92, 1977.
+  * The bit changed in step k is the number of trailing zeros of k, so that
+  * each step takes constant time.
   */
 class GrayCodes {
 	public:
@@ -21,9 +24,9 @@ class GrayCodes {
 		  */
 		int_t get_next(int* changed_bit = 0);
 	private:
-		int length;
-		int i;
-		int_t s;
+		// number of codes returned so far and total number of codes
+		unsigned long long step;
+		unsigned long long count;
 		int_t c;
 		int changed_bit;
 };
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <stdexcept>
 #include <cassert>
+#include <cmath>
 
 #include "pedigree.h"
 
@@ -38,6 +39,53 @@ void Pedigree::addIndividual(unsigned int id, std::vector<Genotype*> genotypes,
 }
 
 
+void Pedigree::addIndividual(unsigned int id, const std::vector<Genotype>& genotypes, const std::vector<double>& log10_likelihoods, double default_gq, double regularizer) {
+	if (log10_likelihoods.size() != 3 * genotypes.size()) {
+		throw std::runtime_error("Expected three genotype likelihoods per variant");
+	}
+	vector<Genotype*> genotype_pointers;
+	vector<PhredGenotypeLikelihoods*> likelihood_pointers;
+	genotype_pointers.reserve(genotypes.size());
+	likelihood_pointers.reserve(genotypes.size());
+	vector<double> phred(3);
+	for (size_t j = 0; j < genotypes.size(); ++j) {
+		const Genotype& genotype = genotypes[j];
+		if (!genotype.is_diploid_and_biallelic()) {
+			throw std::runtime_error("Genotype likelihoods can only be used with diploid, biallelic genotypes");
+		}
+		const double* log10_gl = &log10_likelihoods[3 * j];
+		if (std::isnan(log10_gl[0])) {
+			for (size_t g = 0; g < 3; ++g) {
+				phred[g] = (g == genotype.get_index()) ? 0.0 : default_gq;
+			}
+		} else if (regularizer < 0) {
+			// shift log likelihoods such that the largest one is zero
+			double m = std::max(log10_gl[0], std::max(log10_gl[1], log10_gl[2]));
+			for (size_t g = 0; g < 3; ++g) {
+				phred[g] = std::nearbyint((log10_gl[g] - m) * -10);
+			}
+		} else {
+			double p[3];
+			double sum = 0.0;
+			for (size_t g = 0; g < 3; ++g) {
+				p[g] = std::pow(10.0, log10_gl[g]);
+				sum += p[g];
+			}
+			for (size_t g = 0; g < 3; ++g) {
+				p[g] = p[g] / sum + regularizer;
+			}
+			double m = std::max(p[0], std::max(p[1], p[2]));
+			for (size_t g = 0; g < 3; ++g) {
+				phred[g] = std::nearbyint(-10 * std::log10(p[g] / m));
+			}
+		}
+		genotype_pointers.push_back(new Genotype(genotype));
+		likelihood_pointers.push_back(new PhredGenotypeLikelihoods(phred, Genotype::DIPLOID));
+	}
+	addIndividual(id, genotype_pointers, likelihood_pointers);
+}
+
+
 void Pedigree::addRelationship(unsigned int father_id, unsigned int mother_id, unsigned int child_id) {
 	triple_entry_t triple_entry = {id_to_index(father_id), id_to_index(mother_id), id_to_index(child_id)};
 	triples.push_back(triple_entry);
@@ -122,3 +170,21 @@ std::string Pedigree::toString() const {
 	return oss.str();
 
 }
+
+
+bool mendelian_conflict(const Genotype& mother, const Genotype& father, const Genotype& child) {
+	vector<uint32_t> m = mother.as_vector();
+	vector<uint32_t> f = father.as_vector();
+	vector<uint32_t> c = child.as_vector();
+	// Inheritance is only defined for diploid children, so anything else is a conflict
+	if (c.size() != 2) {
+		return true;
+	}
+	auto contains = [](const vector<uint32_t>& alleles, uint32_t allele) {
+		return std::find(alleles.begin(), alleles.end(), allele) != alleles.end();
+	};
+	if (contains(m, c[0]) && contains(f, c[1])) {
+		return false;
+	}
+	return !(contains(m, c[1]) && contains(f, c[0]));
+}
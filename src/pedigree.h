@@ -31,6 +31,14 @@ public:
 	 *  Ownership of pointers given in genotypes and genotype_likelihoods are transferred to Pedigree object. */
 	void addIndividual(unsigned int individual_id, std::vector<Genotype*> genotypes, std::vector<PhredGenotypeLikelihoods*> genotype_likelihoods);
 
+	/** Add an individual with diploid, biallelic genotypes whose genotype likelihoods are given as
+	 *  log10-scaled probabilities, three per variant (for 0/0, 0/1, 1/1). They are converted to
+	 *  phred scale in the same way as GenotypeLikelihoods.as_phred() in vcf.py does it, using
+	 *  no regularization if regularizer is negative. At variants whose likelihoods are NaN,
+	 *  all genotypes get a likelihood of default_gq except for the given one, which gets 0.
+	 */
+	void addIndividual(unsigned int individual_id, const std::vector<Genotype>& genotypes, const std::vector<double>& log10_likelihoods, double default_gq, double regularizer);
+
 	// add a relationship (a mother/father/child triple)
 	void addRelationship(unsigned int father_id, unsigned int mother_id, unsigned int child_id);
 
@@ -85,4 +93,8 @@ private:
 	std::vector<std::vector<PhredGenotypeLikelihoods*>> genotype_likelihoods;
 };
 
+/** Returns whether the genotype of a child cannot be inherited from its parents. A child
+ *  genotype that is not diploid is always a conflict. */
+bool mendelian_conflict(const Genotype& mother, const Genotype& father, const Genotype& child);
+
 #endif
@@ -12,16 +12,17 @@
 
 using namespace std;
 
-PedigreeDPTable::PedigreeDPTable(ReadSet* read_set, const vector<unsigned int>& recombcost, const Pedigree* pedigree, bool distrust_genotypes, const vector<unsigned int>* positions) :
+PedigreeDPTable::PedigreeDPTable(ReadSet* read_set, const vector<unsigned int>& recombcost, const Pedigree* pedigree, bool distrust_genotypes, const vector<unsigned int>* positions, bool streaming, unsigned int transmission_cost_margin) :
 	read_set(read_set),
 	recombcost(recombcost),
 	pedigree(pedigree),
 	distrust_genotypes(distrust_genotypes),
+	streaming(streaming),
+	transmission_cost_margin(transmission_cost_margin),
 	optimal_score(0u),
 	optimal_score_index(0u),
-	input_column_iterator(*read_set, positions)
+	input_column_iterator(make_column_source(read_set, positions))
 {
-	read_set->reassignReadIds();
 
 	// create all pedigree partitions
 	for (size_t i=0; i<std::pow(4, pedigree->triple_count()); ++i) {
@@ -72,7 +73,11 @@ void PedigreeDPTable::clear_table() {
 	init(transmission_backtrace_table, column_count);
 	init(indexers, column_count);
 
-	index_path.clear();
+	superread_alleles.assign(column_count * pedigree->size(), PedigreeColumnCostComputer::phased_variant_t());
+	optimal_transmission_values.assign(column_count, 0);
+	optimal_partitioning.assign(read_set->size(), false);
+	segment_start = 0;
+	pending_segments.clear();
 
 	optimal_score = numeric_limits<unsigned int>::max();
 	optimal_score_index = 0;
@@ -91,6 +96,8 @@ void PedigreeDPTable::compute_table() {
 		return;
 	}
 
+	size_t column_count = input_column_iterator.get_column_count();
+
 	input_column_iterator.jump_to_column(0);
 	unique_ptr<vector<const Entry *> > current_input_column;
 	unique_ptr<vector<const Entry *> > next_input_column;
@@ -101,8 +108,8 @@ void PedigreeDPTable::compute_table() {
 	indexers[0] = next_indexer;
 
 	// forward pass: create a sparse table, storing values at every sqrt(#columns)-th position,
-	size_t k = (size_t)sqrt(input_column_iterator.get_column_count());
-	for (size_t column_index=0; column_index<input_column_iterator.get_column_count(); ++column_index) {
+	size_t k = (size_t)sqrt(column_count);
+	for (size_t column_index=0; column_index<column_count; ++column_index) {
 		// make former next column the current one
 		current_input_column = std::move(next_input_column);
 		unique_ptr<vector<unsigned int> > current_read_ids = std::move(next_read_ids);
@@ -124,50 +131,207 @@ void PedigreeDPTable::compute_table() {
 		compute_column(column_index, std::move(current_input_column));
 
 		// determine whether to delete previous column (to save space)
-		if ((k>1) && (column_index > 0) && (((column_index-1)%k) != 0)) {
-			delete index_backtrace_table[column_index-1];
-			delete transmission_backtrace_table[column_index-1];
-			delete projection_column_table[column_index-1];
-			index_backtrace_table[column_index-1] = nullptr;
-			transmission_backtrace_table[column_index-1] = nullptr;
-			projection_column_table[column_index-1] = nullptr;
+		if ((k>1) && (column_index > segment_start) && (((column_index-1)%k) != 0)) {
+			free_column(column_index-1);
+		}
+
+		if (streaming && (column_index + 1 < column_count) && (current_indexer->forward_projection_size() == 1)) {
+			finish_segment(column_index);
 		}
 	}
 
-	// perform a backtrace to get optimal path
-	index_path.assign(indexers.size(), index_and_inheritance_t());
+	// perform a backtrace from the optimum in the last column to get the optimal path
+	size_t last_column = column_count - 1;
 	index_and_inheritance_t v;
-	unsigned int prev_inheritance_value = previous_transmission_value;
 	v.index = optimal_score_index;
 	v.inheritance_value = optimal_transmission_value;
-	index_path[indexers.size()-1] = v;
-	for(size_t i = indexers.size()-1; i > 0; --i) { // backtrack through table
-		// ensure that index_backtrace_table[i-1] and transmission_backtrace_table[i-1] exist
-		if (projection_column_table[i-1] == nullptr) {
-			// compute index of last previous column that has been stored
-			size_t j = (i-1) / k * k;
-			assert(projection_column_table[j] != nullptr);
-			for (j=j+1; j<i; ++j) {
-				compute_column(j);
-			}
+	unsigned int transmission_value = previous_transmission_value;
+	if (last_column > segment_start) {
+		unique_ptr<ColumnIndexingIterator> iterator = indexers[last_column]->get_iterator();
+		vector<pair<unsigned int, unsigned int> > states(1, make_pair(iterator->index_backward_projection(v.index), transmission_value));
+		vector<vector<index_and_inheritance_t> > paths;
+		trace_back(segment_start, last_column - 1, &states, &paths);
+		for (size_t i = 0; i < paths[0].size(); ++i) {
+			finalize_column(segment_start + i, paths[0][i]);
+		}
+		transmission_value = states[0].second;
+	}
+	finalize_column(last_column, v);
+	finalize_pending_segments(pending_segments.size(), transmission_value);
+	for (size_t column_index = 0; column_index < column_count; ++column_index) {
+		free_column(column_index);
+	}
+}
+
+
+void PedigreeDPTable::ensure_column(size_t column_index) {
+	if (projection_column_table[column_index] != nullptr) {
+		return;
+	}
+	size_t j = column_index;
+	while ((j > 0) && (projection_column_table[j-1] == nullptr)) {
+		--j;
+	}
+	for (; j <= column_index; ++j) {
+		compute_column(j);
+	}
+}
+
+
+void PedigreeDPTable::free_column(size_t column_index) {
+	delete index_backtrace_table[column_index];
+	delete transmission_backtrace_table[column_index];
+	delete projection_column_table[column_index];
+	index_backtrace_table[column_index] = nullptr;
+	transmission_backtrace_table[column_index] = nullptr;
+	projection_column_table[column_index] = nullptr;
+}
+
+
+void PedigreeDPTable::trace_back(size_t first_column, size_t last_column, vector<pair<unsigned int, unsigned int> >* states, vector<vector<index_and_inheritance_t> >* paths) {
+	assert(first_column <= last_column);
+	paths->assign(states->size(), vector<index_and_inheritance_t>(last_column - first_column + 1));
+	for (size_t i = last_column + 1; i > first_column; --i) { // backtrack through table
+		size_t column_index = i - 1;
+		ensure_column(column_index);
+		unique_ptr<ColumnIndexingIterator> iterator = indexers[column_index]->get_iterator();
+		for (size_t s = 0; s < states->size(); ++s) {
+			unsigned int projection_index = states->at(s).first;
+			unsigned int transmission_value = states->at(s).second;
+			index_and_inheritance_t v;
+			v.index = index_backtrace_table[column_index]->at(projection_index, transmission_value);
+			v.inheritance_value = transmission_value;
+			paths->at(s)[column_index - first_column] = v;
+			states->at(s).first = (column_index > 0) ? iterator->index_backward_projection(v.index) : 0;
+			states->at(s).second = transmission_backtrace_table[column_index]->at(projection_index, transmission_value);
 		}
-		// compute index and transmission value for the current column
-		unique_ptr<ColumnIndexingIterator> iterator = indexers[i]->get_iterator();
-		unsigned int backtrace_index = iterator->index_backward_projection(v.index);
-		v.index = index_backtrace_table[i-1]->at(backtrace_index, prev_inheritance_value);
-		v.inheritance_value = prev_inheritance_value;
-		prev_inheritance_value = transmission_backtrace_table[i-1]->at(backtrace_index, v.inheritance_value);
-		index_path[i-1] = v;
 		// free parts of the DP table no longer needed
-		if (i%k == 0) {
-			for (size_t j=i; (j<i+k) && (j<input_column_iterator.get_column_count()-1); ++j) {
-				assert(projection_column_table[j] != nullptr);
-				delete index_backtrace_table[j];
-				delete transmission_backtrace_table[j];
-				delete projection_column_table[j];
-				index_backtrace_table[j] = nullptr;
-				transmission_backtrace_table[j] = nullptr;
-				projection_column_table[j] = nullptr;
+		if (column_index < last_column) {
+			free_column(column_index);
+		}
+	}
+}
+
+
+void PedigreeDPTable::finish_segment(size_t column_index) {
+	assert(indexers[column_index]->forward_projection_size() == 1);
+	size_t transmission_configurations = pedigree_partitions.size();
+	const Vector2D<unsigned int>* projection_column = projection_column_table[column_index];
+	assert(projection_column != nullptr);
+
+	// trace back all valid DP states, which only differ in the transmission value
+	vector<pair<unsigned int, unsigned int> > states;
+	for (unsigned int t = 0; t < transmission_configurations; ++t) {
+		if (projection_column->at(0, t) < numeric_limits<unsigned int>::max()) {
+			states.emplace_back(0, t);
+		}
+	}
+	vector<vector<index_and_inheritance_t> > paths;
+	trace_back(segment_start, column_index, &states, &paths);
+
+	pending_segment_t segment;
+	segment.first_column = segment_start;
+	segment.paths.resize(transmission_configurations);
+	segment.predecessors.assign(transmission_configurations, numeric_limits<unsigned int>::max());
+	vector<unsigned int> current;
+	for (size_t s = 0; s < states.size(); ++s) {
+		unsigned int t = paths[s].back().inheritance_value;
+		segment.paths[t] = std::move(paths[s]);
+		segment.predecessors[t] = states[s].second;
+		current.push_back(t);
+	}
+	if (segment_start > 0) {
+		free_column(segment_start - 1);
+	}
+	pending_segments.push_back(std::move(segment));
+	segment_start = column_index + 1;
+
+	// find the last column at which the backtraces of all states agree
+	for (size_t i = pending_segments.size(); i > 0; --i) {
+		if (current.size() == 1) {
+			finalize_pending_segments(i, current[0]);
+			return;
+		}
+		if (i == 1) {
+			break;
+		}
+		vector<unsigned int> previous;
+		for (unsigned int t : current) {
+			previous.push_back(pending_segments[i-1].predecessors[t]);
+		}
+		sort(previous.begin(), previous.end());
+		previous.erase(unique(previous.begin(), previous.end()), previous.end());
+		current = std::move(previous);
+	}
+}
+
+
+void PedigreeDPTable::finalize_pending_segments(size_t count, unsigned int transmission_value) {
+	assert(count <= pending_segments.size());
+	for (size_t i = count; i > 0; --i) {
+		pending_segment_t& segment = pending_segments[i-1];
+		const vector<index_and_inheritance_t>& path = segment.paths[transmission_value];
+		assert(!path.empty());
+		for (size_t j = 0; j < path.size(); ++j) {
+			finalize_column(segment.first_column + j, path[j]);
+		}
+		transmission_value = segment.predecessors[transmission_value];
+	}
+	pending_segments.erase(pending_segments.begin(), pending_segments.begin() + count);
+}
+
+
+void PedigreeDPTable::finalize_column(size_t column_index, const index_and_inheritance_t& v) {
+	unique_ptr<vector<const Entry*> > column = input_column_iterator.get_source()->get_column(column_index);
+	PedigreeColumnCostComputer cost_computer(*column, column_index, read_sources, pedigree, *pedigree_partitions[v.inheritance_value], distrust_genotypes);
+	cost_computer.set_partitioning(v.index);
+	vector<PedigreeColumnCostComputer::phased_variant_t> alleles = cost_computer.get_alleles();
+	copy(alleles.begin(), alleles.end(), superread_alleles.begin() + column_index * pedigree->size());
+	optimal_transmission_values[column_index] = v.inheritance_value;
+
+	const vector<unsigned int>* read_ids = indexers[column_index]->get_read_ids();
+	for (size_t j = 0; j < read_ids->size(); ++j) {
+		if ((v.index & (((unsigned int)1) << j)) == 0) { // id at this index is in p0 (i.e., in the part.)
+			optimal_partitioning[read_ids->at(j)] = true;
+		}
+	}
+	// the indexer of this column is not needed any more
+	delete indexers[column_index];
+	indexers[column_index] = nullptr;
+}
+
+
+void PedigreeDPTable::select_transmission_values(size_t column_index, Vector2D<unsigned int>* previous_projection_column, vector<unsigned int>* sources, vector<unsigned int>* targets) {
+	unsigned int transmission_configurations = pedigree_partitions.size();
+	sources->clear();
+	targets->clear();
+	if ((transmission_cost_margin == numeric_limits<unsigned int>::max()) || (column_index == 0)) {
+		for (unsigned int t = 0; t < transmission_configurations; ++t) {
+			sources->push_back(t);
+			targets->push_back(t);
+		}
+		return;
+	}
+
+	// best cost of each transmission value in the previous column
+	vector<unsigned int> best_cost(transmission_configurations, numeric_limits<unsigned int>::max());
+	for (size_t p = 0; p < previous_projection_column->get_size0(); ++p) {
+		for (unsigned int t = 0; t < transmission_configurations; ++t) {
+			best_cost[t] = std::min(best_cost[t], previous_projection_column->at(p, t));
+		}
+	}
+	uint64_t limit = (uint64_t)(*std::min_element(best_cost.begin(), best_cost.end())) + transmission_cost_margin;
+	for (unsigned int t = 0; t < transmission_configurations; ++t) {
+		if (best_cost[t] <= limit) {
+			sources->push_back(t);
+		}
+	}
+	// keep transmission values that can be reached from a source within the margin
+	for (unsigned int i = 0; i < transmission_configurations; ++i) {
+		for (unsigned int j : *sources) {
+			if (best_cost[j] + (uint64_t)popcount(i ^ j) * recombcost[column_index] <= limit) {
+				targets->push_back(i);
+				break;
 			}
 		}
 	}
@@ -190,14 +354,16 @@ void PedigreeDPTable::compute_column(size_t column_index, unique_ptr<vector<cons
 	// compute the number of different transmission vectors
 	unsigned int transmission_configurations = std::pow(4, pedigree->triple_count());
 
-	// if current input column was not provided, then create it
+	// if current input column was not provided, then create it (without moving the
+	// iterator, which may be in use by the forward pass)
 	if (current_input_column.get() == nullptr) {
-		input_column_iterator.jump_to_column(column_index);
-		current_input_column = input_column_iterator.get_next();
+		current_input_column = input_column_iterator.get_source()->get_column(column_index);
 	}
 
-	// reserve memory for the current DP column
-	Vector2D<unsigned int> dp_column(current_indexer->column_size(), transmission_configurations, 0);
+	// DP entries of the current row (bipartition). Each row is only needed while it is
+	// computed, so the full DP column (of size column_size()) is never stored.
+	vector<unsigned int> dp_row(transmission_configurations, 0);
+	vector<unsigned int> min_recomb_index(transmission_configurations);
 
 	// obtain previous projection column (which is assumed to have been already computed)
 	Vector2D<unsigned int>* previous_projection_column = nullptr;
@@ -228,12 +394,34 @@ void PedigreeDPTable::compute_column(size_t column_index, unique_ptr<vector<cons
 		);
 	}
 
+	// transmission values to compute DP entries for and those to take previous costs from
+	vector<unsigned int> targets;
+	vector<unsigned int> sources;
+	select_transmission_values(column_index, previous_projection_column, &sources, &targets);
+
 	// create column cost computers
 	vector<PedigreeColumnCostComputer> cost_computers;
-	cost_computers.reserve(transmission_configurations);
-	for(unsigned int i = 0; i < transmission_configurations; ++i) {
+	cost_computers.reserve(targets.size());
+	for (unsigned int i : targets) {
 		cost_computers.emplace_back(*current_input_column, column_index, read_sources, pedigree, *pedigree_partitions[i], distrust_genotypes);
 	}
+	if (targets.size() < transmission_configurations) {
+		// Whether a transmission value is compatible with the genotypes does not depend on
+		// the bipartition. If pruning has removed all compatible ones, use all of them.
+		bool any_valid = false;
+		for (auto& cost_computer : cost_computers) {
+			cost_computer.set_partitioning(0);
+			any_valid = any_valid || (cost_computer.get_cost() < numeric_limits<unsigned int>::max());
+		}
+		if (!any_valid) {
+			targets.clear();
+			cost_computers.clear();
+			for (unsigned int i = 0; i < transmission_configurations; ++i) {
+				targets.push_back(i);
+				cost_computers.emplace_back(*current_input_column, column_index, read_sources, pedigree, *pedigree_partitions[i], distrust_genotypes);
+			}
+		}
+	}
 
 	// iterate over all bipartitions
 	unique_ptr<ColumnIndexingIterator> iterator = current_indexer->get_iterator();
@@ -255,21 +443,18 @@ void PedigreeDPTable::compute_column(size_t column_index, unique_ptr<vector<cons
 		if (column_index > 0) {
 			backward_projection_index = iterator->get_backward_projection();
 		}
-		// Determine index in the current DP column to be written
-		size_t current_index = iterator->get_index();
-
 		// Compute aggregate cost based on cost in previous and cost in current column
-		vector<unsigned int> min_recomb_index(transmission_configurations);
 		bool found_valid_transmission_vector = false;
-		for (size_t i = 0; i < transmission_configurations; ++i) {
+		for (size_t t = 0; t < targets.size(); ++t) {
+			unsigned int i = targets[t];
 			// Compute cost incurred by current cell of DP table
-			unsigned int current_cost = cost_computers[i].get_cost();
+			unsigned int current_cost = cost_computers[t].get_cost();
 			unsigned int min = numeric_limits<unsigned int>::max();
 			size_t min_index = 0;
 			if (current_cost < numeric_limits<unsigned int>::max()) {
 				found_valid_transmission_vector = true;
 			}
-			for (size_t j = 0; j < transmission_configurations; ++j) {
+			for (unsigned int j : sources) {
 				// Step 1: add up cost from current_cost column and previous columns
 				unsigned int val;
 				unsigned int previous_cost = 0;
@@ -295,7 +480,7 @@ void PedigreeDPTable::compute_column(size_t column_index, unique_ptr<vector<cons
 					min_index = j;
 				}
 			}
-			dp_column.set(current_index, i, min);
+			dp_row[i] = min;
 			min_recomb_index[i] = min_index;
 		}
 		if (!found_valid_transmission_vector) {
@@ -305,9 +490,9 @@ void PedigreeDPTable::compute_column(size_t column_index, unique_ptr<vector<cons
 		// if last DP column, then check for new optimal score, otherwise update forward projection and backtrace columns
 		if (current_projection_column == 0) {
 			// update running optimal score index
-			for (size_t i = 0; i < transmission_configurations; ++i) {
-				if (dp_column.at(current_index, i) < optimal_score) {
-					optimal_score = dp_column.at(current_index, i);
+			for (unsigned int i : targets) {
+				if (dp_row[i] < optimal_score) {
+					optimal_score = dp_row[i];
 					optimal_score_index = iterator->get_index();
 					optimal_transmission_value = i;
 					previous_transmission_value = min_recomb_index[i];
@@ -316,9 +501,9 @@ void PedigreeDPTable::compute_column(size_t column_index, unique_ptr<vector<cons
 		} else {
 			unsigned int forward_index = iterator->get_forward_projection();
 			unsigned int it_idx = iterator->get_index();
-			for (unsigned int i = 0; i < transmission_configurations; ++i) {
-				if (dp_column.at(current_index, i) < current_projection_column->at(forward_index,i)) {
-					current_projection_column->set(forward_index, i, dp_column.at(current_index, i));
+			for (unsigned int i : targets) {
+				if (dp_row[i] < current_projection_column->at(forward_index,i)) {
+					current_projection_column->set(forward_index, i, dp_row[i]);
 					index_backtrace_column->set(forward_index, i, it_idx);
 					transmission_backtrace_column->set(forward_index,i, min_recomb_index[i]);
 				}
@@ -345,62 +530,25 @@ void PedigreeDPTable::get_super_reads(std::vector<ReadSet*>* output_read_set, ve
 	assert(output_read_set != nullptr);
 	assert(output_read_set->size() == pedigree->size());
 	assert(transmission_vector != nullptr);
-	transmission_vector->clear();
+	*transmission_vector = optimal_transmission_values;
 
-	input_column_iterator.jump_to_column(0);
 	const vector<unsigned int>* positions = input_column_iterator.get_positions();
-
-	std::vector<std::pair<Read*,Read*>> superreads;
-	for (unsigned int i=0; i<pedigree->size(); i++) {
-		 superreads.emplace_back(
-			new Read("superread_0_"+std::to_string(i), -1, -1, pedigree->index_to_id(i)),
-			new Read("superread_1_"+std::to_string(i), -1, -1, pedigree->index_to_id(i))
-		);
-	}
-
-	if (index_backtrace_table.empty()) {
-		assert(!input_column_iterator.has_next());
-	} else {
-		// run through the file again with the input_column_iterator
-		unsigned int i = 0; // column index
-		while (input_column_iterator.has_next()) {
-			const index_and_inheritance_t& v = index_path[i];
-			unique_ptr<vector<const Entry *> > column = input_column_iterator.get_next();
-			PedigreeColumnCostComputer cost_computer(*column, i, read_sources, pedigree, *pedigree_partitions[v.inheritance_value], distrust_genotypes);
-			cost_computer.set_partitioning(v.index);
-
-			auto population_alleles = cost_computer.get_alleles();
-			
-			// TODO: compute proper weights based on likelihoods.
-			for (unsigned int k=0; k<pedigree->size(); k++) {
-				superreads[k].first->addVariant(positions->at(i), population_alleles[k].allele0, population_alleles[k].quality);
-				superreads[k].second->addVariant(positions->at(i), population_alleles[k].allele1, population_alleles[k].quality);
-			}
-			transmission_vector->push_back(v.inheritance_value);
-			++i; // next column
+	for (unsigned int k=0; k<pedigree->size(); k++) {
+		Read* superread0 = new Read("superread_0_"+std::to_string(k), -1, -1, pedigree->index_to_id(k));
+		Read* superread1 = new Read("superread_1_"+std::to_string(k), -1, -1, pedigree->index_to_id(k));
+		// TODO: compute proper weights based on likelihoods.
+		for (size_t i=0; i<optimal_transmission_values.size(); ++i) {
+			const PedigreeColumnCostComputer::phased_variant_t& alleles = superread_alleles[i * pedigree->size() + k];
+			superread0->addVariant(positions->at(i), alleles.allele0, alleles.quality);
+			superread1->addVariant(positions->at(i), alleles.allele1, alleles.quality);
 		}
-	}
-	for(unsigned int k=0;k<pedigree->size();k++) {
 		assert(output_read_set->at(k) != nullptr);
-		output_read_set->at(k)->add(superreads[k].first);
-		output_read_set->at(k)->add(superreads[k].second);
+		output_read_set->at(k)->add(superread0);
+		output_read_set->at(k)->add(superread1);
 	}
 }
 
 
 vector<bool>* PedigreeDPTable::get_optimal_partitioning() {
-	vector<bool>* partitioning = new vector<bool>(read_set->size(),false);
-
-	for(size_t i=0; i< index_path.size(); ++i) {
-		unsigned int mask = 1; // mask to pass over the partitioning (i.e., index)
-		for(size_t j=0; j< indexers[i]->get_read_ids()->size(); ++j) {
-			unsigned int index = index_path[i].index;
-			if((index & mask) == 0) { // id at this index is in p0 (i.e., in the part.)
-				partitioning->at(indexers[i]->get_read_ids()->at(j)) = true;
-			}
-			mask = mask << 1;
-		}
-	}
-	
-	return partitioning;
+	return new vector<bool>(optimal_partitioning);
 }
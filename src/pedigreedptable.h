@@ -2,6 +2,9 @@
 #define PEDIGREE_DP_TABLE_H
 
 #include <array>
+#include <deque>
+#include <limits>
+#include <utility>
 #include <vector>
 #include <memory>
 
@@ -11,6 +14,7 @@
 #include "read.h"
 #include "readset.h"
 #include "pedigree.h"
+#include "pedigreecolumncostcomputer.h"
 #include "pedigreepartitions.h"
 #include "vector2d.h"
 
@@ -20,6 +24,17 @@ typedef struct index_and_inheritance_t {
 	index_and_inheritance_t()  : index(0), inheritance_value(0) {};
 } index_and_inheritance_t;
 
+/** Part of the DP table between two columns not spanned by any read whose backtrace
+ *  has been computed for every DP state at its last column. */
+typedef struct pending_segment_t {
+	size_t first_column;
+	// paths[t] is the backtrace through the segment starting with transmission value t at
+	// its last column; predecessors[t] is the transmission value in the column preceding the
+	// segment that the backtrace continues with (or UINT_MAX if t is not a valid state)
+	std::vector<std::vector<index_and_inheritance_t> > paths;
+	std::vector<unsigned int> predecessors;
+} pending_segment_t;
+
 class PedigreeDPTable {
 private:
 	ReadSet* read_set;
@@ -28,8 +43,12 @@ private:
 	const std::vector<unsigned int>& recombcost;
 	const Pedigree* pedigree;
 	bool distrust_genotypes;
+	bool streaming;
+	// transmission values whose cost exceeds the best one in a column by more than this are not
+	// followed further (UINT_MAX: no pruning)
+	unsigned int transmission_cost_margin;
 	std::vector<PedigreePartitions*> pedigree_partitions;
-	// vector of indexingschemes
+	// vector of indexingschemes (freed for the columns of the optimal path that are finalized)
 	std::vector<ColumnIndexingScheme*> indexers;
 	// optimal score and its index in the rightmost DP table column
 	unsigned int optimal_score;
@@ -48,8 +67,17 @@ private:
 	// that gave rise to dp[x][t].
 	std::vector<Vector2D<unsigned int>* > transmission_backtrace_table;
 	ColumnIterator input_column_iterator;
-	// optimal path obtained from backtrace
-	std::vector<index_and_inheritance_t> index_path;
+	// results recorded for each column of the optimal path as soon as it is known:
+	// alleles of the super reads (one entry per individual and column, column by column),
+	// transmission values and, for each read, whether it is in partition 0
+	std::vector<PedigreeColumnCostComputer::phased_variant_t> superread_alleles;
+	std::vector<unsigned int> optimal_transmission_values;
+	std::vector<bool> optimal_partitioning;
+	// first column whose backtrace is not yet known (streaming mode); the tables of the
+	// column before it are kept since the next column is computed from them
+	size_t segment_start;
+	// segments whose backtrace depends on the DP state chosen further right (streaming mode)
+	std::deque<pending_segment_t> pending_segments;
 
 	// helper function to pull read ids out of read column
 	std::unique_ptr<std::vector<unsigned int> > extract_read_ids(const std::vector<const Entry *>& entries);
@@ -61,6 +89,35 @@ private:
 	/** Computes the DP column at the given index, assuming that the previous column
 	 *  has already been computed. */
 	void compute_column(size_t column_index, std::unique_ptr<std::vector<const Entry*>> current_input_column = nullptr);
+	/** Determines the transmission values for which DP entries of the given column are computed
+	 *  (targets) and the ones of the previous column that they may come from (sources). */
+	void select_transmission_values(size_t column_index, Vector2D<unsigned int>* previous_projection_column, std::vector<unsigned int>* sources, std::vector<unsigned int>* targets);
+	/** Recomputes the given column (and the columns before it back to the last one that is
+	 *  stored) unless it is stored. */
+	void ensure_column(size_t column_index);
+	void free_column(size_t column_index);
+
+	/** Follows the backtrace of each given entry (projection index and transmission value)
+	 *  of the projection column last_column back to first_column. paths->at(s) receives the
+	 *  path of entry s, and the entries are replaced by the ones they come from in the
+	 *  projection column first_column-1. The tables of all columns between first_column
+	 *  and last_column-1 are freed. */
+	void trace_back(size_t first_column, size_t last_column, std::vector<std::pair<unsigned int, unsigned int> >* states, std::vector<std::vector<index_and_inheritance_t> >* paths);
+
+	/** Called in streaming mode for a column that shares no reads with the next one. Traces
+	 *  back all DP states of the segment ending at this column, frees its tables and finalizes
+	 *  the pending segments up to the last column at which the backtraces of all states agree. */
+	void finish_segment(size_t column_index);
+
+	/** Finalizes the oldest count pending segments, following their backtraces starting
+	 *  with the given transmission value at the last column of the newest of them. */
+	void finalize_pending_segments(size_t count, unsigned int transmission_value);
+
+	/** Records the super read alleles, transmission value and read partitioning of the
+	 *  given column for the given entry of the optimal path. The column is fetched from the
+	 *  column source again and its alleles are computed with a new cost computer: those of
+	 *  the DP only exist while a column is computed, before its entry of the path is known. */
+	void finalize_column(size_t column_index, const index_and_inheritance_t& v);
 
 	/** Returns the number of set bits. */
 	static size_t popcount(size_t x);
@@ -83,8 +140,17 @@ public:
 	 *                            (in the given pedigree object).
 	 *  @param positions Positions to work on. If 0, then all positions given in read_set will be used. Caller retains
 	 *                   ownership.
+	 *  @param streaming If true, the backtrace of the table up to a column that is not spanned by any read is
+	 *                   determined as soon as that column has been computed, and the tables up to that column are
+	 *                   freed. Memory then depends on the longest read-connected region instead of on the number of
+	 *                   columns. The result is the same. It is recorded in this object and only available through
+	 *                   the getters once the constructor has returned.
+	 *  @param transmission_cost_margin In each column, only transmission vectors whose cost exceeds the best one
+	 *                   by at most this margin are followed into the next column, and only transmission vectors
+	 *                   reachable from them within the margin are considered there. This makes large pedigrees
+	 *                   tractable, but the result may be suboptimal. The default disables pruning.
 	 */
-	PedigreeDPTable(ReadSet* read_set, const std::vector<unsigned int>& recombcost, const Pedigree* pedigree, bool distrust_genotypes, const std::vector<unsigned int>* positions = nullptr);
+	PedigreeDPTable(ReadSet* read_set, const std::vector<unsigned int>& recombcost, const Pedigree* pedigree, bool distrust_genotypes, const std::vector<unsigned int>* positions = nullptr, bool streaming = false, unsigned int transmission_cost_margin = std::numeric_limits<unsigned int>::max());
  
 	~PedigreeDPTable();
 
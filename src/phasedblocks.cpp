@@ -0,0 +1,36 @@
+#include <stdexcept>
+#include <unordered_map>
+
+#include "phasedblocks.h"
+
+using namespace std;
+
+ReadSet* phased_blocks_as_reads(const string& name_prefix, const vector<unsigned int>& positions, const vector<long>& block_ids, const vector<int>& alleles, const vector<int>& qualities, int source_id, int sample_id, int mapq) {
+	if ((block_ids.size() != positions.size()) || (alleles.size() != positions.size()) || (qualities.size() != positions.size())) {
+		throw invalid_argument("Phase arrays must have the same length");
+	}
+	// Group variants by block, keeping the blocks in order of first occurrence
+	unordered_map<long, size_t> block_index;
+	vector<vector<size_t> > blocks;
+	for (size_t i = 0; i < positions.size(); ++i) {
+		auto inserted = block_index.emplace(block_ids[i], blocks.size());
+		if (inserted.second) {
+			blocks.emplace_back();
+		}
+		blocks[inserted.first->second].push_back(i);
+	}
+
+	ReadSet* result = new ReadSet();
+	for (const vector<size_t>& block : blocks) {
+		if (block.size() < 2) {
+			continue;
+		}
+		Read* read = new Read(name_prefix + to_string(block_ids[block[0]]), mapq, source_id, sample_id);
+		for (size_t i : block) {
+			read->addVariant(positions[i], alleles[i], qualities[i]);
+		}
+		read->sortVariants();
+		result->add(read);
+	}
+	return result;
+}
@@ -0,0 +1,30 @@
+#ifndef PHASEDBLOCKS_H
+#define PHASEDBLOCKS_H
+
+#include <string>
+#include <vector>
+
+#include "readset.h"
+
+/** Turns the phased blocks of one sample into reads, one read per block.
+ *
+ *  Entry i of the input vectors describes a phased heterozygous variant at positions[i]
+ *  that belongs to block block_ids[i] and has allele alleles[i] on the first haplotype.
+ *  Each block becomes a read named name_prefix followed by the block id, with its variants
+ *  sorted by position. Blocks with fewer than two variants are omitted. Reads appear in
+ *  the order in which their blocks first occur in the input.
+ *
+ *  Caller owns the returned pointer.
+ */
+ReadSet* phased_blocks_as_reads(
+	const std::string& name_prefix,
+	const std::vector<unsigned int>& positions,
+	const std::vector<long>& block_ids,
+	const std::vector<int>& alleles,
+	const std::vector<int>& qualities,
+	int source_id,
+	int sample_id,
+	int mapq
+);
+
+#endif
@@ -0,0 +1,102 @@
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "readbuilder.h"
+
+using namespace std;
+
+namespace {
+
+/** Identifies the reads that are mates of each other by the hash of their name
+ *  together with source and sample id. */
+struct mate_key_t {
+	const string* name;
+	int source_id;
+	int sample_id;
+	size_t hash;
+	bool operator==(const mate_key_t& other) const {
+		return (hash == other.hash) && (source_id == other.source_id) && (sample_id == other.sample_id) && (*name == *other.name);
+	}
+};
+
+struct mate_key_hash_t {
+	size_t operator()(const mate_key_t& key) const {
+		return key.hash;
+	}
+};
+
+}
+
+ReadSet* build_reads(const vector<string>& names, const vector<int>& mapqs, const vector<int>& source_ids, const vector<int>& sample_ids, const vector<int>& reference_starts, const vector<string>& BX_tags, const vector<size_t>& variant_offsets, const vector<int>& positions, const vector<int>& alleles, const vector<int>& qualities) {
+	size_t n = names.size();
+	if ((mapqs.size() != n) || (source_ids.size() != n) || (sample_ids.size() != n) || (reference_starts.size() != n) || (BX_tags.size() != n) || (variant_offsets.size() != n + 1)) {
+		throw invalid_argument("Read arrays must have the same length");
+	}
+	if ((alleles.size() != positions.size()) || (qualities.size() != positions.size()) || (variant_offsets[n] != positions.size())) {
+		throw invalid_argument("Variant arrays must have the same length");
+	}
+
+	// For each read, the index of its mate (or n if it has none)
+	vector<size_t> mates(n, n);
+	// Reads that come first among their mates, in order
+	vector<size_t> first_reads;
+	first_reads.reserve(n);
+	unordered_map<mate_key_t, size_t, mate_key_hash_t> first_mate;
+	first_mate.reserve(n);
+	hash<string> hash_name;
+	for (size_t i = 0; i < n; ++i) {
+		size_t h = (hash_name(names[i]) * 31 + source_ids[i]) * 31 + sample_ids[i];
+		auto inserted = first_mate.emplace(mate_key_t{&names[i], source_ids[i], sample_ids[i], h}, i);
+		if (inserted.second) {
+			first_reads.push_back(i);
+			continue;
+		}
+		size_t first = inserted.first->second;
+		if (mates[first] != n) {
+			throw runtime_error("Read name '" + names[i] + "' occurs more than twice in the input file");
+		}
+		mates[first] = i;
+	}
+
+	ReadSet* result = new ReadSet();
+	for (size_t i1 : first_reads) {
+		Read* read = new Read(names[i1], mapqs[i1], source_ids[i1], sample_ids[i1], reference_starts[i1], BX_tags[i1]);
+		size_t i2 = mates[i1];
+		size_t k1 = variant_offsets[i1];
+		size_t end1 = variant_offsets[i1 + 1];
+		if (i2 == n) {
+			for (; k1 < end1; ++k1) {
+				read->addVariant(positions[k1], alleles[k1], qualities[k1]);
+			}
+			result->add(read);
+			continue;
+		}
+		read->addMapq(mapqs[i2]);
+		size_t k2 = variant_offsets[i2];
+		size_t end2 = variant_offsets[i2 + 1];
+		while ((k1 < end1) || (k2 < end2)) {
+			if ((k2 == end2) || ((k1 < end1) && (positions[k1] < positions[k2]))) {
+				read->addVariant(positions[k1], alleles[k1], qualities[k1]);
+				++k1;
+			} else if ((k1 == end1) || (positions[k2] < positions[k1])) {
+				read->addVariant(positions[k2], alleles[k2], qualities[k2]);
+				++k2;
+			} else {
+				// Variant on self-overlapping read pair: if both alleles agree, add up
+				// qualities. Otherwise, keep the allele with the higher quality.
+				if (alleles[k1] == alleles[k2]) {
+					read->addVariant(positions[k1], alleles[k1], qualities[k1] + qualities[k2]);
+				} else if (qualities[k1] >= qualities[k2]) {
+					read->addVariant(positions[k1], alleles[k1], qualities[k1]);
+				} else {
+					read->addVariant(positions[k2], alleles[k2], qualities[k2]);
+				}
+				++k1;
+				++k2;
+			}
+		}
+		result->add(read);
+	}
+	return result;
+}
@@ -0,0 +1,35 @@
+#ifndef READBUILDER_H
+#define READBUILDER_H
+
+#include <string>
+#include <vector>
+
+#include "readset.h"
+
+/** Builds reads from flat arrays, as collected while detecting alleles in many alignments.
+ *
+ *  Read i has name names[i], mapping quality mapqs[i] (and so on) and the variants with
+ *  indices variant_offsets[i] to variant_offsets[i+1]-1 in positions, alleles and qualities.
+ *  The variants of each read must be sorted by position.
+ *
+ *  Reads with identical name, source id and sample id (the two ends of a paired-end read)
+ *  are merged into a single read in the same way as merge_two_reads in whatshap/variants.py
+ *  does it. A runtime_error is thrown if a name occurs more than twice. Reads appear in the
+ *  order in which their names first occur.
+ *
+ *  Caller owns the returned pointer.
+ */
+ReadSet* build_reads(
+	const std::vector<std::string>& names,
+	const std::vector<int>& mapqs,
+	const std::vector<int>& source_ids,
+	const std::vector<int>& sample_ids,
+	const std::vector<int>& reference_starts,
+	const std::vector<std::string>& BX_tags,
+	const std::vector<size_t>& variant_offsets,
+	const std::vector<int>& positions,
+	const std::vector<int>& alleles,
+	const std::vector<int>& qualities
+);
+
+#endif
@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include "readmerger.h"
+#include "componentfinder.h"
+
+using namespace std;
+
+ReadMerger::read_layout_t::read_layout_t(const ReadSet& reads) {
+	offsets.reserve(reads.size() + 1);
+	offsets.push_back(0);
+	for (size_t i = 0; i < reads.size(); ++i) {
+		const Read* read = reads.get(i);
+		if (read->getVariantCount() == 0) {
+			throw std::runtime_error("ReadMerger: read without variants.");
+		}
+		for (int j = 0; j < read->getVariantCount(); ++j) {
+			positions.push_back(read->getPosition(j));
+			alleles.push_back(read->getAllele(j));
+			qualities.push_back(read->getVariantQuality(j));
+		}
+		offsets.push_back(positions.size());
+	}
+}
+
+
+ReadMerger::ReadMerger(double error_rate, double max_error_rate, double positive_threshold, double negative_threshold, unsigned int threads) :
+	max_error_rate(max_error_rate),
+	threads(max(threads, 1u))
+{
+	// Number of (matches - mismatches) needed to reach the given probability ratios
+	double base = log((1.0 - error_rate) / (error_rate / 3.0));
+	thr_diff = 1 + int(log(positive_threshold) / base);
+	thr_neg_diff = 1 + int(log(negative_threshold) / base);
+}
+
+
+int ReadMerger::getPositiveDifferenceThreshold() const {
+	return thr_diff;
+}
+
+
+int ReadMerger::getNegativeDifferenceThreshold() const {
+	return thr_neg_diff;
+}
+
+
+void ReadMerger::scorePairs(const read_layout_t& layout, const vector<pair<uint32_t,uint32_t> >& pairs, size_t first, size_t last, vector<pair<int,int> >* scores) {
+	for (size_t k = first; k < last; ++k) {
+		uint32_t i1 = pairs[k].first;
+		uint32_t i2 = pairs[k].second;
+		// The overhang is the difference of the first positions, but it is applied
+		// to variant indices (as in the original model)
+		long hang = long(layout.positions[layout.offsets[i2]]) - long(layout.positions[layout.offsets[i1]]);
+		long length1 = layout.length(i1);
+		long length2 = layout.length(i2);
+		long start = (hang >= 0) ? hang : max(0L, length1 + hang);
+		long overlap = min(length1 - start, length2);
+		int match = 0;
+		int mismatch = 0;
+		for (long j = 0; j < overlap; ++j) {
+			bool allele1 = layout.alleles[layout.offsets[i1] + start + j] == 0;
+			bool allele2 = layout.alleles[layout.offsets[i2] + j] == 0;
+			if (allele1 == allele2) {
+				match += 1;
+			} else {
+				mismatch += 1;
+			}
+		}
+		(*scores)[k] = make_pair(match, mismatch);
+	}
+}
+
+
+bool ReadMerger::findPath(const graph_t& graph, uint32_t source, uint32_t target, vector<uint32_t>* path) {
+	const uint32_t none = numeric_limits<uint32_t>::max();
+	unordered_map<uint32_t,uint32_t> pred;
+	unordered_map<uint32_t,uint32_t> succ;
+	pred[source] = none;
+	succ[target] = none;
+	vector<uint32_t> forward_fringe(1, source);
+	vector<uint32_t> reverse_fringe(1, target);
+	vector<uint32_t> level;
+	uint32_t meet = none;
+	// Expand the smaller fringe by one level until both searches meet
+	while (!forward_fringe.empty() && !reverse_fringe.empty() && (meet == none)) {
+		if (forward_fringe.size() <= reverse_fringe.size()) {
+			level.swap(forward_fringe);
+			forward_fringe.clear();
+			for (size_t i = 0; (i < level.size()) && (meet == none); ++i) {
+				for (const edge_t& e : graph[level[i]]) {
+					if (pred.find(e.node) == pred.end()) {
+						forward_fringe.push_back(e.node);
+						pred[e.node] = level[i];
+					}
+					if (succ.find(e.node) != succ.end()) {
+						meet = e.node;
+						break;
+					}
+				}
+			}
+		} else {
+			level.swap(reverse_fringe);
+			reverse_fringe.clear();
+			for (size_t i = 0; (i < level.size()) && (meet == none); ++i) {
+				for (const edge_t& e : graph[level[i]]) {
+					if (succ.find(e.node) == succ.end()) {
+						succ[e.node] = level[i];
+						reverse_fringe.push_back(e.node);
+					}
+					if (pred.find(e.node) != pred.end()) {
+						meet = e.node;
+						break;
+					}
+				}
+			}
+		}
+	}
+	if (meet == none) {
+		return false;
+	}
+	path->clear();
+	for (uint32_t v = meet; v != none; v = pred[v]) {
+		path->push_back(v);
+	}
+	reverse(path->begin(), path->end());
+	for (uint32_t v = succ[meet]; v != none; v = succ[v]) {
+		path->push_back(v);
+	}
+	return true;
+}
+
+
+void ReadMerger::removeEdge(graph_t* graph, uint32_t u, uint32_t v) {
+	vector<edge_t>& u_edges = (*graph)[u];
+	vector<edge_t>& v_edges = (*graph)[v];
+	u_edges.erase(find_if(u_edges.begin(), u_edges.end(), [v](const edge_t& e) { return e.node == v; }));
+	v_edges.erase(find_if(v_edges.begin(), v_edges.end(), [u](const edge_t& e) { return e.node == u; }));
+}
+
+
+ReadSet* ReadMerger::merge(const ReadSet& reads) const {
+	read_layout_t layout(reads);
+	size_t n = layout.size();
+
+	// Sweep over the reads and pair each read with all preceding reads that are still
+	// active, that is, whose end (first position plus number of variants) lies beyond the
+	// first position of the current read. Reads are never reactivated.
+	vector<pair<uint32_t,uint32_t> > pairs;
+	vector<uint32_t> active;
+	for (size_t i = 0; i < n; ++i) {
+		int begin = layout.positions[layout.offsets[i]];
+		active.push_back(i);
+		active.erase(
+			remove_if(active.begin(), active.end(), [&layout, begin](uint32_t j) {
+				return long(layout.positions[layout.offsets[j]]) + long(layout.length(j)) <= begin;
+			}),
+			active.end()
+		);
+		for (uint32_t j : active) {
+			if (j != i) {
+				pairs.push_back(make_pair(j, uint32_t(i)));
+			}
+		}
+	}
+
+	vector<pair<int,int> > scores(pairs.size());
+	size_t n_threads = min(size_t(threads), max(pairs.size() / 1000, size_t(1)));
+	if (n_threads <= 1) {
+		scorePairs(layout, pairs, 0, pairs.size(), &scores);
+	} else {
+		vector<thread> workers;
+		size_t chunk_size = (pairs.size() + n_threads - 1) / n_threads;
+		for (size_t first = 0; first < pairs.size(); first += chunk_size) {
+			size_t last = min(first + chunk_size, pairs.size());
+			workers.push_back(thread(scorePairs, cref(layout), cref(pairs), first, last, &scores));
+		}
+		for (thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	// Edges are added in the order in which pairs were enumerated, which determines the
+	// order in which the shortest path search below visits neighbors
+	graph_t blue(n);
+	vector<pair<uint32_t,uint32_t> > not_blue;
+	for (size_t k = 0; k < pairs.size(); ++k) {
+		int match = scores[k].first;
+		int mismatch = scores[k].second;
+		int total = match + mismatch;
+		if ((total == 0) || (total < thr_neg_diff)) continue;
+		if (double(min(match, mismatch)) / total > max_error_rate) continue;
+		if (match - mismatch < thr_diff) continue;
+		blue[pairs[k].first].push_back(edge_t(pairs[k].second, match - mismatch));
+		blue[pairs[k].second].push_back(edge_t(pairs[k].first, match - mismatch));
+		if (mismatch - match >= thr_neg_diff) {
+			not_blue.push_back(pairs[k]);
+		}
+	}
+	sort(not_blue.begin(), not_blue.end());
+
+	vector<unsigned int> indices(n);
+	for (size_t i = 0; i < n; ++i) {
+		indices[i] = i;
+	}
+	ComponentFinder blue_components(indices);
+	for (size_t i = 0; i < n; ++i) {
+		for (const edge_t& e : blue[i]) {
+			blue_components.merge(i, e.node);
+		}
+	}
+
+	// Not blue edges are evidence that two reads should not be merged. For each such edge
+	// within a blue component, repeatedly remove the least supported edge on a shortest
+	// path between its endpoints until they are disconnected.
+	vector<uint32_t> path;
+	for (const pair<uint32_t,uint32_t>& p : not_blue) {
+		if (blue_components.find(p.first) != blue_components.find(p.second)) continue;
+		while (findPath(blue, p.first, p.second, &path)) {
+			size_t weakest = 0;
+			int weakest_support = numeric_limits<int>::max();
+			for (size_t i = 0; i + 1 < path.size(); ++i) {
+				for (const edge_t& e : blue[path[i]]) {
+					if ((e.node == path[i+1]) && (e.support < weakest_support)) {
+						weakest = i;
+						weakest_support = e.support;
+					}
+				}
+			}
+			removeEdge(&blue, path[weakest], path[weakest+1]);
+		}
+	}
+
+	// Merge each remaining blue component into a super read represented by its first read
+	ComponentFinder clusters(indices);
+	for (size_t i = 0; i < n; ++i) {
+		for (const edge_t& e : blue[i]) {
+			clusters.merge(i, e.node);
+		}
+	}
+	vector<unsigned int> representative = clusters.getComponents();
+	vector<size_t> cluster_size(n, 0);
+	for (size_t i = 0; i < n; ++i) {
+		cluster_size[representative[i]] += 1;
+	}
+	// maps representative to site to quality sums of allele 0 and allele 1
+	unordered_map<uint32_t, map<int, pair<int,int> > > superreads;
+	for (size_t i = 0; i < n; ++i) {
+		if (cluster_size[representative[i]] < 2) continue;
+		map<int, pair<int,int> >& superread = superreads[representative[i]];
+		for (size_t j = layout.offsets[i]; j < layout.offsets[i+1]; ++j) {
+			pair<int,int>& q = superread[layout.positions[j]];
+			if (layout.alleles[j] == 0) {
+				q.first += layout.qualities[j];
+			} else {
+				q.second += layout.qualities[j];
+			}
+		}
+	}
+
+	ReadSet* result = new ReadSet();
+	for (size_t i = 0; i < n; ++i) {
+		bool clustered = cluster_size[representative[i]] >= 2;
+		if (clustered && (representative[i] != i)) continue;
+		ostringstream name;
+		name << "read" << i;
+		Read* read = new Read(name.str(), 0, 0, 0);
+		if (clustered) {
+			for (const pair<const int, pair<int,int> >& site : superreads[i]) {
+				int q0 = site.second.first;
+				int q1 = site.second.second;
+				if (q0 >= q1) {
+					read->addVariant(site.first, 0, q0 - q1);
+				} else {
+					read->addVariant(site.first, 1, q1 - q0);
+				}
+			}
+		} else {
+			for (size_t j = layout.offsets[i]; j < layout.offsets[i+1]; ++j) {
+				read->addVariant(layout.positions[j], layout.alleles[j], layout.qualities[j]);
+			}
+		}
+		result->add(read);
+	}
+	return result;
+}
@@ -0,0 +1,68 @@
+#ifndef READMERGER_H
+#define READMERGER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "readset.h"
+
+/** Merges reads that are likely to come from the same haplotype into super reads.
+ *
+ *  Two reads are connected by a "blue" edge if their overlap supports that they come
+ *  from the same haplotype, and by a "not blue" edge if it supports that they come
+ *  from different haplotypes. Blue edges are removed until no pair of reads joined by
+ *  a not blue edge is in the same blue connected component. Each remaining blue
+ *  component is then merged into one super read.
+ */
+class ReadMerger {
+public:
+	/** @param error_rate Probability that a nucleotide is wrong
+	 *  @param max_error_rate Maximum error rate of an edge; edges above it are discarded
+	 *  @param positive_threshold Threshold of the ratio between the probabilities that two
+	 *         reads come from the same haplotype and from different haplotypes
+	 *  @param negative_threshold Threshold of the same ratio for the evidence that two reads
+	 *         should not be merged
+	 *  @param threads Number of threads used for scoring pairs of overlapping reads
+	 */
+	ReadMerger(double error_rate, double max_error_rate, double positive_threshold, double negative_threshold, unsigned int threads = 1);
+
+	/** Returns the merged reads. Caller owns the returned pointer. */
+	ReadSet* merge(const ReadSet& reads) const;
+
+	int getPositiveDifferenceThreshold() const;
+	int getNegativeDifferenceThreshold() const;
+
+private:
+	typedef struct edge_t {
+		uint32_t node;
+		int support; // matches minus mismatches
+		edge_t(uint32_t node, int support) : node(node), support(support) {}
+	} edge_t;
+
+	typedef std::vector<std::vector<edge_t> > graph_t;
+
+	/** Reads in compressed sparse row layout: the variants of read i are at
+	 *  indices offsets[i] to offsets[i+1]-1 of positions, alleles and qualities. */
+	typedef struct read_layout_t {
+		std::vector<size_t> offsets;
+		std::vector<int> positions;
+		std::vector<int> alleles;
+		std::vector<int> qualities;
+		read_layout_t(const ReadSet& reads);
+		size_t size() const { return offsets.size() - 1; }
+		size_t length(size_t i) const { return offsets[i+1] - offsets[i]; }
+	} read_layout_t;
+
+	/** Counts matches and mismatches for pairs[first..last-1]. */
+	static void scorePairs(const read_layout_t& layout, const std::vector<std::pair<uint32_t,uint32_t> >& pairs, size_t first, size_t last, std::vector<std::pair<int,int> >* scores);
+	/** Finds a shortest path using a bidirectional breadth-first search. */
+	static bool findPath(const graph_t& graph, uint32_t source, uint32_t target, std::vector<uint32_t>* path);
+	static void removeEdge(graph_t* graph, uint32_t u, uint32_t v);
+
+	double max_error_rate;
+	int thr_diff;
+	int thr_neg_diff;
+	unsigned int threads;
+};
+
+#endif
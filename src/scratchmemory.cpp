@@ -0,0 +1,83 @@
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "scratchmemory.h"
+
+using namespace std;
+
+namespace {
+
+mutex scratch_mutex;
+string scratch_directory;
+// read without holding the lock, so that small allocations stay cheap
+atomic<size_t> scratch_threshold(0);
+atomic<bool> scratch_enabled(false);
+atomic<size_t> scratch_mapping_count(0);
+unordered_set<void*> scratch_mappings;
+
+}
+
+
+void set_scratch_directory(const string& directory, size_t threshold) {
+	lock_guard<mutex> lock(scratch_mutex);
+	scratch_directory = directory;
+	scratch_threshold = threshold;
+	scratch_enabled = !directory.empty();
+}
+
+
+void* scratch_allocate(size_t bytes) {
+	if (!scratch_enabled || (bytes == 0) || (bytes < scratch_threshold)) {
+		return nullptr;
+	}
+	lock_guard<mutex> lock(scratch_mutex);
+	if (!scratch_enabled) {
+		return nullptr;
+	}
+	string path = scratch_directory + "/whatshap-dp-XXXXXX";
+	vector<char> name(path.begin(), path.end());
+	name.push_back('\0');
+	int fd = mkstemp(name.data());
+	if (fd < 0) {
+		throw runtime_error("Cannot create DP scratch file in " + scratch_directory + ": " + strerror(errno));
+	}
+	// the file is removed as soon as it is unmapped
+	unlink(name.data());
+	if (ftruncate(fd, bytes) != 0) {
+		int error = errno;
+		close(fd);
+		throw runtime_error(string("Cannot resize DP scratch file: ") + strerror(error));
+	}
+	void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	int error = errno;
+	close(fd);
+	if (p == MAP_FAILED) {
+		throw runtime_error(string("Cannot map DP scratch file: ") + strerror(error));
+	}
+	scratch_mappings.insert(p);
+	scratch_mapping_count += 1;
+	return p;
+}
+
+
+bool scratch_deallocate(void* p, size_t bytes) {
+	if (scratch_mapping_count == 0) {
+		return false;
+	}
+	lock_guard<mutex> lock(scratch_mutex);
+	if (scratch_mappings.erase(p) == 0) {
+		return false;
+	}
+	scratch_mapping_count -= 1;
+	munmap(p, bytes);
+	return true;
+}
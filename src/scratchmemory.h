@@ -0,0 +1,57 @@
+#ifndef SCRATCH_MEMORY_H
+#define SCRATCH_MEMORY_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+
+/** Out-of-core storage for large DP columns.
+ *
+ *  When a scratch directory is set, allocations of at least the given number of bytes
+ *  are backed by memory-mapped (and already unlinked) files in that directory instead
+ *  of anonymous memory. The operating system then writes these pages to the scratch
+ *  file instead of keeping them all in RAM. Since DP columns are traversed in Gray code
+ *  order, which stays within aligned blocks of rows for long stretches, pages are
+ *  effectively streamed in chunks.
+ */
+
+/** Enables file-backed allocations of at least threshold bytes in the given directory.
+ *  An empty directory disables them. */
+void set_scratch_directory(const std::string& directory, size_t threshold);
+
+/** Returns memory backed by a scratch file, or nullptr if scratch files are disabled
+ *  or bytes is below the threshold. */
+void* scratch_allocate(size_t bytes);
+
+/** Releases memory if it was obtained from scratch_allocate and returns whether it was. */
+bool scratch_deallocate(void* p, size_t bytes);
+
+/** Allocator that uses scratch files for large allocations and operator new otherwise. */
+template <typename T>
+class ScratchAllocator {
+public:
+	typedef T value_type;
+
+	ScratchAllocator() {}
+	template <typename U> ScratchAllocator(const ScratchAllocator<U>&) {}
+
+	T* allocate(size_t n) {
+		void* p = scratch_allocate(n * sizeof(T));
+		if (p == nullptr) {
+			p = ::operator new(n * sizeof(T));
+		}
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t n) {
+		if (!scratch_deallocate(p, n * sizeof(T))) {
+			::operator delete(p);
+		}
+	}
+
+	template <typename U> bool operator==(const ScratchAllocator<U>&) const { return true; }
+	template <typename U> bool operator!=(const ScratchAllocator<U>&) const { return false; }
+};
+
+#endif
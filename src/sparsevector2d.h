@@ -0,0 +1,152 @@
+#ifndef SPARSE_VECTOR_2D_H
+#define SPARSE_VECTOR_2D_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "scratchmemory.h"
+#include "vector2d.h"
+
+/** Read-only two-dimensional array that can drop small entries and store only the remaining ones.
+ *
+ *  It takes over the storage of a dense Vector2D. Without a threshold, or if most entries are
+ *  kept, that Vector2D is used as it is (with dropped entries set to zero), since column indices
+ *  would then take more space than the zeros they save. Otherwise, only the kept entries of each
+ *  row are stored, together with their column indices.
+ */
+template <typename T>
+class SparseVector2D {
+public:
+	/** Takes over dense, dropping all entries below threshold. Their sum is available from
+	 *  get_discarded(). With the default threshold, nothing is dropped or copied. */
+	SparseVector2D(Vector2D<T>&& dense_column, const T& threshold = T()) : size0(dense_column.get_size0()), size1(dense_column.get_size1()), discarded(), stored_densely(true) {
+		if (threshold == T()) {
+			dense = std::move(dense_column);
+			return;
+		}
+		size_t kept = 0;
+		for (size_t i = 0; i < size0; ++i) {
+			for (size_t j = 0; j < size1; ++j) {
+				if (keep(dense_column.at(i, j), threshold)) {
+					kept += 1;
+				}
+			}
+		}
+		stored_densely = kept * (sizeof(T) + sizeof(uint32_t)) + (size0 + 1) * sizeof(size_t) >= size0 * size1 * sizeof(T);
+		if (stored_densely) {
+			for (size_t i = 0; i < size0; ++i) {
+				for (size_t j = 0; j < size1; ++j) {
+					T& value = dense_column.at(i, j);
+					if (!keep(value, threshold)) {
+						discarded += value;
+						value = T();
+					}
+				}
+			}
+			dense = std::move(dense_column);
+			return;
+		}
+		row_start.assign(size0 + 1, 0);
+		values.reserve(kept);
+		indices.reserve(kept);
+		for (size_t i = 0; i < size0; ++i) {
+			for (size_t j = 0; j < size1; ++j) {
+				const T& value = dense_column.at(i, j);
+				if (keep(value, threshold)) {
+					values.push_back(value);
+					indices.push_back(j);
+				} else {
+					discarded += value;
+				}
+			}
+			row_start[i + 1] = values.size();
+		}
+	}
+
+	/** Returns the entry at the given position (zero if it is not stored). */
+	T at(size_t index0, size_t index1) const {
+		if (stored_densely) {
+			return dense.at(index0, index1);
+		}
+		auto begin = indices.begin() + row_start[index0];
+		auto end = indices.begin() + row_start[index0 + 1];
+		auto it = std::lower_bound(begin, end, index1);
+		if ((it == end) || (*it != index1)) {
+			return T();
+		}
+		return values[it - indices.begin()];
+	}
+
+	/** Calls f(index1, value) for the non-zero entries of a row in increasing order of index1. */
+	template <typename F>
+	void for_each_in_row(size_t index0, F f) const {
+		if (stored_densely) {
+			for (size_t j = 0; j < size1; ++j) {
+				const T& value = dense.at(index0, j);
+				if (value != T()) {
+					f(j, value);
+				}
+			}
+			return;
+		}
+		for (size_t k = row_start[index0]; k < row_start[index0 + 1]; ++k) {
+			f(indices[k], values[k]);
+		}
+	}
+
+	/** Returns whether all entries of a row are zero. */
+	bool is_row_empty(size_t index0) const {
+		if (stored_densely) {
+			for (size_t j = 0; j < size1; ++j) {
+				if (dense.at(index0, j) != T()) {
+					return false;
+				}
+			}
+			return true;
+		}
+		return row_start[index0] == row_start[index0 + 1];
+	}
+
+	void divide_entries_by(T val) {
+		if (stored_densely) {
+			dense.divide_entries_by(val);
+			return;
+		}
+		for (auto& value : values) {
+			value /= val;
+		}
+	}
+
+	/** Sum of the entries dropped at construction. */
+	T get_discarded() const {
+		return discarded;
+	}
+
+	size_t get_size0() const {
+		return size0;
+	}
+
+	size_t get_size1() const {
+		return size1;
+	}
+
+private:
+	static bool keep(const T& value, const T& threshold) {
+		return (value != T()) && !(value < threshold);
+	}
+
+	size_t size0;
+	size_t size1;
+	T discarded;
+	bool stored_densely;
+	// all entries (only used if rows are stored densely)
+	Vector2D<T> dense;
+	// values of row i are values[row_start[i]] to values[row_start[i+1]-1] (only used if rows are stored sparsely)
+	std::vector<size_t, ScratchAllocator<size_t> > row_start;
+	std::vector<uint32_t, ScratchAllocator<uint32_t> > indices;
+	std::vector<T, ScratchAllocator<T> > values;
+};
+
+#endif
@@ -8,9 +8,14 @@
 #include "../columniterator.h"
 #include "../pedigreepartitions.h"
 #include "../backwardcolumniterator.h"
+#include "../columnsource.h"
 #include "../entry.h"
 #include "../transitionprobabilitycomputer.h"
 #include "../vector2d.h"
+#include "../graycodes.h"
+#include "../bitgather.h"
+#include "../columnindexingscheme.h"
+#include "../columnindexingiterator.h"
 
 #include <iostream>
 #include <string>
@@ -32,6 +37,16 @@ size_t popcount(size_t x) {
 }
 
 
+// diploid heterozygous genotypes for n variants (ownership is passed to the Pedigree)
+std::vector<Genotype*> heterozygous_genotypes(size_t n) {
+    std::vector<Genotype*> genotypes;
+    for (size_t i = 0; i < n; ++i) {
+        genotypes.push_back(new Genotype(1, 2));
+    }
+    return genotypes;
+}
+
+
 ReadSet* string_to_readset(string s, string weights, bool use){
     ReadSet* read_set = new ReadSet;
     stringstream s1(s);
@@ -168,17 +183,17 @@ TEST_CASE("test transition prob computer", "[test transition prob computer]"){
         std::vector<PhredGenotypeLikelihoods*> gl_child;
 
         for(unsigned int i = 0; i < positions->size(); i++){
-            PhredGenotypeLikelihoods* n_m = new PhredGenotypeLikelihoods(1/3.0,1/3.0,1/3.0);
-            PhredGenotypeLikelihoods* n_f = new PhredGenotypeLikelihoods(1/3.0,1/3.0,1/3.0);
-            PhredGenotypeLikelihoods* n_c = new PhredGenotypeLikelihoods(1/3.0,1/3.0,1/3.0);
+            PhredGenotypeLikelihoods* n_m = new PhredGenotypeLikelihoods({1/3.0,1/3.0,1/3.0}, 2);
+            PhredGenotypeLikelihoods* n_f = new PhredGenotypeLikelihoods({1/3.0,1/3.0,1/3.0}, 2);
+            PhredGenotypeLikelihoods* n_c = new PhredGenotypeLikelihoods({1/3.0,1/3.0,1/3.0}, 2);
             gl_mother.push_back(n_m);
             gl_father.push_back(n_f);
             gl_child.push_back(n_c);
         }
 
-        pedigree->addIndividual(0, std::vector<unsigned int >(positions->size(),1), gl_mother);
-        pedigree->addIndividual(1, std::vector<unsigned int >(positions->size(),1), gl_father);
-        pedigree->addIndividual(2, std::vector<unsigned int >(positions->size(),1), gl_child);
+        pedigree->addIndividual(0, heterozygous_genotypes(positions->size()), gl_mother);
+        pedigree->addIndividual(1, heterozygous_genotypes(positions->size()), gl_father);
+        pedigree->addIndividual(2, heterozygous_genotypes(positions->size()), gl_child);
         pedigree->addRelationship(0,1,2);
 
         // create all pedigree partitions
@@ -240,17 +255,17 @@ TEST_CASE("test transition prob computer", "[test transition prob computer]"){
         std::vector<PhredGenotypeLikelihoods*> gl_child;
 
         for(unsigned int i = 0; i < positions->size(); i++){
-            PhredGenotypeLikelihoods* n_m = new PhredGenotypeLikelihoods(0,1,0);
-            PhredGenotypeLikelihoods* n_f = new PhredGenotypeLikelihoods(0,1,0);
-            PhredGenotypeLikelihoods* n_c = new PhredGenotypeLikelihoods(0.25,0.5,0.25);
+            PhredGenotypeLikelihoods* n_m = new PhredGenotypeLikelihoods({0,1,0}, 2);
+            PhredGenotypeLikelihoods* n_f = new PhredGenotypeLikelihoods({0,1,0}, 2);
+            PhredGenotypeLikelihoods* n_c = new PhredGenotypeLikelihoods({0.25,0.5,0.25}, 2);
             gl_mother.push_back(n_m);
             gl_father.push_back(n_f);
             gl_child.push_back(n_c);
         }
 
-        pedigree->addIndividual(0, std::vector<unsigned int >(positions->size(),1), gl_mother);
-        pedigree->addIndividual(1, std::vector<unsigned int >(positions->size(),1), gl_father);
-        pedigree->addIndividual(2, std::vector<unsigned int >(positions->size(),1), gl_child);
+        pedigree->addIndividual(0, heterozygous_genotypes(positions->size()), gl_mother);
+        pedigree->addIndividual(1, heterozygous_genotypes(positions->size()), gl_father);
+        pedigree->addIndividual(2, heterozygous_genotypes(positions->size()), gl_child);
         pedigree->addRelationship(0,1,2);
 
         // create all pedigree partitions
@@ -300,11 +315,11 @@ TEST_CASE("test transition prob computer", "[test transition prob computer]"){
 
        std::vector<PhredGenotypeLikelihoods*> gl;
        for(unsigned int i = 0; i < positions->size(); i++){
-           PhredGenotypeLikelihoods* n = new PhredGenotypeLikelihoods(1/3.0,1/3.0,1/3.0);
+           PhredGenotypeLikelihoods* n = new PhredGenotypeLikelihoods({1/3.0,1/3.0,1/3.0}, 2);
            gl.push_back(n);
        }
 
-       pedigree->addIndividual(0, std::vector<unsigned int >(positions->size(),1), gl);
+       pedigree->addIndividual(0, heterozygous_genotypes(positions->size()), gl);
        std::vector<PedigreePartitions*> pedigree_partitions;
 
 
@@ -345,7 +360,7 @@ TEST_CASE("test column_cost_computer","[test column_cost_computer]"){
         std::vector<PhredGenotypeLikelihoods*> genotype_likelihoods(positions->size(),nullptr);
         std::vector<unsigned int> recombcost(positions->size(), 1);
         Pedigree* pedigree = new Pedigree;
-        pedigree->addIndividual(0, std::vector<unsigned int >(positions->size(),1), genotype_likelihoods);
+        pedigree->addIndividual(0, heterozygous_genotypes(positions->size()), genotype_likelihoods);
 
         // create all pedigree partitions
         std::vector<PedigreePartitions*> pedigree_partitions;
@@ -464,6 +479,38 @@ TEST_CASE("test BackwardColumnIterator", "[test BackwardColumnIterator]") {
     }
 }
 
+TEST_CASE("test ColumnSource", "[test ColumnSource]") {
+    std::vector<std::string> matrices = {"10 \n010\n000", "01 \n000\n111", "0 1\n1 0\n 11"};
+    std::vector<std::string> weights = {"11 \n111\n111", "11 \n111\n111", "1 1\n1 1\n 11"};
+
+    for(unsigned int i = 0; i < matrices.size(); i++){
+        ReadSet* read_set = string_to_readset(matrices[i], weights[i],false);
+        vector<string> columns = get_columns(matrices[i],3);
+        std::shared_ptr<const ColumnSource> source = std::make_shared<const ColumnSource>(*read_set);
+        REQUIRE(source->get_column_count() == 3);
+
+        // random access in arbitrary order
+        for(int j : {2, 0, 1}){
+            auto col = source->get_column(j);
+            REQUIRE(col->size() == source->get_column_size(j));
+            REQUIRE(std::equal(col->begin(), col->end(), source->column_begin(j)));
+            REQUIRE(compare_entries(*col,columns[j]));
+        }
+
+        // both directions share the same columns
+        ColumnIterator forward(source);
+        BackwardColumnIterator backward(source);
+        for(int j = 0; j < 3; j++){
+            REQUIRE(*forward.get_next() == *source->get_column(j));
+            REQUIRE(*backward.get_next() == *source->get_column(2-j));
+        }
+        REQUIRE(!forward.has_next());
+        REQUIRE(!backward.has_next());
+
+        delete read_set;
+    }
+}
+
 TEST_CASE("test scaling of vector", "[test scaling of vector]"){
     Vector2D<long double> test(2,3,0.8L);
     test.divide_entries_by(0.8L);
@@ -474,3 +521,59 @@ TEST_CASE("test scaling of vector", "[test scaling of vector]"){
         }
     }
 }
+
+TEST_CASE("test GrayCodes", "[test GrayCodes]"){
+    GrayCodes graycodes(4);
+    unsigned int previous = 0;
+    int changed_bit = 0;
+    vector<bool> seen(16, false);
+    for (int k = 0; k < 16; k++) {
+        REQUIRE(graycodes.has_next());
+        unsigned int code = graycodes.get_next(&changed_bit);
+        // reflected binary Gray code
+        REQUIRE(code == (k ^ (k >> 1)));
+        if (k == 0) {
+            REQUIRE(changed_bit == -1);
+        } else {
+            REQUIRE((previous ^ code) == (1u << changed_bit));
+        }
+        REQUIRE(!seen[code]);
+        seen[code] = true;
+        previous = code;
+    }
+    REQUIRE(!graycodes.has_next());
+}
+
+TEST_CASE("test gather_bits", "[test gather_bits]"){
+    vector<unsigned int> masks = {0u, 1u, 0x80000000u, 0xffffffffu, 0xf0f0u, 0x12345678u, 0x8000ff01u};
+    for (unsigned int mask : masks) {
+        for (unsigned int value : {0u, 0xffffffffu, 0xdeadbeefu, 0x13579bdfu}) {
+            unsigned int expected = 0;
+            int k = 0;
+            for (int bit = 0; bit < 32; bit++) {
+                if (mask & (1u << bit)) {
+                    if (value & (1u << bit)) expected |= 1u << k;
+                    k++;
+                }
+            }
+            REQUIRE(gather_bits(value, mask) == expected);
+            REQUIRE(gather_bits_portable(value, mask) == expected);
+        }
+    }
+}
+
+TEST_CASE("test ColumnIndexingIterator forward projection", "[test ColumnIndexingIterator]"){
+    ColumnIndexingScheme column(nullptr, {1, 2, 4, 5, 7});
+    ColumnIndexingScheme next(&column, {2, 5, 7, 8});
+    column.set_next_column(&next);
+    unique_ptr<ColumnIndexingIterator> iterator = column.get_iterator();
+    while (iterator->has_next()) {
+        iterator->advance();
+        unsigned int index = iterator->get_index();
+        // reads 2, 5 and 7 are at bits 1, 3 and 4
+        unsigned int expected = ((index >> 1) & 1) | (((index >> 3) & 1) << 1) | (((index >> 4) & 1) << 2);
+        REQUIRE(iterator->get_forward_projection() == expected);
+        REQUIRE(iterator->index_forward_projection(index) == expected);
+    }
+    REQUIRE(next.get_backward_projection_width() == 3);
+}
@@ -6,6 +6,9 @@
 #include <iomanip>
 #include <algorithm>
 
+#include "scratchmemory.h"
+
+/** Two-dimensional array. Large arrays may be backed by scratch files (see scratchmemory.h). */
 template <typename T>
 class Vector2D {
 public:
@@ -63,7 +66,7 @@ public:
 private:
 	size_t size0;
 	size_t size1;
-	std::vector<T> v;
+	std::vector<T, ScratchAllocator<T> > v;
 };
 
 #endif
@@ -1,8 +1,12 @@
+from types import SimpleNamespace
+
 from pytest import raises
 from whatshap.bam import (
+    AlignmentWithSourceID,
     SampleBamReader,
     SampleNotFoundError,
     AlignmentFileNotIndexedError,
+    merge_by_position,
 )
 
 
@@ -30,3 +34,34 @@ def test_read_cram():
 def test_no_index():
     with raises(AlignmentFileNotIndexedError):
         SampleBamReader("tests/data/not-indexed.bam")
+
+
+def test_fetch_samples():
+    sbr = SampleBamReader("tests/data/ped_samples.bam")
+    samples = ["HG004", "HG002", "HG003"]
+    expected = sorted(
+        (sample, a.bam_alignment.query_name, a.bam_alignment.reference_start)
+        for sample in samples
+        for a in sbr.fetch("1", sample)
+    )
+    fetched = [
+        (sample, a.bam_alignment.query_name, a.bam_alignment.reference_start)
+        for sample, a in sbr.fetch_samples("1", samples + ["non-existing-sample"])
+    ]
+    assert len(fetched) > 0
+    assert sorted(fetched) == expected
+
+
+def test_merge_by_position():
+    def alignments(source_id, positions):
+        return [
+            AlignmentWithSourceID(source_id, SimpleNamespace(reference_start=pos, index=i))
+            for i, pos in enumerate(positions)
+        ]
+
+    files = [alignments(0, [5, 5, 9]), alignments(1, []), alignments(2, [1, 5, 20, 30])]
+    merged = [
+        (a.bam_alignment.reference_start, a.source_id, a.bam_alignment.index)
+        for a in merge_by_position(list(enumerate(files)))
+    ]
+    assert merged == [(1, 2, 0), (5, 0, 0), (5, 0, 1), (5, 2, 1), (9, 0, 2), (20, 2, 2), (30, 2, 3)]
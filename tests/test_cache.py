@@ -0,0 +1,103 @@
+from whatshap.cache import ResultCache, CachedResult, independent_segments, problem_key
+from whatshap.core import PedigreeDPTable, Pedigree, NumericSampleIds, Genotype
+from whatshap.testhelpers import string_to_readset
+
+
+def make_problem(reads):
+    readset = string_to_readset(reads)
+    readset.sort()
+    positions = sorted(readset.get_positions())
+    numeric_sample_ids = NumericSampleIds()
+    pedigree = Pedigree(numeric_sample_ids)
+    pedigree.add_individual("sample", [Genotype([0, 1])] * len(positions))
+    return readset, pedigree, positions
+
+
+READS = """
+    0110
+    01 1
+     011
+    1001
+    """
+
+
+def test_problem_key():
+    readset, pedigree, positions = make_problem(READS)
+    key = problem_key(readset, pedigree, ["sample"], positions, ("whatshap", False))
+    assert key == problem_key(readset, pedigree, ["sample"], positions, ("whatshap", False))
+    assert key != problem_key(readset, pedigree, ["sample"], positions, ("whatshap", True))
+
+    readset2, pedigree2, _ = make_problem(READS.replace("1001", "1000"))
+    assert key != problem_key(readset2, pedigree2, ["sample"], positions, ("whatshap", False))
+
+
+def test_result_cache(tmp_path):
+    readset, pedigree, positions = make_problem(READS)
+    dp_table = PedigreeDPTable(readset, [10] * len(positions), pedigree, False, positions)
+    superreads_list, transmission_vector = dp_table.get_super_reads()
+
+    cache = ResultCache(str(tmp_path))
+    key = problem_key(readset, pedigree, ["sample"], positions, ())
+    assert cache.get(key) is None
+    cache.put(key, CachedResult.from_dp_table(dp_table))
+    result = cache.get(key)
+    assert (cache.hits, cache.misses) == (1, 1)
+
+    assert result.get_optimal_cost() == dp_table.get_optimal_cost()
+    assert result.get_optimal_partitioning() == list(dp_table.get_optimal_partitioning())
+    cached_superreads_list, cached_transmission_vector = result.get_super_reads()
+    assert cached_transmission_vector == list(transmission_vector)
+    assert len(cached_superreads_list) == len(superreads_list) == 1
+    for cached, expected in zip(cached_superreads_list[0], superreads_list[0]):
+        assert cached.name == expected.name
+        assert cached.sample_id == expected.sample_id
+        assert list(cached) == list(expected)
+
+
+def test_concatenate_independent_segments():
+    # The reads connect variants 0-3 and 4-6, but not 3 and 4
+    readset, pedigree, positions = make_problem(
+        """
+        0110
+        01 1
+         011
+        1001
+            101
+             10
+            1 1
+        """
+    )
+    segments = independent_segments(readset, positions)
+    assert segments == [(0, 4), (4, 7)]
+
+    results = []
+    read_indices = []
+    for start, stop in segments:
+        indices = [
+            i
+            for i, read in enumerate(readset)
+            if positions[start] <= read[0].position <= positions[stop - 1]
+        ]
+        segment_pedigree = Pedigree(NumericSampleIds())
+        segment_pedigree.add_individual("sample", [Genotype([0, 1])] * (stop - start))
+        dp_table = PedigreeDPTable(
+            readset.subset(indices),
+            [10] * (stop - start),
+            segment_pedigree,
+            False,
+            positions[start:stop],
+        )
+        results.append(CachedResult.from_dp_table(dp_table))
+        read_indices.append(indices)
+    assert sorted(sum(read_indices, [])) == list(range(len(readset)))
+    result = CachedResult.concatenate(results, read_indices, len(readset))
+
+    dp_table = PedigreeDPTable(readset, [10] * len(positions), pedigree, False, positions)
+    expected = CachedResult.from_dp_table(dp_table)
+    assert result.get_optimal_cost() == expected.get_optimal_cost()
+    assert result.get_optimal_partitioning() == expected.get_optimal_partitioning()
+    superreads_list, transmission_vector = result.get_super_reads()
+    expected_superreads_list, expected_transmission_vector = expected.get_super_reads()
+    assert transmission_vector == expected_transmission_vector
+    for superread, expected_superread in zip(superreads_list[0], expected_superreads_list[0]):
+        assert list(superread) == list(expected_superread)
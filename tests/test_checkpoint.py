@@ -0,0 +1,117 @@
+import json
+
+from pytest import raises
+
+from whatshap.checkpoint import WorkDirectory, WorkDirectoryError, run_fingerprint
+from whatshap.timer import StageTimer
+
+
+class FakeWriter:
+    """Stands in for a VcfAugmenter; records are plain strings"""
+
+    def __init__(self, records):
+        self.records = records  # dict that maps chromosome to records
+        self.output = []
+        self._part = None
+
+    def _write(self, record):
+        if self._part is not None:
+            self._part.append(record)
+        else:
+            self.output.append(record)
+
+    def write(self, chromosome):
+        for record in self.records[chromosome]:
+            self._write(record)
+
+    def skip(self, chromosome):
+        pass
+
+    def begin_part(self, path):
+        self._path = path
+        self._part = []
+
+    def end_part(self):
+        with open(self._path, "w") as f:
+            json.dump(self._part, f)
+        self._part = None
+
+    def append_part(self, path):
+        with open(path) as f:
+            self.output.extend(json.load(f))
+
+
+RECORDS = {"chr1": ["a", "b"], "chr2": ["c"], "chr3": ["d", "e"]}
+
+
+def run(work_dir, fingerprint, interrupt_at=None):
+    timers = StageTimer()
+    work_directory = WorkDirectory(work_dir, fingerprint, timers)
+    writer = FakeWriter(RECORDS)
+    processed = []
+    for chromosome in RECORDS:
+        if work_directory.is_finished(chromosome):
+            work_directory.skip(chromosome, [writer])
+            continue
+        if chromosome == interrupt_at:
+            raise KeyboardInterrupt()
+        work_directory.begin(chromosome, [writer])
+        with timers("phase"):
+            writer.write(chromosome)
+        processed.append(chromosome)
+        work_directory.finish({"reads": len(RECORDS[chromosome])})
+    work_directory.concatenate([writer])
+    return writer.output, processed, work_directory, timers
+
+
+def test_resume(tmp_path):
+    work_dir = str(tmp_path / "work")
+    fingerprint = {"command": "phase", "parameters": {"max_coverage": 15, "samples": ("A",)}}
+    with raises(KeyboardInterrupt):
+        run(work_dir, fingerprint, interrupt_at="chr3")
+
+    output, processed, work_directory, timers = run(work_dir, fingerprint)
+    assert output == ["a", "b", "c", "d", "e"]
+    assert processed == ["chr3"]
+    assert work_directory.resumed == 2
+    assert work_directory.statistics() == {"reads": 5}
+    assert timers.elapsed("phase") > 0
+
+    # Nothing left to do
+    output, processed, work_directory, _ = run(work_dir, fingerprint)
+    assert output == ["a", "b", "c", "d", "e"]
+    assert processed == []
+    assert work_directory.resumed == 3
+
+
+def test_missing_part_is_recomputed(tmp_path):
+    fingerprint = {"command": "phase"}
+    run(str(tmp_path), fingerprint)
+    manifest = json.loads((tmp_path / "manifest.json").read_text())
+    (tmp_path / manifest["chromosomes"][1]["parts"][0]).unlink()
+    output, processed, _, _ = run(str(tmp_path), fingerprint)
+    assert output == ["a", "b", "c", "d", "e"]
+    assert processed == ["chr2"]
+
+
+def test_different_fingerprint(tmp_path):
+    run(str(tmp_path), {"command": "phase", "parameters": {"max_coverage": 15}})
+    with raises(WorkDirectoryError):
+        run(str(tmp_path), {"command": "phase", "parameters": {"max_coverage": 10}})
+
+
+def test_run_fingerprint(tmp_path):
+    path = tmp_path / "input.vcf"
+    path.write_text("x")
+    fingerprint1 = run_fingerprint("phase", [str(path)], {"indels": True})
+    assert fingerprint1 == run_fingerprint("phase", [str(path)], {"indels": True})
+    path.write_text("xy")
+    assert fingerprint1 != run_fingerprint("phase", [str(path)], {"indels": True})
+
+
+def test_timer_add():
+    timers = StageTimer()
+    timers.add({"phase": 2.0, "select": 1.0}, total=5.0)
+    assert timers.elapsed_times() == {"phase": 2.0, "select": 1.0}
+    assert timers.sum() == 3.0
+    assert timers.total() >= 5.0
@@ -0,0 +1,69 @@
+import random
+
+from pytest import raises
+
+from whatshap.core import ComponentFinder, Read, ReadSet
+from whatshap.graph import ComponentFinder as PythonComponentFinder
+from whatshap.cli.phase import find_components, best_case_blocks
+from whatshap.testhelpers import string_to_readset
+
+
+def test_merge_and_find():
+    finder = ComponentFinder([50, 10, 30, 20, 40, 30])
+    assert len(finder) == 5
+    finder.merge(40, 20)
+    finder.merge(50, 40)
+    assert finder.find(50) == 20
+    assert finder.find(10) == 10
+    assert finder.components() == [10, 20, 30, 20, 20]
+    with raises(RuntimeError):
+        finder.find(15)
+
+
+def test_random_merges_like_python_implementation():
+    rng = random.Random(4)
+    positions = sorted(rng.sample(range(100000), 500))
+    finder = ComponentFinder(positions)
+    python_finder = PythonComponentFinder(positions)
+    for _ in range(300):
+        x, y = rng.sample(positions, 2)
+        finder.merge(x, y)
+        python_finder.merge(x, y)
+    assert finder.components() == [python_finder.find(position) for position in positions]
+
+
+def test_find_components():
+    reads = string_to_readset(
+        """
+        11
+         01
+            11
+             101
+        """
+    )
+    positions = reads.get_positions()
+    components = find_components(positions, reads)
+    assert components == {10: 10, 20: 10, 30: 10, 50: 50, 60: 50, 70: 50, 80: 50}
+    components = find_components(positions, reads, master_block=[30, 70])
+    assert set(components.values()) == {10}
+    assert best_case_blocks(reads) == (2, 2)
+
+
+def test_restrict_to_superread_heterozygous():
+    reads = string_to_readset(
+        """
+        111
+          111
+        """
+    )
+    superreads = ReadSet()
+    for name, alleles in [("sr1", [0, 1, 1, 0, 1]), ("sr2", [1, 0, 1, 1, 0])]:
+        read = Read(name, 0, 0, 0)
+        for i, allele in enumerate(alleles):
+            read.add_variant((i + 1) * 10, allele, 0)
+        superreads.add(read)
+    finder = ComponentFinder(reads.get_positions())
+    assert finder.restrict_to_superread_heterozygous(0, superreads) == [30]
+    finder.add_reads(reads)
+    # Position 30 is homozygous and no longer connects the two reads
+    assert finder.components() == [10, 10, 30, 40, 40]
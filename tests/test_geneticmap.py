@@ -1,5 +1,12 @@
 import pytest
-from whatshap.pedigree import GeneticMapRecombinationCostComputer, ParseError
+from whatshap.core import GeneticMap, uniform_recombination_costs
+from whatshap.pedigree import (
+    GeneticMapRecombinationCostComputer,
+    ParseError,
+    RecombinationMapEntry,
+    centimorgen_to_phred,
+    recombination_cost_map,
+)
 
 
 def test_read_genetic_map(tmp_path):
@@ -29,3 +36,42 @@ def test_invalid_float(tmp_path):
     path.write_text("ignored header\n" "55550 0 abc\n")
     with pytest.raises(ParseError):
         _ = GeneticMapRecombinationCostComputer(str(path))
+
+
+def test_genetic_map_interpolation():
+    genetic_map = GeneticMap([100, 200, 300], [0.0, 1.0, 1.5])
+    assert len(genetic_map) == 3
+    # left of the map, on an entry, between entries and extrapolated to the right
+    distances = genetic_map.cumulative_distances([50, 100, 150, 300, 500])
+    assert distances == pytest.approx([0.0, 0.0, 0.5, 1.5, 2.5])
+    costs = genetic_map.recombination_costs([100, 150, 200])
+    assert costs[0] == 0
+    assert costs[1] == costs[2] == round(centimorgen_to_phred(0.5))
+
+
+def test_recombination_cost_map_minimum_distance():
+    entries = [RecombinationMapEntry(100, 0.0), RecombinationMapEntry(200, 0.0)]
+    costs = recombination_cost_map(entries, [100, 150, 200])
+    assert costs[1:] == [round(centimorgen_to_phred(1e-10))] * 2
+
+
+def test_uniform_recombination_costs():
+    assert uniform_recombination_costs(1.26, [10, 1000, 2001000]) == [
+        0,
+        round(centimorgen_to_phred(990e-6 * 1.26)),
+        round(centimorgen_to_phred(2 * 1.26)),
+    ]
+
+
+def test_genetic_map_invalid():
+    with pytest.raises(ValueError):
+        GeneticMap([], [])
+    with pytest.raises(ValueError):
+        GeneticMap([200, 100], [0.0, 1.0])
+
+
+def test_unsorted_genetic_map_file(tmp_path):
+    path = tmp_path / "genetic.map"
+    path.write_text("ignored header\n" "723891 2.98 0.41\n" "568527 0 0\n")
+    with pytest.raises(ParseError):
+        _ = GeneticMapRecombinationCostComputer(str(path))
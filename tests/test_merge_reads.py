@@ -1,3 +1,6 @@
+import random
+
+from whatshap.core import Read, ReadSet
 from whatshap.merge import ReadMerger
 from whatshap.testhelpers import string_to_readset
 
@@ -64,3 +67,19 @@ def test_read_merging2():
     # error rates and thresholds so high that no merging occurs
 
     assert_variants(merged_reads, reads)
+
+
+def test_read_merging_threads():
+    rng = random.Random(0)
+    reads = ReadSet()
+    for i in range(300):
+        read = Read("read{}".format(i), 50, 0)
+        start = rng.randrange(100)
+        for j in range(rng.randrange(2, 12)):
+            read.add_variant(start + j, rng.choice([0, 1]), rng.randrange(1, 30))
+        reads.add(read)
+    reads.sort()
+    merged = ReadMerger(0.15, 0.25, 1000, 10).merge(reads)
+    merged_parallel = ReadMerger(0.15, 0.25, 1000, 10, threads=4).merge(reads)
+    assert len(merged) < len(reads)
+    assert [list(read) for read in merged] == [list(read) for read in merged_parallel]
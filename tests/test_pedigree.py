@@ -1,4 +1,16 @@
-from whatshap.core import Pedigree, PhredGenotypeLikelihoods, NumericSampleIds
+import itertools
+import math
+
+from whatshap.core import (
+    Pedigree,
+    PhredGenotypeLikelihoods,
+    NumericSampleIds,
+    Genotype,
+    classify_genotypes,
+    mendelian_conflict_indices,
+)
+from whatshap.pedigree import mendelian_conflict
+from whatshap.vcf import GenotypeLikelihoods
 from whatshap.testhelpers import canonic_index_list_to_biallelic_gt_list
 
 
@@ -46,3 +58,51 @@ def test_pedigree_with_gls():
         assert list(ped.genotype_likelihoods("sample1", i)) == list(gls1[i])
         assert ped.genotype("sample5", i) == genotypes5[i]
         assert list(ped.genotype_likelihoods("sample5", i)) == list(gls5[i])
+
+
+def test_pedigree_with_log10_likelihoods():
+    genotypes = canonic_index_list_to_biallelic_gt_list([0, 1, 2, 1])
+    gls = [
+        GenotypeLikelihoods([math.log10(x) for x in [1e-10, 0.5, 0.002]]),
+        None,
+        GenotypeLikelihoods([-3.25, -0.05, -1.75]),
+        GenotypeLikelihoods([-0.5, -0.5, -0.5]),
+    ]
+    for regularizer in (None, 0.01):
+        ped = Pedigree(NumericSampleIds())
+        ped.add_individual_with_log10_likelihoods("sample", genotypes, gls, 30, regularizer)
+        assert ped.variant_count == 4
+        for i, gl in enumerate(gls):
+            assert ped.genotype("sample", i) == genotypes[i]
+            if gl is None:
+                expected = [30, 0, 30]
+            else:
+                expected = list(gl.as_phred(regularizer=regularizer))
+            assert list(ped.genotype_likelihoods("sample", i)) == expected
+
+
+def test_mendelian_conflict_indices():
+    genotypes = canonic_index_list_to_biallelic_gt_list([0, 1, 2])
+    mother, father, child = [], [], []
+    for gt_mother, gt_father, gt_child in itertools.product(genotypes, repeat=3):
+        mother.append(gt_mother)
+        father.append(gt_father)
+        child.append(gt_child)
+    expected = [i for i, gts in enumerate(zip(mother, father, child)) if mendelian_conflict(*gts)]
+    assert mendelian_conflict_indices(mother, father, child) == expected
+    # a missing genotype never conflicts
+    assert mendelian_conflict_indices([Genotype([])], [genotypes[0]], [genotypes[2]]) == []
+    # a child that is not diploid always conflicts
+    mother, father = genotypes[1], genotypes[1]
+    children = [Genotype([0]), Genotype([1]), Genotype([0, 0, 1])]
+    assert mendelian_conflict_indices([mother] * 3, [father] * 3, children) == [0, 1, 2]
+
+
+def test_classify_genotypes():
+    genotypes1 = canonic_index_list_to_biallelic_gt_list([0, 1, 0, 2])
+    genotypes2 = canonic_index_list_to_biallelic_gt_list([0, 0, 1, 2])
+    genotypes2[3] = Genotype([])
+    missing, heterozygous, homozygous = classify_genotypes([genotypes1, genotypes2])
+    assert missing == {3}
+    assert heterozygous == {1, 2}
+    assert homozygous == {0, 1, 2, 3}
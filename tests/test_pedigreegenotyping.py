@@ -2,6 +2,9 @@
 Test genotyping of pedigrees
 """
 import math
+import random
+
+import pytest
 
 from whatshap.core import (
     GenotypeDPTable,
@@ -14,6 +17,7 @@ from whatshap.core import (
 from whatshap.testhelpers import (
     string_to_readset_pedigree,
     canonic_index_list_to_biallelic_gt_list,
+    random_family_readset,
 )
 
 
@@ -856,3 +860,71 @@ def test_genotyping_trio14():
     genotype_pedigree(
         numeric_sample_ids, reads, recombcost, pedigree, expected_genotypes, scaling=1000
     )
+
+
+def test_approximate_genotyping():
+    rng = random.Random(11)
+    for _ in range(50):
+        samples = ["individual0", "individual1", "individual2"][: rng.choice([1, 3])]
+        trios = [("individual0", "individual1", "individual2")] if len(samples) == 3 else []
+        numeric_sample_ids, pedigree, positions, readset = random_family_readset(
+            rng,
+            samples,
+            trios,
+            max_variants=20,
+            max_reads=12,
+            max_span=6,
+            qualities=(10, 20, 30),
+            unknown_genotypes=True,
+        )
+        recombcost = [rng.choice([5, 30]) for _ in positions]
+
+        exact = GenotypeDPTable(numeric_sample_ids, readset, recombcost, pedigree, positions)
+        assert exact.get_max_discarded_fraction() == 0
+        approximate = GenotypeDPTable(
+            numeric_sample_ids, readset, recombcost, pedigree, positions, epsilon=1e-9
+        )
+        assert 0 <= approximate.get_max_discarded_fraction() < 1
+        coarse = GenotypeDPTable(
+            numeric_sample_ids, readset, recombcost, pedigree, positions, epsilon=0.1
+        )
+        for sample in samples:
+            for pos in range(len(positions)):
+                expected = list(exact.get_genotype_likelihoods(sample, pos))
+                likelihoods = list(approximate.get_genotype_likelihoods(sample, pos))
+                assert likelihoods == pytest.approx(expected, abs=1e-6)
+                assert sum(coarse.get_genotype_likelihoods(sample, pos)) == pytest.approx(1)
+
+
+def test_approximate_genotyping_discards_mass():
+    reads = """
+      A 010101
+      A 101010
+      A 0101
+      A  1010
+      A   0101
+      A 01 1 1
+      A  01010
+      A 1010 0
+    """
+    numeric_sample_ids = NumericSampleIds()
+    pedigree = Pedigree(numeric_sample_ids)
+    readset = string_to_readset_pedigree(reads)
+    readset.sort()
+    positions = sorted(readset.get_positions())
+    pedigree.add_individual(
+        "individual0",
+        [Genotype([]) for _ in positions],
+        [PhredGenotypeLikelihoods([1 / 3, 1 / 3, 1 / 3]) for _ in positions],
+    )
+    recombcost = [10] * len(positions)
+    exact = GenotypeDPTable(numeric_sample_ids, readset, recombcost, pedigree, positions)
+    approximate = GenotypeDPTable(
+        numeric_sample_ids, readset, recombcost, pedigree, positions, epsilon=1e-4
+    )
+    # some states are dropped, but the genotype likelihoods hardly change
+    assert approximate.get_max_discarded_fraction() > 0
+    for pos in range(len(positions)):
+        expected = list(exact.get_genotype_likelihoods("individual0", pos))
+        likelihoods = list(approximate.get_genotype_likelihoods("individual0", pos))
+        assert likelihoods == pytest.approx(expected, abs=1e-3)
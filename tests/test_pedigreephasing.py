@@ -1,6 +1,8 @@
 """
 Test phasing of pedigrees (PedMEC algorithm)
 """
+import itertools
+import random
 from collections import defaultdict
 from pytest import raises
 from whatshap.core import (
@@ -9,14 +11,21 @@ from whatshap.core import (
     Pedigree,
     NumericSampleIds,
     PhredGenotypeLikelihoods,
+    set_dp_scratch_directory,
 )
 from whatshap.pedigree import centimorgen_to_phred
-from whatshap.testhelpers import string_to_readset_pedigree, canonic_index_list_to_biallelic_gt_list
+from whatshap.testhelpers import (
+    string_to_readset_pedigree,
+    canonic_index_list_to_biallelic_gt_list,
+    random_family_readset,
+)
 
 
-def phase_pedigree(reads, recombcost, pedigree, distrust_genotypes=False, positions=None):
+def phase_pedigree(
+    reads, recombcost, pedigree, distrust_genotypes=False, positions=None, streaming=False
+):
     rs = string_to_readset_pedigree(reads)
-    dp_table = PedigreeDPTable(rs, recombcost, pedigree, distrust_genotypes, positions)
+    dp_table = PedigreeDPTable(rs, recombcost, pedigree, distrust_genotypes, positions, streaming)
     superreads_list, transmission_vector = dp_table.get_super_reads()
     cost = dp_table.get_optimal_cost()
     for superreads in superreads_list:
@@ -116,6 +125,206 @@ def test_phase_trio1():
     assert_trio_allele_order(superreads_list, transmission_vector, 3)
 
 
+def test_phase_trio_scratch_files(tmp_path):
+    reads = """
+      A 111
+      A 010
+      A 110
+      B 001
+      B 110
+      B 101
+      C 001
+      C 010
+      C 010
+    """
+    pedigree = Pedigree(NumericSampleIds())
+    pedigree.add_individual("individual0", canonic_index_list_to_biallelic_gt_list([1, 2, 1]))
+    pedigree.add_individual("individual1", canonic_index_list_to_biallelic_gt_list([1, 1, 1]))
+    pedigree.add_individual("individual2", canonic_index_list_to_biallelic_gt_list([0, 1, 1]))
+    pedigree.add_relationship("individual0", "individual1", "individual2")
+    recombcost = [10, 10, 10]
+    expected = phase_pedigree(reads, recombcost, pedigree)
+    # Put all DP columns into scratch files
+    set_dp_scratch_directory(tmp_path, threshold=1)
+    try:
+        superreads_list, transmission_vector, cost = phase_pedigree(reads, recombcost, pedigree)
+    finally:
+        set_dp_scratch_directory(None)
+    assert cost == expected[2]
+    assert transmission_vector == expected[1]
+    assert [[list(sr) for sr in superreads] for superreads in superreads_list] == [
+        [list(sr) for sr in superreads] for superreads in expected[0]
+    ]
+    # scratch files are unlinked right after creation
+    assert list(tmp_path.iterdir()) == []
+
+
+def test_phase_trio_streaming():
+    # The second block is not connected to the first one by any read
+    reads = """
+      A 11
+      A 01
+      B 10
+      B 11
+      C 00
+      C 01
+      A   101
+      A   011
+      B   110
+      C   111
+      C   011
+    """
+    pedigree = Pedigree(NumericSampleIds())
+    pedigree.add_individual("individual0", canonic_index_list_to_biallelic_gt_list([1] * 5))
+    pedigree.add_individual("individual1", canonic_index_list_to_biallelic_gt_list([1] * 5))
+    pedigree.add_individual("individual2", canonic_index_list_to_biallelic_gt_list([1] * 5))
+    pedigree.add_relationship("individual0", "individual1", "individual2")
+    recombcost = [3, 3, 3, 3, 3]
+    expected = phase_pedigree(reads, recombcost, pedigree)
+    superreads_list, transmission_vector, cost = phase_pedigree(
+        reads, recombcost, pedigree, streaming=True
+    )
+    assert cost == expected[2]
+    assert transmission_vector == expected[1]
+    assert [[list(sr) for sr in superreads] for superreads in superreads_list] == [
+        [list(sr) for sr in superreads] for superreads in expected[0]
+    ]
+
+
+def test_streaming_random():
+    rng = random.Random(17)
+    for _ in range(300):
+        samples = ["child", "mother", "father"][: rng.choice([1, 3])]
+        trios = [("mother", "father", "child")] if len(samples) == 3 else []
+        numeric_sample_ids, pedigree, positions, readset = random_family_readset(
+            rng, samples, trios
+        )
+        recombcost = [rng.choice([1, 5, 30]) for _ in positions]
+        results = []
+        for streaming in (False, True):
+            dp_table = PedigreeDPTable(readset, recombcost, pedigree, False, None, streaming)
+            superreads_list, transmission_vector = dp_table.get_super_reads()
+            results.append(
+                (
+                    dp_table.get_optimal_cost(),
+                    transmission_vector,
+                    [[list(sr) for sr in superreads] for superreads in superreads_list],
+                    dp_table.get_optimal_partitioning(),
+                )
+            )
+        assert results[0] == results[1]
+
+
+def test_transmission_pruning_random():
+    rng = random.Random(5)
+    for _ in range(100):
+        samples = ["A", "B", "C", "D", "E"]
+        _, pedigree, positions, readset = random_family_readset(
+            rng,
+            samples,
+            [("A", "B", "C"), ("C", "D", "E")],
+            max_variants=20,
+            max_reads=8,
+        )
+        recombcost = [rng.choice([1, 5, 30]) for _ in positions]
+        results = []
+        for margin in (None, 1000000, 0):
+            dp_table = PedigreeDPTable(readset, recombcost, pedigree, False, None, True, margin)
+            superreads_list, transmission_vector = dp_table.get_super_reads()
+            results.append(
+                (
+                    dp_table.get_optimal_cost(),
+                    transmission_vector,
+                    [[list(sr) for sr in superreads] for superreads in superreads_list],
+                    dp_table.get_optimal_partitioning(),
+                )
+            )
+        # A margin that is never exceeded gives the exact result
+        assert results[0] == results[1]
+        # Aggressive pruning gives a valid, but possibly suboptimal solution
+        assert results[2][0] >= results[0][0]
+        assert len(results[2][1]) == len(results[0][1])
+
+
+def backtrace_cost(readset, recombcost, samples, numeric_sample_ids, dp_table):
+    """
+    Recompute the cost of the solution recorded during the backtrace from its super reads,
+    transmission vector and read partitioning. Columns in which a super read has no
+    allele (because both alleles are equally good) get the best allele that is consistent
+    with the others.
+    """
+    superreads_list, transmission_vector = dp_table.get_super_reads()
+    partitioning = dp_table.get_optimal_partitioning()
+    assert len(partitioning) == len(readset)
+    positions = sorted(readset.get_positions())
+    sample_index = {numeric_sample_ids[sample]: i for i, sample in enumerate(samples)}
+    # column_reads[c] lists (individual, haplotype, allele, quality) of the reads in column c
+    column_reads = [[] for _ in positions]
+    for read, haplotype in zip(readset, partitioning):
+        for variant in read:
+            column_reads[positions.index(variant.position)].append(
+                (sample_index[read.sample_id], haplotype, variant.allele, variant.quality)
+            )
+    cost = 0
+    for c, t in enumerate(transmission_vector):
+        if c > 0:
+            cost += bin(t ^ transmission_vector[c - 1]).count("1") * recombcost[c]
+        alleles = [superreads[0][c].allele for superreads in superreads_list]
+        column_costs = []
+        # all genotypes are heterozygous, so the allele of haplotype 0 determines both
+        for choice in itertools.product([0, 1], repeat=len(samples)):
+            if any(a in (0, 1) and a != b for a, b in zip(alleles, choice)):
+                continue
+            haplotypes = [(a, 1 - a) for a in choice]
+            if len(samples) == 3:
+                # the child inherits haplotype 0 from the father and haplotype 1 from the mother
+                child, mother, father = haplotypes
+                if child != (father[(t >> 1) & 1], mother[t & 1]):
+                    continue
+            column_costs.append(
+                sum(
+                    quality
+                    for individual, haplotype, allele, quality in column_reads[c]
+                    if haplotypes[individual][haplotype] != allele
+                )
+            )
+        assert column_costs
+        cost += min(column_costs)
+    return cost
+
+
+def test_backtrace_results_random():
+    rng = random.Random(23)
+    for _ in range(300):
+        samples = ["child", "mother", "father"][: rng.choice([1, 3])]
+        trios = [("mother", "father", "child")] if len(samples) == 3 else []
+        numeric_sample_ids, pedigree, positions, readset = random_family_readset(
+            rng, samples, trios, max_reads=8
+        )
+        recombcost = [rng.choice([1, 5, 30]) for _ in positions]
+        for streaming in (False, True):
+            dp_table = PedigreeDPTable(readset, recombcost, pedigree, False, None, streaming)
+            cost = dp_table.get_optimal_cost()
+            assert (
+                backtrace_cost(readset, recombcost, samples, numeric_sample_ids, dp_table) == cost
+            )
+            if len(samples) == 1:
+                # compare with the best of all bipartitions of the reads
+                read_positions = sorted(readset.get_positions())
+                best = None
+                for partitioning in itertools.product([0, 1], repeat=len(readset)):
+                    column_costs = [[0, 0] for _ in read_positions]
+                    for read, haplotype in zip(readset, partitioning):
+                        for variant in read:
+                            column = column_costs[read_positions.index(variant.position)]
+                            for allele in (0, 1):
+                                if allele ^ haplotype != variant.allele:
+                                    column[allele] += variant.quality
+                    total = sum(min(column) for column in column_costs)
+                    best = total if best is None else min(best, total)
+                assert cost == best
+
+
 def test_phase_trio2():
     reads = """
       A 00
@@ -0,0 +1,35 @@
+from array import array
+
+from whatshap._pileup import PileupCounts
+
+
+def test_pileup_counts_candidates():
+    #            0123456789
+    reference = b"ACGTACGTAC"
+    counts = PileupCounts(0, 10, min_base_quality=5)
+    # two reads supporting a C->T SNV at position 5, one read with a low-quality T
+    counts.add(0, [(0, 10)], b"ACGTATGTAC")
+    counts.add(2, [(4, 2), (0, 6)], b"NNGTATGT", array("B", [30] * 8))
+    counts.add(3, [(0, 5)], b"TATGT", array("B", [30, 30, 4, 30, 30]))
+    counts.add(1, [(0, 9)], b"CGTACGTAC")
+
+    assert counts.candidates(reference, minabs=2, minrel=0.25) == [(5, "C", [(2, "T")])]
+    assert counts.candidates(reference, minabs=3, minrel=0.25) == []
+    assert counts.candidates(reference, minabs=2, minrel=0.7) == []
+
+
+def test_pileup_counts_deletion_and_region():
+    reference = b"ACGTACGTAC"
+    counts = PileupCounts(4, 8)
+    for _ in range(3):
+        # deletion of reference positions 4 and 5, then a mismatch at 7
+        counts.add(0, [(0, 4), (2, 2), (0, 4)], b"ACGTGGAC")
+    assert counts.candidates(reference[4:8], minabs=1, minrel=0.1) == [(7, "T", [(3, "G")])]
+
+
+def test_pileup_counts_skip_until():
+    reference = b"AAAAAAAAAA"
+    counts = PileupCounts(0, 10)
+    counts.add(0, [(0, 10)], b"AAAAACCCCC")
+    counts.add(5, [(0, 5)], b"CCCCC", skip_until=10)
+    assert counts.candidates(reference, minabs=2, minrel=0.1) == []
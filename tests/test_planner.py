@@ -0,0 +1,114 @@
+from pytest import raises
+
+from whatshap.planner import (
+    CoveragePlanner,
+    ComponentCost,
+    parse_size,
+    column_coverages,
+    component_costs,
+    dp_entries,
+    DP_BYTES_PER_ENTRY,
+    DP_ENTRIES_PER_SECOND,
+)
+from whatshap.testhelpers import string_to_readset
+
+
+def test_parse_size():
+    assert parse_size("100") == 100
+    assert parse_size("2K") == 2048
+    assert parse_size("1.5M") == 3 * 512 * 1024
+    assert parse_size("4G") == 4 * 1024 ** 3
+    assert parse_size("1GiB") == 1024 ** 3
+    with raises(ValueError):
+        parse_size("4X")
+
+
+def test_column_coverages():
+    reads = string_to_readset(
+        """
+        11
+         111
+          00
+        """
+    )
+    positions = sorted(reads.get_positions())
+    assert column_coverages(reads, positions) == [1, 2, 2, 2]
+    assert dp_entries([1, 2, 2, 2]) == 2 + 4 + 4 + 4
+    assert dp_entries([1, 2], trio_count=1) == 4 * 6
+
+
+def test_component_cost():
+    cost = ComponentCost([1, 3, 3, 5])
+    assert cost.max_coverage == 5
+    assert cost.entries(10) == 2 + 8 + 8 + 32
+    assert cost.entries(3) == 2 + 8 + 8 + 8
+
+
+def test_component_cost_with_recomputed_columns():
+    cost = ComponentCost([1, 3, 3, 5], kept=[True, False, False, True])
+    # columns that are not kept are computed twice
+    assert cost.entries(10) == 2 + 2 * 8 + 2 * 8 + 32
+    # projections have 2, 8 and 8 entries; the latter two are recomputed together
+    assert cost.peak_entries(10) == 2 + 8 + 8
+    assert cost.peak_entries(2) == 2 + 4 + 4
+
+
+# Two components: variants 10-50 covered by up to four reads and variants 70-80 by three
+TWO_COMPONENTS = """
+    11
+    101
+     0101
+      111
+      11
+       11
+          11
+          00
+          10
+    """
+
+
+def test_component_costs():
+    reads = string_to_readset(TWO_COMPONENTS)
+    _, costs = component_costs(reads, sorted(reads.get_positions()))
+    assert costs[10].coverages == [2, 3, 4, 4, 3]
+    assert costs[70].coverages == [3, 3]
+    # seven columns: every second one is kept, and the first one of each component
+    assert costs[10].kept == [True, False, True, False, True]
+    assert costs[70].kept == [True, True]
+    assert costs[10].shared == [2, 2, 3, 3, 0]
+    assert costs[70].shared == [3, 0]
+
+
+def test_plan_fills_memory_budget():
+    reads = string_to_readset(TWO_COMPONENTS)
+    # Without limitation, the projections of the first component have 4+4+8+8 entries.
+    # Those of the second and the fourth column are not kept and recomputed one at a time.
+    unlimited = CoveragePlanner(memory_budget=1000 * DP_BYTES_PER_ENTRY).plan(reads, 2)
+    assert unlimited.coverages == {10: 4, 70: 3}
+    assert unlimited.memory == (4 + 8 + 8) * DP_BYTES_PER_ENTRY
+    assert unlimited.time == (4 + 2 * 8 + 16 + 2 * 16 + 8 + 8 + 8) / DP_ENTRIES_PER_SECOND
+
+    # Memory is not shared between components, so only the first one is lowered
+    plan = CoveragePlanner(memory_budget=12 * DP_BYTES_PER_ENTRY).plan(reads, 4)
+    assert plan.coverages == {10: 2, 70: 3}
+    assert plan.memory == (4 + 4 + 4) * DP_BYTES_PER_ENTRY
+
+    groups = plan.group_reads(reads)
+    assert sorted(groups) == [2, 3]
+    assert sorted(groups[2]) == list(range(6))
+    assert sorted(groups[3]) == [6, 7, 8]
+
+
+def test_plan_fills_time_budget():
+    reads = string_to_readset(TWO_COMPONENTS)
+    # 92 entries without limitation; lowering the first component to 3X saves most
+    plan = CoveragePlanner(time_budget=80 / DP_ENTRIES_PER_SECOND).plan(reads, 4)
+    assert plan.coverages == {10: 3, 70: 3}
+    assert plan.time == (4 + 2 * 8 + 8 + 2 * 8 + 8 + 8 + 8) / DP_ENTRIES_PER_SECOND
+
+
+def test_plan_respects_trio_count():
+    reads = string_to_readset(TWO_COMPONENTS)
+    planner = CoveragePlanner(memory_budget=12 * 4 * DP_BYTES_PER_ENTRY)
+    assert planner.plan(reads, 4, trio_count=0).coverages == {10: 4, 70: 3}
+    assert planner.plan(reads, 4, trio_count=1).coverages == {10: 2, 70: 3}
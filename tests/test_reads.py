@@ -2,7 +2,9 @@
 Test Read and ReadSet classes
 """
 from pytest import raises
-from whatshap.core import Read, ReadSet, Variant
+from collections import namedtuple
+
+from whatshap.core import Genotype, Read, ReadSet, Variant, phased_blocks_as_reads
 
 
 def test_read():
@@ -139,3 +141,29 @@ def test_non_existing_read_name2():
 
 
 # TODO: Test subset method
+
+
+def test_phased_blocks_as_reads():
+    Phase = namedtuple("Phase", "block_id phase quality")
+    VcfVariant = namedtuple("VcfVariant", "position reference_allele alternative_allele")
+    variants = [VcfVariant(position, "A", "C") for position in [10, 30, 20, 40, 50, 60, 70]]
+    genotypes = [Genotype([0, 1])] * 5 + [Genotype([1, 1]), Genotype([0, 1, 1])]
+    phases = [
+        Phase(7, (1, 0), 15),
+        Phase(5, (0, 1), None),
+        Phase(7, (0, 1), None),
+        Phase(6, (1, 0), 30),
+        None,
+        Phase(5, (1, 1), 40),
+        Phase(5, (0, 1, 1), 40),
+    ]
+    input_variants = [v for v in variants if v.position != 30]
+    readset = phased_blocks_as_reads(
+        "s_block_", variants, genotypes, phases, input_variants, 3, 4, 99, 60
+    )
+    # Block 5 has no remaining variant and block 6 only a single one
+    assert len(readset) == 1
+    read = readset[0]
+    assert read.name == "s_block_7"
+    assert (read.mapqs, read.source_id, read.sample_id) == ((60,), 3, 4)
+    assert list(read) == [Variant(10, 1, 15), Variant(20, 0, 99)]
@@ -1,7 +1,21 @@
+import random
+from types import SimpleNamespace
+
 import pytest
 
-from whatshap.core import Read, Variant
-from whatshap.variants import merge_two_reads, merge_reads
+from whatshap.align import edit_distance_affine_gap
+from whatshap.bam import AlignmentWithSourceID
+from whatshap.core import NumericSampleIds, Read, Variant
+from whatshap.variants import (
+    CoveragePreselector,
+    ReadBatch,
+    ReadSetError,
+    ReadSetReader,
+    merge_two_reads,
+    merge_reads,
+    variant_windows,
+)
+from whatshap.vcf import VcfVariant
 
 
 @pytest.mark.parametrize("merge", [merge_two_reads, merge_reads])
@@ -90,3 +104,327 @@ def test_merge_many_reads():
     # TODO merging should not depend on the order of reads
     expected[1] = Variant(200, 0, 51)
     assert expected == list(merge_reads(*reads[::-1]))
+
+
+def test_read_batch():
+    rng = random.Random(1)
+    batch = ReadBatch()
+    expected = dict()
+    positions = list(range(10, 1000, 10))
+    for i in range(200):
+        name = "read{}".format(rng.randrange(130))
+        source_id = rng.randrange(2)
+        start = rng.randrange(len(positions))
+        detected = [
+            (j, rng.randrange(2), rng.randrange(5, 40))
+            for j in range(start, min(start + rng.randrange(4), len(positions)))
+        ]
+        key = (name, source_id)
+        if detected and key in expected and len(expected[key]) == 2:
+            continue
+        batch.add(name, 60 - i % 7, source_id, 3, 5 * start, "BX{}".format(i), positions, detected)
+        if not detected:
+            continue
+        read = Read(name, 60 - i % 7, source_id, 3, 5 * start, "BX{}".format(i))
+        for j, allele, quality in detected:
+            read.add_variant(positions[j], allele, quality)
+        expected.setdefault(key, []).append(read)
+
+    readset = batch.build()
+    assert len(readset) == len(expected)
+    for read, group in zip(readset, expected.values()):
+        merged = merge_reads(*group)
+        assert (read.name, read.source_id, read.sample_id) == (
+            merged.name,
+            merged.source_id,
+            merged.sample_id,
+        )
+        assert (read.mapqs, read.reference_start, read.BX_tag) == (
+            merged.mapqs,
+            merged.reference_start,
+            merged.BX_tag,
+        )
+        assert list(read) == list(merged)
+
+
+def test_read_batch_name_occurs_three_times():
+    batch = ReadBatch()
+    for _ in range(3):
+        batch.add("read", 60, 0, 0, 0, "", [100], [(0, 1, 30)])
+    with pytest.raises(ReadSetError):
+        batch.build()
+
+
+def test_variant_windows():
+    variants = [
+        VcfVariant(100000, "A", "C"),
+        VcfVariant(1000, "A", "AT"),
+        VcfVariant(1005, "ACGT", "A"),
+        VcfVariant(50000, "G", "T"),
+    ]
+    assert variant_windows(variants, max_gap=100) == [(999, 1009), (49999, 50001), (99999, 100001)]
+    # Dense variants: read everything
+    assert variant_windows(variants, max_gap=60000) is None
+    assert variant_windows([]) is None
+
+
+def alignment(name, start, end, mate_start=None, proper_pair=False):
+    return SimpleNamespace(
+        query_name=name,
+        reference_start=start,
+        reference_end=end,
+        is_paired=mate_start is not None,
+        is_proper_pair=proper_pair,
+        mate_is_unmapped=False,
+        reference_id=0,
+        next_reference_id=0,
+        next_reference_start=mate_start if mate_start is not None else -1,
+    )
+
+
+def test_coverage_preselector():
+    preselector = CoveragePreselector([100, 200, 300, 400], coverage=2)
+    alignments = [
+        # Covers only one variant, which is useless for phasing
+        alignment("a", 50, 150),
+        # Only two alignments are needed to connect the first two variants
+        alignment("b", 50, 250),
+        alignment("c", 60, 260),
+        alignment("d", 70, 270),
+        # A pair that connects the first and the last variant. It is kept because no other
+        # alignment connects the last two variants.
+        alignment("e", 90, 190, mate_start=380),
+        alignment("f", 150, 350),
+        alignment("g", 160, 360),
+        alignment("h", 310, 390),
+        alignment("e", 380, 480, mate_start=90),
+    ]
+    selected = [a.query_name for a in preselector.select(alignments, alignment=lambda a: a)]
+    assert selected == ["b", "c", "e", "f", "g", "e"]
+    assert preselector.kept[None] == 6
+    assert preselector.discarded[None] == 3
+
+
+def test_coverage_preselector_distant_mates():
+    preselector = CoveragePreselector([100, 200, 300, 400, 100000], coverage=1)
+    alignments = [
+        # The mates are too far apart for a pair that is not proper, so each of them
+        # is on its own and covers only one variant
+        alignment("a", 50, 150, mate_start=99950),
+        # These are needed since "a" does not connect the first four variants
+        alignment("b", 90, 210),
+        alignment("c", 190, 310),
+        # A proper pair. The mates connect the second and the last variant, but not the
+        # variants between them, so "e" is needed as well.
+        alignment("d", 190, 290, mate_start=99950, proper_pair=True),
+        alignment("e", 290, 410),
+        alignment("a", 99950, 100050, mate_start=50),
+        alignment("d", 99950, 100050, mate_start=190, proper_pair=True),
+    ]
+    selected = [a.query_name for a in preselector.select(alignments, alignment=lambda a: a)]
+    assert selected == ["b", "c", "d", "e", "d"]
+
+
+class FakeBamReader:
+    """
+    Stands in for a SampleBamReader of a file that contains the given
+    (sample, alignment) pairs, sorted by position. Counts the passes over the file.
+    """
+
+    def __init__(self, alignments, source_id=0):
+        self.source_id = source_id
+        self._alignments = alignments
+        self.fetches = 0
+
+    def has_sample(self, sample):
+        return any(s == sample for s, _ in self._alignments)
+
+    def has_reference(self, name):
+        return True
+
+    def _fetch(self, start, end):
+        self.fetches += 1
+        for sample, a in self._alignments:
+            if a.reference_end > start and (end is None or a.reference_start < end):
+                yield sample, AlignmentWithSourceID(self.source_id, a)
+
+    def fetch(self, reference, sample=None, start=0, end=None):
+        for s, alignment in self._fetch(start, end):
+            if sample is None or s == sample:
+                yield alignment
+
+    def fetch_samples(self, reference, samples, start=0, end=None):
+        for s, alignment in self._fetch(start, end):
+            if s in samples:
+                yield s, alignment
+
+
+def fake_readset_reader(monkeypatch, files):
+    """Return a ReadSetReader for FakeBamReaders with the given contents"""
+    readers = {}
+
+    def open_fake(path, *, source_id=0, reference=None):
+        readers[path] = FakeBamReader(files[path], source_id)
+        return readers[path]
+
+    monkeypatch.setattr("whatshap.bam.SampleBamReader", open_fake)
+    monkeypatch.setattr("whatshap.variants.SampleBamReader", open_fake)
+    return ReadSetReader(list(files), None, NumericSampleIds()), readers
+
+
+def fake_alignment(name, start, sequence):
+    return SimpleNamespace(
+        qname=name,
+        query_name=name,
+        mapq=60,
+        mapping_quality=60,
+        flag=0,
+        is_secondary=False,
+        is_unmapped=False,
+        is_duplicate=False,
+        reference_start=start,
+        reference_end=start + len(sequence),
+        query_sequence=sequence,
+        query_qualities=None,
+        cigartuples=[(0, len(sequence))],
+        has_tag=lambda tag: False,
+    )
+
+
+@pytest.mark.parametrize("n_files", [1, 2])
+def test_read_samples(monkeypatch, n_files):
+    rng = random.Random(n_files)
+    reference = "".join(rng.choice("ACGT") for _ in range(1000))
+    snvs = [
+        VcfVariant(position, reference[position], "T" if reference[position] != "T" else "G")
+        for position in sorted(rng.sample(range(1000), 40))
+    ]
+    alt = {variant.position: variant.alternative_allele for variant in snvs}
+    files = {"file{}.bam".format(i): [] for i in range(n_files)}
+    for i, start in enumerate(sorted(rng.randrange(950) for _ in range(60))):
+        sequence = [
+            alt[position] if position in alt and rng.random() < 0.5 else reference[position]
+            for position in range(start, start + 50)
+        ]
+        sample = rng.choice(["mother", "father", "child"])
+        alignment = fake_alignment("read{}".format(i), start, "".join(sequence))
+        files[rng.choice(list(files))].append((sample, alignment))
+
+    readset_reader, readers = fake_readset_reader(monkeypatch, files)
+    samples = ["mother", "father", "child", "missing"]
+    readsets = readset_reader.read_samples("chr1", snvs, samples, None, [(0, None)])
+    # Each file is read once for all samples
+    assert [reader.fetches for reader in readers.values()] == [1] * n_files
+    assert sorted(readsets) == ["child", "father", "mother"]
+    for sample, readset in readsets.items():
+        expected = readset_reader.read("chr1", snvs, sample, None, [(0, None)])
+        assert len(readset) == len(expected) > 0
+        for read, expected_read in zip(readset, expected):
+            assert (read.name, read.source_id, read.sample_id) == (
+                expected_read.name,
+                expected_read.source_id,
+                expected_read.sample_id,
+            )
+            assert list(read) == list(expected_read)
+
+
+def test_multi_bam_reader_fetch_samples(monkeypatch):
+    files = {
+        "a.bam": [
+            ("mother", fake_alignment("a1", 10, "A" * 20)),
+            ("child", fake_alignment("a2", 30, "A" * 20)),
+            ("child", fake_alignment("a3", 30, "A" * 20)),
+        ],
+        "b.bam": [
+            ("father", fake_alignment("b1", 5, "A" * 20)),
+            ("child", fake_alignment("b2", 30, "A" * 20)),
+            ("mother", fake_alignment("b3", 40, "A" * 20)),
+        ],
+        "c.bam": [("other", fake_alignment("c1", 20, "A" * 20))],
+    }
+    readset_reader, readers = fake_readset_reader(monkeypatch, files)
+    fetched = [
+        (sample, a.source_id, a.bam_alignment.query_name)
+        for sample, a in readset_reader._reader.fetch_samples("chr1", ["mother", "child"])
+    ]
+    # Sorted by position, ties broken by file, file order kept; other samples skipped
+    assert fetched == [
+        ("mother", 0, "a1"),
+        ("child", 0, "a2"),
+        ("child", 0, "a3"),
+        ("child", 1, "b2"),
+        ("mother", 1, "b3"),
+    ]
+    # The file without any of the samples is not read
+    assert [reader.fetches for reader in readers.values()] == [1, 1, 0]
+
+
+def test_fetch_variant_windows(monkeypatch):
+    snvs = [VcfVariant(1000, "A", "C"), VcfVariant(30000, "A", "C"), VcfVariant(60000, "A", "C")]
+    spans = [
+        ("a", 900, 1100),
+        # spans the windows around the first two variants
+        ("long", 950, 30050),
+        ("b", 9000, 9100),
+        ("c", 29990, 30040),
+        ("d", 29995, 30095),
+        ("e", 59000, 61000),
+        ("f", 59950, 60050),
+    ]
+    files = {
+        "file.bam": [
+            (sample, fake_alignment(name, start, "C" * (end - start)))
+            for name, start, end in spans
+            for sample in ["mother", "child"]
+        ]
+    }
+    readset_reader, readers = fake_readset_reader(monkeypatch, files)
+    fetches = readset_reader._plan_fetches(None, snvs)
+    assert len(fetches) == 3
+    expected = ["a", "long", "c", "d", "e", "f"]
+
+    alignments = list(readset_reader._usable_alignments("chr1", "child", fetches))
+    assert [a.bam_alignment.query_name for a in alignments] == expected
+    starts = [a.bam_alignment.reference_start for a in alignments]
+    assert starts == sorted(starts)
+    readset = readset_reader.read("chr1", snvs, "child", None)
+    assert [read.name for read in readset] == expected
+
+    pairs = list(readset_reader._usable_sample_alignments("chr1", ["mother", "child"], fetches))
+    assert [(sample, a.bam_alignment.query_name) for sample, a in pairs] == [
+        (sample, name) for name in expected for sample in ["mother", "child"]
+    ]
+    readsets = readset_reader.read_samples("chr1", snvs, ["mother", "child"], None)
+    assert [read.name for read in readsets["mother"]] == expected
+
+
+@pytest.mark.parametrize("use_affine", [False, True])
+def test_detect_alleles_exact_match(use_affine):
+    reference = "GATTACAGATTACAGATTACA" * 2
+    variants = [VcfVariant(20, "A", "AGG")]
+    ref_read = SimpleNamespace(reference_start=0, query_sequence=reference, cigartuples=[(0, 42)])
+    alt_read = SimpleNamespace(
+        reference_start=0,
+        query_sequence=reference[:21] + "GG" + reference[21:],
+        cigartuples=[(0, 21), (1, 2), (0, 21)],
+    )
+    # Same as alt_read, but with a mismatch next to the insertion, so it is realigned
+    mismatch_read = SimpleNamespace(
+        reference_start=0,
+        query_sequence=reference[:19] + "T" + reference[20:21] + "GG" + reference[21:],
+        cigartuples=[(0, 21), (1, 2), (0, 21)],
+    )
+    parameters = (reference, 10, use_affine, 10, 7, 15)
+    detected = []
+    for read in (ref_read, alt_read, mismatch_read):
+        detected.extend(ReadSetReader.detect_alleles_by_alignment(variants, 0, read, *parameters))
+    alleles = [d[1] for d in detected]
+    qualities = [d[2] for d in detected]
+    assert alleles == [0, 1, 1]
+    if use_affine:
+        ref_window = reference[10:31]
+        alt_window = reference[10:21] + "GG" + reference[21:31]
+        assert qualities[0] == edit_distance_affine_gap(ref_window, alt_window, [15] * 21, 10, 7)
+        assert qualities[1] == edit_distance_affine_gap(alt_window, ref_window, [15] * 23, 10, 7)
+    else:
+        assert qualities == [30, 30, 30]
@@ -1,13 +1,17 @@
+import pytest
+
 from whatshap.cli.find_snv_candidates import run_find_snv_candidates
 
 
-def test_call(tmpdir):
+@pytest.mark.parametrize("threads", [1, 2])
+def test_call(tmpdir, threads):
     output = str(tmpdir.join("output.vcf"))
     run_find_snv_candidates(
         "tests/data/pacbio/reference.fasta",
         "tests/data/pacbio/pacbio.bam",
         datatype="pacbio",
         output=output,
+        threads=threads,
     )
     computed_lines = []
     expected_lines = []
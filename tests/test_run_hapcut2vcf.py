@@ -6,3 +6,20 @@ def test_hapcut2vcf(tmp_path):
     run_hapcut2vcf(
         hapcut="tests/data/pacbio/hapcut.txt", vcf="tests/data/pacbio/variants.vcf", output=out
     )
+
+
+def test_hapcut2vcf_threads(tmp_path):
+    outputs = []
+    for threads in (1, 2):
+        out = tmp_path / "hapcut{}.vcf".format(threads)
+        run_hapcut2vcf(
+            hapcut="tests/data/pacbio/hapcut.txt",
+            vcf="tests/data/pacbio/variants.vcf",
+            output=out,
+            threads=threads,
+        )
+        outputs.append(
+            [line for line in out.read_text().splitlines() if not line.startswith("##commandline")]
+        )
+    assert outputs[0] == outputs[1]
+    assert any("|" in line for line in outputs[0] if not line.startswith("#"))
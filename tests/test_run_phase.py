@@ -1,6 +1,7 @@
 """
 Integration tests that use the command-line entry points run_whatshap, run_haplotag etc.
 """
+import json
 import os
 from collections import namedtuple
 
@@ -371,6 +372,132 @@ def test_phase_trio(tmpdir):
     assert_phasing(table.phases_of("HG002"), [None, phase0, None, None, None])
 
 
+def test_phase_trio_dp_budget(tmpdir):
+    outvcf = str(tmpdir.join("output.vcf"))
+    run_whatshap(
+        phase_input_files=[trio_bamfile],
+        variant_file="tests/data/trio.vcf",
+        output=outvcf,
+        ped="tests/data/trio.ped",
+        genmap="tests/data/trio.map",
+        dp_memory_budget=2 ** 20,
+        dp_time_budget=1.0,
+    )
+    tables = list(VcfReader(outvcf, phases=True))
+    assert len(tables) == 1
+    table = tables[0]
+    assert len(table.variants) == 5
+
+    phase0 = VariantCallPhase(60906167, (0, 1), None)
+    assert_phasing(table.phases_of("HG004"), [phase0, phase0, phase0, phase0, phase0])
+    assert_phasing(table.phases_of("HG003"), [phase0, None, phase0, phase0, phase0])
+    assert_phasing(table.phases_of("HG002"), [None, phase0, None, None, None])
+
+
+def test_phase_trio_result_cache(tmp_path):
+    outvcfs = [tmp_path / "output1.vcf", tmp_path / "output2.vcf"]
+    for outvcf in outvcfs:
+        run_whatshap(
+            phase_input_files=[trio_bamfile],
+            variant_file="tests/data/trio.vcf",
+            output=str(outvcf),
+            ped="tests/data/trio.ped",
+            genmap="tests/data/trio.map",
+            cache_dir=str(tmp_path / "cache"),
+        )
+    # one entry for the single chromosome and family
+    assert len(list((tmp_path / "cache").glob("*/*.pickle"))) == 1
+    lines1 = [line for line in open(outvcfs[0]) if not line.startswith("#")]
+    lines2 = [line for line in open(outvcfs[1]) if not line.startswith("#")]
+    assert lines1 == lines2
+
+
+def test_phase_result_cache_per_segment(tmp_path):
+    outvcfs = [tmp_path / "uncached.vcf", tmp_path / "cached1.vcf", tmp_path / "cached2.vcf"]
+    for outvcf, cache_dir in zip(outvcfs, [None, tmp_path / "cache", tmp_path / "cache"]):
+        run_whatshap(
+            phase_input_files=[trio_bamfile],
+            variant_file="tests/data/trio.vcf",
+            output=str(outvcf),
+            samples=["HG004"],
+            cache_dir=None if cache_dir is None else str(cache_dir),
+        )
+    # a single sample is cached per segment of read-connected variants
+    assert len(list((tmp_path / "cache").glob("*/*.pickle"))) >= 1
+    lines = [
+        [line for line in open(outvcf) if not line.startswith("#")] for outvcf in outvcfs
+    ]
+    assert lines[0] == lines[1] == lines[2]
+
+
+def test_phase_two_chromosomes_work_dir(tmp_path):
+    work_dir = tmp_path / "work"
+    outvcfs = [tmp_path / "direct.vcf", tmp_path / "resumable.vcf", tmp_path / "resumed.vcf"]
+    for outvcf, work in zip(outvcfs, [None, work_dir, work_dir]):
+        run_whatshap(
+            phase_input_files=[trio_bamfile],
+            variant_file="tests/data/trio-two-chromosomes.vcf",
+            output=str(outvcf),
+            ped="tests/data/trio.ped",
+            genmap="tests/data/trio.map",
+            chromosomes=["1"],
+            work_dir=None if work is None else str(work),
+        )
+        if work is not None:
+            # Pretend that the run was interrupted while working on chromosome 2
+            manifest_path = work_dir / "manifest.json"
+            manifest = json.loads(manifest_path.read_text())
+            assert [entry["chromosome"] for entry in manifest["chromosomes"]] == ["1", "2"]
+            assert manifest["chromosomes"][0]["statistics"]["phased_reads"] > 0
+            manifest["chromosomes"].pop()
+            manifest_path.write_text(json.dumps(manifest))
+
+    lines = [[line for line in open(path) if not line.startswith("#")] for path in outvcfs]
+    assert len(lines[0]) == 10
+    assert lines[0] == lines[1] == lines[2]
+
+
+def test_phase_work_dir_with_other_parameters(tmp_path):
+    work_dir = str(tmp_path / "work")
+    for max_coverage in (15, 10):
+        kwargs = dict(
+            phase_input_files=[trio_bamfile],
+            variant_file="tests/data/trio.vcf",
+            output=str(tmp_path / "output.vcf"),
+            ped="tests/data/trio.ped",
+            genmap="tests/data/trio.map",
+            max_coverage=max_coverage,
+            work_dir=work_dir,
+        )
+        if max_coverage == 15:
+            run_whatshap(**kwargs)
+        else:
+            with raises(CommandLineError) as e:
+                run_whatshap(**kwargs)
+            assert "different input files or parameters" in e.value.args[0]
+
+
+def test_phase_work_dir_with_changed_pedigree(tmp_path):
+    work_dir = str(tmp_path / "work")
+    ped = tmp_path / "trio.ped"
+    ped.write_text(open("tests/data/trio.ped").read())
+    kwargs = dict(
+        phase_input_files=[trio_bamfile],
+        variant_file="tests/data/trio.vcf",
+        output=str(tmp_path / "output.vcf"),
+        ped=str(ped),
+        genmap="tests/data/trio.map",
+        work_dir=work_dir,
+    )
+    run_whatshap(**kwargs)
+    # The number of threads does not change the result
+    run_whatshap(read_merging_threads=2, **kwargs)
+    ped.write_text(open("tests/data/trio.ped").read() + "# edited\n")
+    with raises(CommandLineError) as e:
+        run_whatshap(**kwargs)
+    assert "different input files or parameters" in e.value.args[0]
+
+
 def test_phase_trio_hapchat():
     with raises(CommandLineError) as e:
         run_whatshap(
@@ -942,13 +1069,15 @@ def test_indel_phasing(algorithm, tmp_path):
     assert_phasing(table.phases_of("sample1"), [phase0, phase1, phase0, phase1])
 
 
-def test_with_read_merging(algorithm):
+@mark.parametrize("threads", [1, 3])
+def test_with_read_merging(algorithm, threads):
     run_whatshap(
         phase_input_files=["tests/data/pacbio/pacbio.bam"],
         variant_file="tests/data/pacbio/variants.vcf",
         reference="tests/data/pacbio/reference.fasta",
         output="/dev/null",
         read_merging=True,
+        read_merging_threads=threads,
         algorithm=algorithm,
     )
 
@@ -85,3 +85,18 @@ def test_stats2(tmp_path):
     assert entry_all.variant_per_block_sum == "8"
     assert entry_all.bp_per_block_sum == "750"
     assert entry_all.block_n50[:-1] == "350"
+
+
+def test_stats_threads(tmp_path):
+    outputs = []
+    for threads in (1, 2):
+        outtsv = tmp_path / "output{}.tsv".format(threads)
+        outblocks = tmp_path / "blocks{}.tsv".format(threads)
+        run_stats(
+            vcf="tests/data/haplotag_2.vcf.gz",
+            tsv=outtsv,
+            block_list=outblocks,
+            threads=threads,
+        )
+        outputs.append((outtsv.read_text(), outblocks.read_text()))
+    assert outputs[0] == outputs[1]
@@ -1,3 +1,5 @@
+import gzip
+
 from whatshap.cli.unphase import run_unphase
 
 
@@ -9,6 +11,15 @@ def test_unphase(tmpdir):
     assert expected == out.read_text(encoding="ascii")
 
 
+def test_unphase_compressed_threads(tmp_path):
+    out = tmp_path / "out.vcf.gz"
+    run_unphase("tests/data/phased-via-mixed-HP-PS.vcf", str(out), threads=2)
+    with open("tests/data/unphased.vcf") as f:
+        expected = f.read()
+    with gzip.open(out, "rt") as f:
+        assert expected == f.read()
+
+
 def test_unphase_string_typed_ps(tmpdir):
     # Ensure a VCF with PS tags of type String (although against VCF spec) can be read
     run_unphase("tests/data/string_typed_ps_tag.vcf", str(tmpdir.join("out.vcf")))
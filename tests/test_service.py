@@ -0,0 +1,81 @@
+import io
+import multiprocessing
+import os
+import sys
+import time
+
+from pytest import fixture, raises
+
+from whatshap import service
+from whatshap.service import serve, submit, ServiceError
+
+
+def dummy_job(argv):
+    if argv[0] == "fail":
+        raise RuntimeError("job failed")
+    if argv[0] == "exit":
+        sys.exit(int(argv[1]))
+    print("cwd", os.getcwd())
+    print(" ".join(argv))
+    print("to stderr", file=sys.stderr)
+    sys.stdout.flush()
+    # output of subprocesses and C code goes to the same file descriptors
+    os.write(1, b"raw output\n")
+    return 0
+
+
+@fixture
+def server(tmp_path):
+    socket_path = str(tmp_path / "whatshap.sock")
+    process = multiprocessing.get_context("fork").Process(
+        target=serve, args=(socket_path, 2, dummy_job)
+    )
+    process.start()
+    for _ in range(100):
+        if os.path.exists(socket_path):
+            break
+        time.sleep(0.05)
+    yield socket_path
+    process.terminate()
+    process.join()
+    assert not os.path.exists(socket_path)
+
+
+def run(socket_path, argv):
+    stdout = io.BytesIO()
+    stderr = io.BytesIO()
+    status = submit(socket_path, argv, stdout, stderr)
+    return status, stdout.getvalue().decode(), stderr.getvalue().decode()
+
+
+def test_submit(server):
+    status, stdout, stderr = run(server, ["phase", "--debug", "x.vcf"])
+    assert status == 0
+    assert stdout == "cwd {}\nphase --debug x.vcf\nraw output\n".format(os.getcwd())
+    assert stderr == "to stderr\n"
+
+
+def test_exit_status(server):
+    assert run(server, ["exit", "3"])[0] == 3
+    status, stdout, stderr = run(server, ["fail"])
+    assert status == 1
+    assert "RuntimeError: job failed" in stderr
+    # The worker survives failing jobs
+    assert run(server, ["phase"])[0] == 0
+
+
+def test_socket_permissions(server):
+    # Nobody but the owner may connect
+    assert os.stat(server).st_mode & 0o077 == 0
+
+
+def failing_initialize():
+    raise RuntimeError("cannot initialize")
+
+
+def test_initialize_fails(tmp_path, monkeypatch):
+    monkeypatch.setattr(service, "INITIALIZE_RETRY_DELAY", 0.01)
+    socket_path = str(tmp_path / "whatshap.sock")
+    with raises(ServiceError):
+        serve(socket_path, 2, dummy_job, initialize=failing_initialize)
+    assert not os.path.exists(socket_path)
@@ -11,6 +11,7 @@ from whatshap.vcf import (
     VcfVariant,
     GenotypeLikelihoods,
     VcfIndexMissing,
+    VariantTable,
 )
 from whatshap.testhelpers import (
     canonic_index_to_biallelic_gt,
@@ -148,10 +149,8 @@ def test_phasing_to_reads():
         tables = list(VcfReader(filename, phases=True))
         assert len(tables) == 2
         table_a, table_b = tables
-        phase_reads_sample1 = list(
-            table_a.phased_blocks_as_reads(
-                "sample1", table_a.variants, 17, 18, default_quality=90, mapq=101
-            )
+        phase_reads_sample1 = table_a.phased_blocks_as_reads(
+            "sample1", table_a.variants, 17, 18, default_quality=90, mapq=101
         )
         print(phase_reads_sample1)
         assert len(phase_reads_sample1) == 1
@@ -167,10 +166,8 @@ def test_phasing_to_reads():
         assert read[1].allele == 0
         assert read[1].quality == 42
 
-        phase_reads_sample2 = list(
-            table_a.phased_blocks_as_reads(
-                "sample2", table_a.variants, 11, 12, default_quality=91, mapq=102
-            )
+        phase_reads_sample2 = table_a.phased_blocks_as_reads(
+            "sample2", table_a.variants, 11, 12, default_quality=91, mapq=102
         )
         print(phase_reads_sample2)
         assert len(phase_reads_sample2) == 2
@@ -203,10 +200,8 @@ def test_phasing_to_reads():
             VcfVariant(17, "A", "TTC"),
             VcfVariant(1000, "C", "G"),
         ]
-        phase_reads_sample2 = list(
-            table_a.phased_blocks_as_reads(
-                "sample2", variants, 11, 12, default_quality=91, mapq=102
-            )
+        phase_reads_sample2 = table_a.phased_blocks_as_reads(
+            "sample2", variants, 11, 12, default_quality=91, mapq=102
         )
         print(phase_reads_sample2)
         assert len(phase_reads_sample2) == 1
@@ -330,6 +325,22 @@ def test_genotype_likelihoods():
     assert list(gl.as_phred(regularizer=0.01)) == [20, 0, 19]
 
 
+def test_variant_table_copy_and_remove_rows():
+    table = VariantTable("chr1", ["A", "B"])
+    for i in range(5):
+        gts = canonic_index_list_to_biallelic_gt_list([i % 3, (i + 1) % 3])
+        table.add_variant(VcfVariant(100 + i, "A", "C"), gts, [None, None], [None, None])
+    copy = table.copy()
+    genotypes_a = copy.genotypes_of("A")
+    copy.remove_rows_by_index([3, 0, 3])
+    assert [v.position for v in copy.variants] == [101, 102, 104]
+    assert genotypes_a == canonic_index_list_to_biallelic_gt_list([1, 2, 1])
+    assert len(copy.genotypes_of("B")) == len(copy.phases_of("B")) == 3
+    assert len(table) == 5
+    copy.subset_rows_by_position([102])
+    assert [v.position for v in copy.variants] == [102]
+
+
 def test_read_region():
     vcf_reader = VcfReader("tests/data/haplotag_1.vcf.gz")
     tableA = vcf_reader.fetch("chr1")
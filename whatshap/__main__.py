@@ -45,8 +45,7 @@ def ensure_pysam_version():
         sys.exit("WhatsHap requires pysam >= 0.8.1")
 
 
-def main(argv=sys.argv[1:]):
-    ensure_pysam_version()
+def get_argument_parser():
     parser = HelpfulArgumentParser(description=__doc__, prog="whatshap")
     parser.add_argument("--version", action="version", version="%(prog)s " + __version__)
     parser.add_argument("--debug", action="store_true", default=False, help="Print debug messages")
@@ -65,26 +64,36 @@ def main(argv=sys.argv[1:]):
         )
         subparser.set_defaults(module=module, subparser=subparser)
         module.add_arguments(subparser)
+    return parser
+
+
+def run_subcommand(args):
+    """Run the subcommand selected by the parsed command-line arguments"""
+    module = args.module
+    if hasattr(args.module, "validate"):
+        subparser = args.subparser
+        args.module.validate(args, subparser)
+    del args.subparser
+    del args.module
+    del args.debug
+    try:
+        module.main(args)
+    except CommandLineError as e:
+        logger.error("whatshap error: %s", str(e))
+        logger.debug("Command line error. Traceback:", exc_info=True)
+        sys.exit(1)
+
 
+def main(argv=sys.argv[1:]):
+    ensure_pysam_version()
+    parser = get_argument_parser()
     args = parser.parse_args(argv)
     setup_logging(args.debug)
 
     if not hasattr(args, "module"):
         parser.error("Please provide the name of a subcommand to run")
     else:
-        module = args.module
-        if hasattr(args.module, "validate"):
-            subparser = args.subparser
-            args.module.validate(args, subparser)
-        del args.subparser
-        del args.module
-        del args.debug
-        try:
-            module.main(args)
-        except CommandLineError as e:
-            logger.error("whatshap error: %s", str(e))
-            logger.debug("Command line error. Traceback:", exc_info=True)
-            sys.exit(1)
+        run_subcommand(args)
 
 
 if __name__ == "__main__":
@@ -0,0 +1,17 @@
+from typing import Iterable, List, Optional, Tuple
+
+class PileupCounts:
+    start: int
+    end: int
+    def __init__(self, start: int, end: int, min_base_quality: int = ...) -> None: ...
+    def add(
+        self,
+        reference_start: int,
+        cigartuples: Iterable[Tuple[int, int]],
+        sequence: bytes,
+        qualities: Optional[bytes] = ...,
+        skip_until: int = ...,
+    ) -> None: ...
+    def candidates(
+        self, reference: bytes, minabs: int, minrel: float
+    ) -> List[Tuple[int, str, List[Tuple[int, str]]]]: ...
@@ -0,0 +1,130 @@
+# cython: language_level=3
+
+"""
+Dense per-position base counting for SNV candidate discovery.
+"""
+from libcpp.vector cimport vector
+from libc.stdint cimport uint32_t
+
+# Index of each base in a count row; any other character maps to -1
+cdef int BASE_INDEX[256]
+for _i in range(256):
+	BASE_INDEX[_i] = -1
+for _i, _c in enumerate("ACGTN"):
+	BASE_INDEX[ord(_c)] = _i
+	BASE_INDEX[ord(_c.lower())] = _i
+
+BASES = "ACGTN"
+
+
+cdef class PileupCounts:
+	"""
+	Count the bases aligned to each position of the reference region [start, end).
+
+	Counts are kept in a dense array with one row of five entries (A, C, G, T, N) per
+	position, so that walking an alignment is a single pass over its CIGAR.
+	"""
+	cdef:
+		readonly int start
+		readonly int end
+		int min_base_quality
+		vector[uint32_t] counts
+
+	def __cinit__(self, int start, int end, int min_base_quality=0):
+		assert start <= end
+		self.start = start
+		self.end = end
+		self.min_base_quality = min_base_quality
+		self.counts.resize(5 * (end - start), 0)
+
+	def add(self, int reference_start, cigartuples, bytes sequence, qualities=None, int skip_until=-1):
+		"""
+		Add the aligned bases of one alignment.
+
+		reference_start -- start of the alignment on the reference
+		cigartuples -- CIGAR as list of (operation, length) tuples
+		sequence -- query sequence
+		qualities -- base qualities (any buffer of bytes) or None if not available
+		skip_until -- do not count bases aligned to reference positions before this one
+			(used to count bases in the overlap of two mates only once)
+		"""
+		cdef:
+			int ref_pos = reference_start
+			int query_pos = 0
+			int cigar_op
+			int length
+			int k
+			int pos
+			int lo
+			int hi
+			int base
+			const unsigned char* seq = sequence
+			const unsigned char[:] quals
+			bint has_qualities = qualities is not None
+			int min_base_quality = self.min_base_quality
+			uint32_t* counts = self.counts.data()
+
+		if has_qualities:
+			quals = qualities
+		if skip_until < self.start:
+			skip_until = self.start
+		for cigar_op, length in cigartuples:
+			# The mapping of CIGAR operators to numbers is:
+			# MIDNSHPX= => 012345678
+			if cigar_op == 0 or cigar_op == 7 or cigar_op == 8:
+				lo = max(ref_pos, skip_until)
+				hi = min(ref_pos + length, self.end)
+				for pos in range(lo, hi):
+					k = query_pos + pos - ref_pos
+					if has_qualities and quals[k] < min_base_quality:
+						continue
+					base = BASE_INDEX[seq[k]]
+					if base >= 0:
+						counts[5 * (pos - self.start) + base] += 1
+				query_pos += length
+				ref_pos += length
+			elif cigar_op == 1 or cigar_op == 4:  # I, S
+				query_pos += length
+			elif cigar_op == 2 or cigar_op == 3:  # D, N
+				ref_pos += length
+			if ref_pos >= self.end:
+				break
+
+	def candidates(self, bytes reference, int minabs, double minrel):
+		"""
+		Return a list of (position, reference base, alts) tuples for all positions at which
+		at least one non-reference base has an absolute count of at least minabs and a count
+		relative to itself plus the reference base of at least minrel. alts is a list of
+		(count, base) tuples, sorted in descending order.
+
+		reference -- upper-case reference sequence of the region [start, end)
+		"""
+		cdef:
+			int i
+			int b
+			int ref_base
+			uint32_t ref_count
+			uint32_t count
+			const unsigned char* ref = reference
+			int n = min(len(reference), self.end - self.start)
+			uint32_t* counts = self.counts.data()
+
+		result = []
+		for i in range(n):
+			if ref[i] == c'N':
+				continue
+			ref_base = BASE_INDEX[ref[i]]
+			ref_count = counts[5 * i + ref_base] if ref_base >= 0 else 0
+			alts = None
+			for b in range(5):
+				count = counts[5 * i + b]
+				if b == ref_base or count == 0:
+					continue
+				if <long>count >= minabs and <double>count / (count + ref_count) >= minrel:
+					if alts is None:
+						alts = []
+					alts.append((count, BASES[b]))
+			if alts is not None:
+				alts.sort(reverse=True)
+				result.append((self.start + i, chr(ref[i]), alts))
+		return result
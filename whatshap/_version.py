@@ -0,0 +1 @@
+version = "1.1.dev0"
@@ -1,7 +1,7 @@
 import os
 from abc import ABC
 from urllib.parse import urlparse
-from typing import Optional, Iterable
+from typing import Optional, Iterable, Iterator, Tuple
 
 import pysam
 import logging
@@ -130,26 +130,69 @@ class SampleBamReader(BamReader):
                 if bam_read.opt("RG") in read_groups:
                     yield AlignmentWithSourceID(self.source_id, bam_read)
 
+    def fetch_samples(
+        self, reference: str, samples: Iterable[str], start: int = 0, end: Optional[int] = None
+    ) -> Iterator[Tuple[str, AlignmentWithSourceID]]:
+        """
+        Yield pairs (sample, alignment) for the alignments of all given samples, reading
+        the region only once. Samples without reads in this file are ignored.
+        Raise ReferenceNotFoundError when reference is not in the BAM.
+        """
+        if reference not in self._references:
+            raise ReferenceNotFoundError(reference)
+        group_to_sample = {
+            group_id: sample
+            for sample in samples
+            for group_id in self._sample_to_group_ids.get(sample, ())
+        }
+        if not group_to_sample:
+            return
+        for bam_read in self._samfile.fetch(
+            reference, multiple_iterators=True, start=start, stop=end
+        ):
+            sample = group_to_sample.get(bam_read.opt("RG"))
+            if sample is not None:
+                yield sample, AlignmentWithSourceID(self.source_id, bam_read)
+
     def close(self) -> None:
         self._samfile.close()
 
 
-class ComparableAlignedSegment:
-    """
-    Heapsort wants to be able to use the less than operator. Native
-    AlignedSegment instances do not support this.
+def merge_by_position(iterators, alignment=lambda item: item):
     """
+    Merge iterators over position-sorted items of different CRAM/BAM files.
 
-    def __init__(self, aligned_segment: pysam.AlignedSegment, source_id: int):
-        self.segment: pysam.AlignedSegment = aligned_segment
-        self.source_id: int = source_id
+    iterators -- list of (source_id, iterator) pairs with distinct source ids
+    alignment -- function that returns the AlignmentWithSourceID of an item
 
-    def __lt__(self, other) -> bool:
-        self_pos = self.segment.reference_start
-        other_pos = other.segment.reference_start
-        return (self_pos < other_pos) or (
-            self_pos == other_pos and self.source_id < other.source_id
-        )
+    Items are yielded sorted by reference start position. Ties between files are
+    broken by source id, and the order within each file is kept.
+
+    The heap holds plain tuples whose first two entries are the sort key, so that
+    comparisons are done natively instead of by a Python __lt__ method.
+    """
+    heap = []
+    for source_id, it in iterators:
+        it = iter(it)
+        for item in it:
+            heap.append((alignment(item).bam_alignment.reference_start, source_id, item, it))
+            break
+    heapq.heapify(heap)
+    while len(heap) > 1:
+        _, source_id, item, it = heap[0]
+        yield item
+        item = next(it, None)
+        if item is None:
+            heapq.heappop(heap)
+        else:
+            heapq.heapreplace(
+                heap, (alignment(item).bam_alignment.reference_start, source_id, item, it)
+            )
+    if heap:
+        # Only one file is left, which needs no merging
+        _, _, item, it = heap[0]
+        yield item
+        yield from it
 
 
 class MultiBamReader(BamReader):
@@ -185,18 +228,37 @@ class MultiBamReader(BamReader):
         """
         assert reference is not None
 
-        def make_comparable(reader):
-            for alignment in reader.fetch(reference, sample, start, end):
-                yield ComparableAlignedSegment(alignment.bam_alignment, alignment.source_id)
-
         iterators = []
         for reader in self._readers:
             if sample is None or reader.has_sample(sample):
-                iterators.append(make_comparable(reader))
+                iterators.append((reader.source_id, reader.fetch(reference, sample, start, end)))
         if not iterators:
             raise SampleNotFoundError("Sample not found in any input CRAM/BAM file")
-        for it in heapq.merge(*iterators):
-            yield AlignmentWithSourceID(it.source_id, it.segment)
+        yield from merge_by_position(iterators)
+
+    def fetch_samples(
+        self,
+        reference: str,
+        samples: Iterable[str],
+        start: int = 0,
+        end: Optional[int] = None,
+    ) -> Iterator[Tuple[str, AlignmentWithSourceID]]:
+        """
+        Yield pairs (sample, alignment) for the alignments of all given samples in all
+        the opened CRAM/BAM files, merging them on the fly. Each file is read only once.
+        Samples without reads in any file are ignored.
+        """
+        samples = list(samples)
+        iterators = [
+            (reader.source_id, reader.fetch_samples(reference, samples, start, end))
+            for reader in self._readers
+            if any(reader.has_sample(sample) for sample in samples)
+        ]
+        yield from merge_by_position(iterators, alignment=lambda item: item[1])
+
+    def has_sample(self, sample: str) -> bool:
+        """Return whether any of the files contains reads for the given sample"""
+        return any(reader.has_sample(sample) for reader in self._readers)
 
     def has_reference(self, name: str) -> bool:
         return all(reader.has_reference(name) for reader in self._readers)
@@ -0,0 +1,203 @@
+"""
+On-disk cache of phasing results
+
+Each phasing problem (the reads of one family on one chromosome together with the
+genotypes and all parameters of the DP) is identified by a hash of its content. The
+cache stores the super reads, the optimal partitioning of the reads and the cost
+under that hash, so that re-running on unchanged input skips the DP.
+
+For a single sample, the problem falls apart into independent segments between
+variants that no read spans. Each segment is then cached on its own, so that a
+change in one region does not invalidate the results of the rest of the chromosome.
+With a pedigree, transmission vectors connect the segments, and the problem is
+cached as a whole.
+"""
+import hashlib
+import logging
+import os
+import pickle
+import tempfile
+from typing import List, Optional, Sequence, Tuple
+
+from whatshap import __version__
+from whatshap.core import Read, ReadSet
+from whatshap.planner import shared_read_counts
+
+logger = logging.getLogger(__name__)
+
+# Increase when the stored data or the key computation changes
+CACHE_FORMAT_VERSION = 2
+
+
+class CachedResult:
+    """
+    Result of a phasing DP as read from the cache. Offers the same methods as
+    PedigreeDPTable and HapChatCore for accessing the result.
+    """
+
+    def __init__(self, superreads, transmission_vector, cost, partitioning):
+        self._superreads = superreads
+        self._transmission_vector = transmission_vector
+        self._cost = cost
+        self._partitioning = partitioning
+
+    @classmethod
+    def from_dp_table(cls, dp_table) -> "CachedResult":
+        superreads_list, transmission_vector = dp_table.get_super_reads()
+        superreads = [[_read_to_tuple(read) for read in readset] for readset in superreads_list]
+        return cls(
+            superreads,
+            list(transmission_vector),
+            dp_table.get_optimal_cost(),
+            list(dp_table.get_optimal_partitioning()),
+        )
+
+    @classmethod
+    def concatenate(
+        cls, results: Sequence["CachedResult"], read_indices: Sequence[List[int]], read_count: int
+    ) -> "CachedResult":
+        """
+        Combine the results of independent segments (in the order of their positions)
+        into the result for the whole problem.
+
+        read_indices -- for each segment, the indices of its reads in the whole problem
+        read_count -- number of reads of the whole problem
+        """
+        assert results and len(results) == len(read_indices)
+        superreads = []
+        for individual, first_reads in enumerate(results[0]._superreads):
+            reads = []
+            for k, (name, mapq, source_id, sample_id, _) in enumerate(first_reads):
+                variants = []
+                for result in results:
+                    variants.extend(result._superreads[individual][k][4])
+                reads.append((name, mapq, source_id, sample_id, variants))
+            superreads.append(reads)
+        transmission_vector = []
+        partitioning = [0] * read_count
+        for result, indices in zip(results, read_indices):
+            transmission_vector.extend(result._transmission_vector)
+            for i, partition in zip(indices, result._partitioning):
+                partitioning[i] = partition
+        cost = sum(result._cost for result in results)
+        return cls(superreads, transmission_vector, cost, partitioning)
+
+    def get_super_reads(self) -> Tuple[List[ReadSet], List[int]]:
+        superreads_list = []
+        for reads in self._superreads:
+            readset = ReadSet()
+            for read in reads:
+                readset.add(_tuple_to_read(read))
+            superreads_list.append(readset)
+        return superreads_list, list(self._transmission_vector)
+
+    def get_optimal_cost(self) -> int:
+        return self._cost
+
+    def get_optimal_partitioning(self) -> List[int]:
+        return list(self._partitioning)
+
+
+def _read_to_tuple(read):
+    mapq = read.mapqs[0] if read.mapqs else 0
+    variants = [(v.position, v.allele, v.quality) for v in read]
+    return read.name, mapq, read.source_id, read.sample_id, variants
+
+
+def _tuple_to_read(t):
+    name, mapq, source_id, sample_id, variants = t
+    read = Read(name, mapq, source_id, sample_id)
+    for position, allele, quality in variants:
+        read.add_variant(position, allele, quality)
+    return read
+
+
+def independent_segments(readset: ReadSet, positions: List[int]) -> List[Tuple[int, int]]:
+    """
+    Split the (sorted) positions between neighbors that no read spans and return the
+    segments as (start, stop) index ranges. Every variant of the reads must be among
+    the positions.
+    """
+    segments = []
+    start = 0
+    for i, shared in enumerate(shared_read_counts(readset, positions)):
+        if shared == 0:
+            segments.append((start, i + 1))
+            start = i + 1
+    return segments
+
+
+def problem_key(readset: ReadSet, pedigree, samples, positions, parameters) -> str:
+    """
+    Return a hash identifying a phasing problem.
+
+    readset -- the (selected) reads; their order matters because the partitioning refers to it
+    pedigree -- Pedigree with the genotypes (and possibly genotype likelihoods) of all samples
+    samples -- names of the samples in the pedigree
+    positions -- the positions to be phased
+    parameters -- tuple of all further DP parameters (must have a stable repr())
+    """
+    h = hashlib.sha256()
+    h.update(repr((CACHE_FORMAT_VERSION, __version__, parameters)).encode())
+    h.update(repr(list(positions)).encode())
+    for read in readset:
+        h.update(repr((read.sample_id, [(v.position, v.allele, v.quality) for v in read])).encode())
+    for sample in samples:
+        genotypes = []
+        for i in range(pedigree.variant_count):
+            gl = pedigree.genotype_likelihoods(sample, i)
+            genotypes.append(
+                (pedigree.genotype(sample, i).as_vector(), None if gl is None else list(gl))
+            )
+        h.update(repr((sample, genotypes)).encode())
+    return h.hexdigest()
+
+
+class ResultCache:
+    """Content-addressed store of phasing results in a directory"""
+
+    def __init__(self, directory: str):
+        self._directory = directory
+        os.makedirs(directory, exist_ok=True)
+        self.hits = 0
+        self.misses = 0
+
+    def _path(self, key: str) -> str:
+        return os.path.join(self._directory, key[:2], key + ".pickle")
+
+    def get(self, key: str) -> Optional[CachedResult]:
+        """Return the stored result or None if there is none"""
+        try:
+            with open(self._path(key), "rb") as f:
+                result = pickle.load(f)
+        except FileNotFoundError:
+            self.misses += 1
+            return None
+        except (OSError, EOFError, pickle.UnpicklingError) as e:
+            logger.warning("Ignoring unreadable cache entry %s: %s", key, e)
+            self.misses += 1
+            return None
+        self.hits += 1
+        return CachedResult(*result)
+
+    def put(self, key: str, result: CachedResult) -> None:
+        """Store a result. The file is replaced atomically so that readers never see partial data."""
+        path = self._path(key)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        fd, tmp_path = tempfile.mkstemp(dir=os.path.dirname(path), suffix=".tmp")
+        try:
+            with os.fdopen(fd, "wb") as f:
+                pickle.dump(
+                    (
+                        result._superreads,
+                        result._transmission_vector,
+                        result._cost,
+                        result._partitioning,
+                    ),
+                    f,
+                    protocol=pickle.HIGHEST_PROTOCOL,
+                )
+            os.replace(tmp_path, path)
+        except BaseException:
+            os.unlink(tmp_path)
+            raise
@@ -0,0 +1,198 @@
+"""
+Resumable runs that keep finished chromosomes in a work directory
+
+Each chromosome is written to separate VCF files in the work directory (one per
+output VCF). When a chromosome is complete, it is recorded in a manifest together
+with the time spent in each stage and further statistics about it. A re-run with
+the same work directory skips all chromosomes listed in the manifest. At the end,
+the per-chromosome files are concatenated into the final output VCF(s).
+
+The manifest also stores a fingerprint of the input files and parameters. A work
+directory cannot be re-used for a run whose fingerprint differs.
+"""
+import json
+import logging
+import os
+import time
+from collections import defaultdict
+from typing import Dict, List, Optional
+
+from whatshap import __version__
+from whatshap.timer import StageTimer
+
+logger = logging.getLogger(__name__)
+
+MANIFEST_NAME = "manifest.json"
+
+# Increase when the layout of the work directory changes
+MANIFEST_VERSION = 1
+
+
+class WorkDirectoryError(Exception):
+    pass
+
+
+def run_fingerprint(command: str, input_files: List[str], parameters: Dict) -> Dict:
+    """
+    Describe a run by its command, the identity of its input files (path, size and
+    modification time) and its parameters, which must be serializable as JSON.
+    """
+    files = []
+    for path in input_files:
+        stat = os.stat(path)
+        files.append([os.path.abspath(path), stat.st_size, int(stat.st_mtime)])
+    return {
+        "version": __version__,
+        "command": command,
+        "input_files": files,
+        "parameters": parameters,
+    }
+
+
+class WorkDirectory:
+    """
+    Work directory of a resumable run.
+
+    Use it like this for each chromosome (in the order of the input VCF)::
+
+        if work_directory.is_finished(chromosome):
+            work_directory.skip(chromosome, [vcf_writer])
+            continue
+        work_directory.begin(chromosome, [vcf_writer])
+        ...  # process and write the chromosome
+        work_directory.finish()
+
+    and call concatenate() with the same writers after the last chromosome.
+    """
+
+    def __init__(self, directory: str, fingerprint: Dict, timers: StageTimer):
+        """
+        directory -- the work directory; it is created if it does not exist
+        fingerprint -- see run_fingerprint()
+        timers -- times spent on a chromosome are measured with this timer; times
+            recorded for skipped chromosomes are added to it
+        """
+        self._directory = directory
+        self._manifest_path = os.path.join(directory, MANIFEST_NAME)
+        # Round-trip through JSON so that tuples compare equal to the stored lists
+        self._fingerprint = json.loads(json.dumps(fingerprint))
+        self._timers = timers
+        # Finished chromosomes (including those from earlier runs) mapped to manifest entries
+        self._finished: Dict[str, Dict] = dict()
+        # Chromosomes seen during this run in the order of the input VCF
+        self._chromosomes: List[str] = []
+        self._current: Optional[tuple] = None
+        self.resumed = 0
+
+        os.makedirs(directory, exist_ok=True)
+        try:
+            with open(self._manifest_path) as f:
+                manifest = json.load(f)
+        except FileNotFoundError:
+            self._write_manifest()
+            return
+        except ValueError as e:
+            raise WorkDirectoryError(f"Cannot read manifest {self._manifest_path!r}: {e}")
+        if manifest.get("manifest_version") != MANIFEST_VERSION:
+            raise WorkDirectoryError(
+                f"Work directory {directory!r} was written by an incompatible WhatsHap version"
+            )
+        if manifest.get("fingerprint") != self._fingerprint:
+            raise WorkDirectoryError(
+                f"Work directory {directory!r} belongs to a run with different input files "
+                "or parameters. Use a new work directory or remove the existing one."
+            )
+        for entry in manifest["chromosomes"]:
+            if all(os.path.exists(self._path(part)) for part in entry["parts"]):
+                self._finished[entry["chromosome"]] = entry
+        logger.info(
+            "Found %d finished chromosome%s in work directory %r",
+            len(self._finished),
+            "" if len(self._finished) == 1 else "s",
+            directory,
+        )
+
+    def _path(self, name: str) -> str:
+        return os.path.join(self._directory, name)
+
+    def _write_manifest(self) -> None:
+        manifest = {
+            "manifest_version": MANIFEST_VERSION,
+            "fingerprint": self._fingerprint,
+            "chromosomes": list(self._finished.values()),
+        }
+        tmp_path = self._manifest_path + ".tmp"
+        with open(tmp_path, "w") as f:
+            json.dump(manifest, f, indent=2)
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(tmp_path, self._manifest_path)
+
+    def is_finished(self, chromosome: str) -> bool:
+        return chromosome in self._finished
+
+    def skip(self, chromosome: str, writers) -> None:
+        """
+        Skip a chromosome finished in an earlier run: Its records are skipped in the
+        writers' input and its recorded times are added to the timers.
+        """
+        assert self._current is None
+        entry = self._finished[chromosome]
+        assert len(entry["parts"]) == len(writers)
+        logger.info("======== Chromosome %r was already finished in an earlier run", chromosome)
+        for writer in writers:
+            writer.skip(chromosome)
+        self._timers.add(entry["timers"], entry["total_time"])
+        self._chromosomes.append(chromosome)
+        self.resumed += 1
+
+    def begin(self, chromosome: str, writers) -> None:
+        """Redirect the output of the writers for this chromosome into the work directory"""
+        assert self._current is None
+        assert chromosome not in self._finished
+        index = len(self._chromosomes)
+        parts = [f"{index:05d}-{i}.vcf.gz" for i in range(len(writers))]
+        for writer, part in zip(writers, parts):
+            writer.begin_part(self._path(part + ".tmp"))
+        self._current = (chromosome, writers, parts, self._timers.elapsed_times(), time.time())
+
+    def finish(self, statistics: Optional[Dict[str, float]] = None) -> None:
+        """
+        Mark the chromosome passed to begin() as finished. Its files are completed and
+        it is added to the manifest together with its times and the given statistics.
+        """
+        assert self._current is not None
+        chromosome, writers, parts, elapsed_before, start_time = self._current
+        self._current = None
+        for writer, part in zip(writers, parts):
+            writer.end_part()
+            os.replace(self._path(part + ".tmp"), self._path(part))
+        elapsed = self._timers.elapsed_times()
+        self._finished[chromosome] = {
+            "chromosome": chromosome,
+            "parts": parts,
+            "timers": {
+                stage: t - elapsed_before.get(stage, 0.0)
+                for stage, t in elapsed.items()
+                if t != elapsed_before.get(stage, 0.0)
+            },
+            "total_time": time.time() - start_time,
+            "statistics": statistics if statistics is not None else dict(),
+        }
+        self._chromosomes.append(chromosome)
+        self._write_manifest()
+
+    def concatenate(self, writers) -> None:
+        """Write the records of all chromosomes of this run to the final output of the writers"""
+        assert self._current is None
+        for chromosome in self._chromosomes:
+            for writer, part in zip(writers, self._finished[chromosome]["parts"]):
+                writer.append_part(self._path(part))
+
+    def statistics(self) -> Dict[str, float]:
+        """Sum of the statistics recorded for the chromosomes of this run"""
+        totals: Dict[str, float] = defaultdict(float)
+        for chromosome in self._chromosomes:
+            for key, value in self._finished[chromosome]["statistics"].items():
+                totals[key] += value
+        return dict(totals)
@@ -127,42 +127,108 @@ class PhasedInputReader:
                 m[variant_table.chromosome] = variant_table
             self._vcfs.append(m)
 
-    def read(self, chromosome, variants, sample, *, read_vcf=True, regions=None):
+    def read(
+        self, chromosome, variants, sample, *, read_vcf=True, regions=None, preselect_coverage=None
+    ):
         """
         Return a pair (readset, vcf_source_ids) where readset is a sorted ReadSet.
 
         Set read_vcf to False to not read phased blocks from the VCFs
+
+        preselect_coverage -- see ReadSetReader.read
         """
         readset_reader = self._readset_reader
         for_sample = "for sample {!r} ".format(sample) if not self._ignore_read_groups else ""
         logger.info("Reading alignments %sand detecting alleles ...", for_sample)
-        try:
-            reference = self._fasta[chromosome] if self._fasta else None
-        except KeyError:
-            raise CommandLineError(
-                "Chromosome {!r} present in VCF file, but not in the reference FASTA {!r}".format(
-                    chromosome, self._fasta.filename
-                )
-            )
+        reference = self._reference_sequence(chromosome)
 
         bam_sample = None if self._ignore_read_groups else sample
         try:
-            readset = readset_reader.read(chromosome, variants, bam_sample, reference, regions)
+            readset = readset_reader.read(
+                chromosome, variants, bam_sample, reference, regions, preselect_coverage
+            )
         except SampleNotFoundError:
             logger.warning("Sample %r not found in any BAM/CRAM file.", bam_sample)
             readset = ReadSet()
         except ReadSetError as e:
             raise CommandLineError(e)
         except ReferenceNotFoundError:
-            if chromosome.startswith("chr"):
-                alternative = chromosome[3:]
-            else:
-                alternative = "chr" + chromosome
-            message = "The chromosome {!r} was not found in the BAM/CRAM file.".format(chromosome)
-            if readset_reader.has_reference(alternative):
-                message += " Found {!r} instead".format(alternative)
-            raise CommandLineError(message)
+            raise CommandLineError(self._reference_not_found_message(chromosome))
+
+        vcf_source_ids = self._finish_readset(readset, chromosome, variants, sample, read_vcf)
+        return readset, vcf_source_ids
+
+    def read_samples(
+        self, chromosome, variants, samples, *, read_vcf=True, regions=None, preselect_coverage=None
+    ):
+        """
+        Return a dict that maps each of the samples to a pair (readset, vcf_source_ids)
+        as returned by read().
+
+        The alignments of all samples are read in a single pass over the BAM/CRAM files,
+        which avoids reading shared files once per sample.
+        """
+        if self._ignore_read_groups or len(samples) <= 1 or not self._bam_paths:
+            return {
+                sample: self.read(
+                    chromosome,
+                    variants,
+                    sample,
+                    read_vcf=read_vcf,
+                    regions=regions,
+                    preselect_coverage=preselect_coverage,
+                )
+                for sample in samples
+            }
+        logger.info(
+            "Reading alignments for samples %s and detecting alleles ...",
+            ", ".join(repr(sample) for sample in samples),
+        )
+        reference = self._reference_sequence(chromosome)
+        try:
+            readsets = self._readset_reader.read_samples(
+                chromosome, variants, samples, reference, regions, preselect_coverage
+            )
+        except ReadSetError as e:
+            raise CommandLineError(e)
+        except ReferenceNotFoundError:
+            raise CommandLineError(self._reference_not_found_message(chromosome))
+
+        result = dict()
+        for sample in samples:
+            if sample not in readsets:
+                logger.warning("Sample %r not found in any BAM/CRAM file.", sample)
+            readset = readsets.get(sample, ReadSet())
+            logger.info("Sample %r:", sample)
+            vcf_source_ids = self._finish_readset(readset, chromosome, variants, sample, read_vcf)
+            result[sample] = (readset, vcf_source_ids)
+        return result
+
+    def _reference_sequence(self, chromosome):
+        try:
+            return self._fasta[chromosome] if self._fasta else None
+        except KeyError:
+            raise CommandLineError(
+                "Chromosome {!r} present in VCF file, but not in the reference FASTA {!r}".format(
+                    chromosome, self._fasta.filename
+                )
+            )
 
+    def _reference_not_found_message(self, chromosome):
+        if chromosome.startswith("chr"):
+            alternative = chromosome[3:]
+        else:
+            alternative = "chr" + chromosome
+        message = "The chromosome {!r} was not found in the BAM/CRAM file.".format(chromosome)
+        if self._readset_reader.has_reference(alternative):
+            message += " Found {!r} instead".format(alternative)
+        return message
+
+    def _finish_readset(self, readset, chromosome, variants, sample, read_vcf):
+        """
+        Add phased blocks from the VCFs (if read_vcf is set) to the readset and sort it.
+        Return the set of source ids of the VCFs that were used.
+        """
         vcf_source_ids = set()
         if read_vcf:
             # TODO this is a bit clumsy
@@ -173,7 +239,7 @@ class PhasedInputReader:
             for i, vcf in enumerate(self._vcfs):
                 if chromosome in vcf:
                     variant_table = vcf[chromosome]
-                    source_id = readset_reader.n_paths + i
+                    source_id = self._readset_reader.n_paths + i
                     vcf_source_ids.add(source_id)
                     for read in variant_table.phased_blocks_as_reads(
                         sample, variants, source_id, sample_id
@@ -188,7 +254,7 @@ class PhasedInputReader:
         logger.info(
             "Found %d reads covering %d variants", len(readset), len(readset.get_positions())
         )
-        return readset, vcf_source_ids
+        return vcf_source_ids
 
 
 def log_memory_usage(include_children=False):
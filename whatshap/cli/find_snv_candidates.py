@@ -4,14 +4,21 @@ Generate candidate SNP positions.
 
 import pysam
 import sys
-import re
 import pyfaidx
-from collections import defaultdict
 import datetime
 import logging
+from multiprocessing import Pool
+
+from whatshap._pileup import PileupCounts
 
 logger = logging.getLogger(__name__)
 
+# Chromosomes are split into regions of this size, which are processed independently
+REGION_SIZE = 10_000_000
+
+# Alignments with any of these flags are skipped (same as the default for pysam's pileup)
+SKIP_FLAGS = 0x4 | 0x100 | 0x200 | 0x400  # unmapped, secondary, QC fail, duplicate
+
 
 # fmt: off
 def add_arguments(parser):
@@ -29,6 +36,8 @@ def add_arguments(parser):
     add('--chromosome', dest='chromosome', metavar='CHROMOSOME', default=None,
         help='Name of chromosome to process. If not given, all chromosomes are processed.')
     add('-o', '--output', default=sys.stdout, help='Output VCF file.')
+    add('--threads', '-t', metavar='THREADS', type=int, default=1,
+        help='Number of regions to process in parallel (default: %(default)s).')
     group = parser.add_mutually_exclusive_group()
     group.add_argument(
         '--pacbio', dest='datatype', action='store_const', const='pacbio',
@@ -46,6 +55,76 @@ def validate(args, parser):
     pass
 
 
+# Files opened once per (worker) process by _open_files
+_bam = None
+_fasta = None
+
+
+def _open_files(bam, ref):
+    global _bam, _fasta
+    _bam = pysam.AlignmentFile(bam, "rb")
+    _fasta = pyfaidx.Fasta(ref, as_raw=True)
+
+
+def call_region(region, minabs, minrel, min_mapping_quality=20, min_base_quality=5):
+    """
+    Count the bases of all usable alignments in the region (chromosome, start, end) and return
+    the candidate SNV positions in it as a list of (chromosome, position, ref, alts) tuples.
+    See PileupCounts.candidates.
+
+    Alignments are filtered as in a pysam pileup with default settings: Unmapped, secondary,
+    QC-failed, duplicate and improperly paired reads are skipped, and bases in the overlap of
+    two mates are counted only once.
+    """
+    chromosome, start, end = region
+    counts = PileupCounts(start, end, min_base_quality)
+    # Maps the names of reads whose mate is expected to overlap them to their end position
+    mate_overlaps = dict()
+    for alignment in _bam.fetch(chromosome, start, end):
+        if alignment.flag & SKIP_FLAGS or alignment.mapping_quality < min_mapping_quality:
+            continue
+        if alignment.is_paired and not alignment.is_proper_pair:
+            continue
+        sequence = alignment.query_sequence
+        if sequence is None:
+            continue
+        skip_until = -1
+        if alignment.is_paired and alignment.next_reference_id == alignment.reference_id:
+            if alignment.query_name in mate_overlaps:
+                skip_until = mate_overlaps.pop(alignment.query_name)
+            elif (
+                alignment.reference_start
+                <= alignment.next_reference_start
+                < alignment.reference_end
+            ):
+                mate_overlaps[alignment.query_name] = alignment.reference_end
+        counts.add(
+            alignment.reference_start,
+            alignment.cigartuples,
+            sequence.encode(),
+            alignment.query_qualities,
+            skip_until,
+        )
+    reference = _fasta[chromosome][start:end].upper().encode()
+    return [
+        (chromosome, position, ref, alts)
+        for position, ref, alts in counts.candidates(reference, minabs, minrel)
+    ]
+
+
+def _call_region_star(args):
+    return call_region(*args)
+
+
+def split_regions(bamfile, chromosome=None, region_size=REGION_SIZE):
+    """Split the chromosomes in the BAM header into regions of at most region_size bp"""
+    for name, length in zip(bamfile.references, bamfile.lengths):
+        if chromosome is not None and name != chromosome:
+            continue
+        for start in range(0, length, region_size):
+            yield (name, start, min(start + region_size, length))
+
+
 def run_find_snv_candidates(
     ref,
     bam,
@@ -56,6 +135,7 @@ def run_find_snv_candidates(
     sample="sample",
     chromosome=None,
     output=sys.stdout,
+    threads=1,
 ):
     outfile = output
     if output != sys.stdout:
@@ -69,8 +149,7 @@ def run_find_snv_candidates(
     if datatype == "illumina":
         minabs = 3
         minrel = 0.25
-    print(minabs, minrel)
-    fasta = pyfaidx.Fasta(ref, as_raw=True)
+    logger.info("Using minabs=%d and minrel=%s", minabs, minrel)
     print("##fileformat=VCFv4.2", file=outfile)
     print("##fileDate={}".format(datetime.datetime.now().strftime("%Y%m%d")), file=outfile)
     print('##FORMAT=<ID=GT,Number=1,Type=String,Description="Genotype">', file=outfile)
@@ -80,65 +159,20 @@ def run_find_snv_candidates(
         header_columns += ["FORMAT", sample]
     print(*header_columns, sep="\t", file=outfile)
 
-    re_nucleotide = re.compile("[ACGTNacgtn]")
-    re_indel = re.compile("[-\\+]([0-9]+)")
-    re_ref = re.compile("[,\\.]")
-    re_ignore = re.compile("([\\$\\*]|\\^.)")
-
-    bamfile = pysam.AlignmentFile(bam, "rb")
-    for pileupcolumn in bamfile.pileup(
-        contig=chromosome, min_mapping_quality=20, min_base_quality=5
-    ):
-        try:
-            pileup = "".join(
-                pileupcolumn.get_query_sequences(mark_matches=True, mark_ends=True, add_indels=True)
-            )
-        except AssertionError:
-            # TODO: seems to happen when there are large insertions/deletions
-            continue
-        position = pileupcolumn.reference_pos + 1
-        chromosome = pileupcolumn.reference_name
-        i = 0
-        bases = defaultdict(int)
-        n = 0
-        ref = fasta[chromosome][position - 1].upper()
-        if ref == "N":
-            continue
-        while i < len(pileup):
-            m = re_nucleotide.match(pileup[i:])
-            if m is not None:
-                bases[pileup[i].upper()] += 1
-                n += 1
-                i += 1
-                continue
-            m = re_indel.match(pileup[i:])
-            if m is not None:
-                l = int(m.group(1))
-                skip = (m.end() - m.start()) + l
-                i += skip
-                continue
-            m = re_ref.match(pileup[i:])
-            if m is not None:
-                bases[ref] += 1
-                n += 1
-                i += 1
-                continue
-            m = re_ignore.match(pileup[i:])
-            if m is not None:
-                skip = m.end() - m.start()
-                i += skip
-                continue
-            assert False
-        ref_count = bases[ref]
-        alts = []
-        for base, count in bases.items():
-            if base == ref:
-                continue
-            if (count >= minabs) and (count / (count + ref_count) >= minrel):
-                alts.append((count, base))
-        alts.sort(reverse=True)
-        if len(alts) > 0:
-            columns = [chromosome, position, ".", ref, ".", ".", "PASS", "."]
+    with pysam.AlignmentFile(bam, "rb") as bamfile:
+        regions = list(split_regions(bamfile, chromosome))
+    jobs = ((region, minabs, minrel) for region in regions)
+    if threads == 1:
+        _open_files(bam, ref)
+        results = map(_call_region_star, jobs)
+        pool = None
+    else:
+        pool = Pool(processes=threads, initializer=_open_files, initargs=(bam, ref))
+        results = pool.imap(_call_region_star, jobs)
+
+    for candidates in results:
+        for chromosome, position, ref, alts in candidates:
+            columns = [chromosome, position + 1, ".", ref, ".", ".", "PASS", "."]
             if sample is not None:
                 columns += ["GT", "."]
             if multi_allelics:
@@ -146,11 +180,13 @@ def run_find_snv_candidates(
             else:
                 # Do we have two equally supported ALT alleles
                 if len(alts) > 1 and (alts[0][0] == alts[1][0]):
-                    columns[4] = "N"
                     continue
                 else:
                     columns[4] = alts[0][1]
             print(*columns, sep="\t", file=outfile)
+    if pool is not None:
+        pool.close()
+        pool.join()
     if output != sys.stdout:
         outfile.close()
 
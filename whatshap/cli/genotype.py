@@ -27,6 +27,7 @@ from whatshap.pedigree import (
     GeneticMapRecombinationCostComputer,
 )
 from whatshap.timer import StageTimer
+from whatshap.checkpoint import WorkDirectory, WorkDirectoryError, run_fingerprint
 from whatshap.cli import log_memory_usage
 from whatshap.cli.phase import select_reads, setup_families
 from whatshap.cli import CommandLineError, PhasedInputReader
@@ -91,11 +92,24 @@ def run_genotype(
     mismatch=15,
     write_command_line_header=True,
     use_ped_samples=False,
+    work_dir=None,
+    approximation_epsilon=0.0,
 ):
     """
     For now: this function only runs the genotyping algorithm. Genotype likelihoods for
     all variants are computed using the forward backward algorithm
+
+    work_dir -- directory in which finished chromosomes are kept; when re-running an
+        interrupted run with the same work directory, these are not recomputed
+    approximation_epsilon -- if positive, drop states of the forward-backward algorithm
+        whose probability is below this fraction of the most likely state in their column
     """
+    # Parameters that influence the result (used to recognize a run in a work directory)
+    parameters = {
+        name: value
+        for name, value in locals().items()
+        if name not in ("phase_input_files", "variant_file", "output", "work_dir")
+    }
     timers = StageTimer()
     logger.info(
         "This is WhatsHap (genotyping) %s running under Python %s",
@@ -106,6 +120,25 @@ def run_genotype(
         command_line = "(whatshap {}) {}".format(__version__, " ".join(sys.argv[1:]))
     else:
         command_line = None
+
+    work_directory = None
+    if work_dir is not None:
+        try:
+            work_directory = WorkDirectory(
+                work_dir,
+                run_fingerprint(
+                    "genotype",
+                    # The reference, pedigree and genetic map also determine the result
+                    [variant_file]
+                    + phase_input_files
+                    + [path for path in (reference, ped, genmap) if isinstance(path, str)],
+                    parameters,
+                ),
+                timers,
+            )
+        except (OSError, WorkDirectoryError) as e:
+            raise CommandLineError(e)
+
     with ExitStack() as stack:
         # read the given input files (BAMs, VCFs, ref...)
         numeric_sample_ids = NumericSampleIds()
@@ -140,6 +173,7 @@ def run_genotype(
                     out_file=stack.enter_context(open(prioroutput, "w")),
                 )
             )
+        writers = [vcf_writer] if prior_vcf_writer is None else [vcf_writer, prior_vcf_writer]
 
         # parse vcf with input variants
         # remove all likelihoods that may already be present
@@ -195,6 +229,7 @@ def run_genotype(
 
         # compute genotype likelihood threshold
         gt_prob = 1.0 - (10 ** (-gt_qual_threshold / 10.0))
+        max_discarded_fraction = 0.0
 
         for variant_table in timers.iterate("parse_vcf", vcf_reader):
 
@@ -204,6 +239,11 @@ def run_genotype(
                 var_to_pos[variant_table.variants[i].position] = i
 
             chromosome = variant_table.chromosome
+            if work_directory is not None:
+                if work_directory.is_finished(chromosome):
+                    work_directory.skip(chromosome, writers)
+                    continue
+                work_directory.begin(chromosome, writers)
             if (not chromosomes) or (chromosome in chromosomes):
                 logger.info("======== Working on chromosome %r", chromosome)
             else:
@@ -214,43 +254,54 @@ def run_genotype(
                 vcf_writer.write_unchanged(chromosome)
                 if prioroutput is not None:
                     prior_vcf_writer.write_unchanged(chromosome)
+                if work_directory is not None:
+                    work_directory.finish()
                 continue
 
+            # Statistics about the DPs of all families (kept in the work directory)
+            statistics = {"genotyping_reads": 0, "genotyped_variants": 0}
+
             positions = [v.position for v in variant_table.variants]
             if not nopriors:
                 # compute prior genotype likelihoods based on all reads
-                for sample in samples:
-                    logger.info("---- Initial genotyping of %s", sample)
+                for family in families.values():
                     with timers("read_bam"):
-                        readset, vcf_source_ids = phased_input_reader.read(
-                            chromosome, variant_table.variants, sample, read_vcf=False
+                        family_readsets = phased_input_reader.read_samples(
+                            chromosome, variant_table.variants, family, read_vcf=False
                         )
-                        readset.sort()
-                        genotypes, genotype_likelihoods = compute_genotypes(readset, positions)
-                        # recompute genotypes based on given threshold
-                        reg_genotype_likelihoods = []
-                        for gl in range(len(genotype_likelihoods)):
-                            norm_sum = (
-                                genotype_likelihoods[gl][0]
-                                + genotype_likelihoods[gl][1]
-                                + genotype_likelihoods[gl][2]
-                                + 3 * constant
-                            )
-                            regularized = PhredGenotypeLikelihoods(
+                    for sample in family:
+                        logger.info("---- Initial genotyping of %s", sample)
+                        readset, vcf_source_ids = family_readsets.pop(sample)
+                        with timers("read_bam"):
+                            readset.sort()
+                            genotypes, genotype_likelihoods = compute_genotypes(readset, positions)
+                            # recompute genotypes based on given threshold
+                            reg_genotype_likelihoods = []
+                            for gl in range(len(genotype_likelihoods)):
+                                norm_sum = (
+                                    genotype_likelihoods[gl][0]
+                                    + genotype_likelihoods[gl][1]
+                                    + genotype_likelihoods[gl][2]
+                                    + 3 * constant
+                                )
+                                regularized = PhredGenotypeLikelihoods(
+                                    [
+                                        (genotype_likelihoods[gl][0] + constant) / norm_sum,
+                                        (genotype_likelihoods[gl][1] + constant) / norm_sum,
+                                        (genotype_likelihoods[gl][2] + constant) / norm_sum,
+                                    ]
+                                )
+                                genotypes[gl] = determine_genotype(regularized, gt_prob)
+                                assert isinstance(genotypes[gl], Genotype)
+                                reg_genotype_likelihoods.append(regularized)
+                            variant_table.set_genotype_likelihoods_of(
+                                sample,
                                 [
-                                    (genotype_likelihoods[gl][0] + constant) / norm_sum,
-                                    (genotype_likelihoods[gl][1] + constant) / norm_sum,
-                                    (genotype_likelihoods[gl][2] + constant) / norm_sum,
-                                ]
+                                    PhredGenotypeLikelihoods(list(gl))
+                                    for gl in reg_genotype_likelihoods
+                                ],
                             )
-                            genotypes[gl] = determine_genotype(regularized, gt_prob)
-                            assert isinstance(genotypes[gl], Genotype)
-                            reg_genotype_likelihoods.append(regularized)
-                        variant_table.set_genotype_likelihoods_of(
-                            sample,
-                            [PhredGenotypeLikelihoods(list(gl)) for gl in reg_genotype_likelihoods],
-                        )
-                        variant_table.set_genotypes_of(sample, genotypes)
+                            variant_table.set_genotypes_of(sample, genotypes)
             else:
 
                 # use uniform genotype likelihoods for all individuals
@@ -277,12 +328,12 @@ def run_genotype(
 
                 # Get the reads belonging to each sample
                 readsets = dict()
+                with timers("read_bam"):
+                    family_readsets = phased_input_reader.read_samples(
+                        chromosome, variant_table.variants, family
+                    )
                 for sample in family:
-                    with timers("read_bam"):
-                        readset, vcf_source_ids = phased_input_reader.read(
-                            chromosome, variant_table.variants, sample
-                        )
-
+                    readset, vcf_source_ids = family_readsets.pop(sample)
                     with timers("select"):
                         readset = readset.subset(
                             [i for i, read in enumerate(readset) if len(read) >= 2]
@@ -347,7 +398,17 @@ def run_genotype(
                         recombination_costs,
                         pedigree,
                         accessible_positions,
+                        approximation_epsilon,
                     )
+                    if approximation_epsilon > 0:
+                        discarded_fraction = forward_backward_table.get_max_discarded_fraction()
+                        logger.info(
+                            "Largest fraction of probability mass discarded from a column: %.3g",
+                            discarded_fraction,
+                        )
+                        max_discarded_fraction = max(max_discarded_fraction, discarded_fraction)
+                    statistics["genotyping_reads"] += len(all_reads)
+                    statistics["genotyped_variants"] += len(accessible_positions)
                     # store results
                     for s in family:
                         likelihood_list = variant_table.genotype_likelihoods_of(s)
@@ -370,8 +431,15 @@ def run_genotype(
                 vcf_writer.write_genotypes(chromosome, variant_table, indels)
                 logger.info("Done writing VCF")
 
+            if work_directory is not None:
+                work_directory.finish(statistics)
             logger.debug("Chromosome %r finished", chromosome)
 
+        if work_directory is not None:
+            with timers("write_vcf"):
+                logger.info("======== Concatenating chromosomes from work directory")
+                work_directory.concatenate(writers)
+
     logger.info("\n== SUMMARY ==")
     total_time = timers.total()
     log_memory_usage()
@@ -389,6 +457,19 @@ def run_genotype(
     logger.info("Time spent writing VCF:                      %6.1f s", timers.elapsed("write_vcf"))
     logger.info("Time spent on rest:                          %6.1f s", total_time - timers.sum())
     logger.info("Total elapsed time:                          %6.1f s", total_time)
+    if approximation_epsilon > 0:
+        logger.info("Largest discarded fraction per column:       %6.3g", max_discarded_fraction)
+    if work_directory is not None:
+        statistics = work_directory.statistics()
+        logger.info("Chromosomes finished in earlier runs:        %6d", work_directory.resumed)
+        logger.info(
+            "Reads used for genotyping (all chromosomes): %6d",
+            statistics.get("genotyping_reads", 0),
+        )
+        logger.info(
+            "Variants genotyped (all chromosomes):        %6d",
+            statistics.get("genotyped_variants", 0),
+        )
 
 
 # fmt: off
@@ -405,6 +486,10 @@ def add_arguments(parser):
     arg('--reference', '-r', metavar='FASTA',
         help='Reference file. Provide this to detect alleles through re-alignment. '
         'If no index (.fai) exists, it will be created')
+    arg('--work-dir', metavar='DIR', default=None,
+        help='Resumable mode: Keep each finished chromosome in DIR and concatenate them into '
+        'the output at the end. When re-running an interrupted run with the same DIR, '
+        'finished chromosomes are skipped. (default: write output directly)')
 
     arg = parser.add_argument_group('Input pre-processing, selection and filtering').add_argument
     arg('--max-coverage', '-H', metavar='MAXCOV', default=15, type=int,
@@ -441,6 +526,11 @@ def add_arguments(parser):
         help='gap extend penalty in case affine gap costs are used (default: %(default)s).')
     arg('--mismatch', metavar='MISMATCH', default=15, type=float,
         help='mismatch cost in case affine gap costs are used (default: %(default)s)')
+    arg('--approximate', metavar='EPSILON', dest='approximation_epsilon', default=0.0, type=float,
+        help='Speed up genotyping at high coverage by dropping states of the forward-backward '
+        'algorithm whose probability is below EPSILON times that of the most likely state '
+        '(e.g. 1e-6). The largest fraction of probability mass discarded from a column is '
+        'reported. Default: exact computation.')
 
     arg = parser.add_argument_group('Pedigree genotyping').add_argument
     arg('--ped', metavar='PED/FAM',
@@ -471,6 +561,8 @@ def validate(args, parser):
         )
     if len(args.phase_input_files) == 0:
         parser.error("Not providing any PHASEINPUT files not allowed for genotyping.")
+    if args.approximation_epsilon < 0:
+        parser.error("EPSILON given to --approximate must not be negative.")
     if args.gt_qual_threshold < 0:
         parser.error("Genotype quality threshold (gt-qual-threshold) must be at least 0.")
     if args.prioroutput is not None and args.nopriors:
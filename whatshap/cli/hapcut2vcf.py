@@ -20,8 +20,14 @@ import itertools
 from contextlib import ExitStack
 
 from whatshap.cli import CommandLineError
-from whatshap.vcf import PhasedVcfWriter
-from whatshap.core import Read
+from whatshap.vcf import (
+    VcfRewriter,
+    is_phasable_record,
+    repair_header,
+    set_PS,
+    setup_phasing_header,
+    unphase_call,
+)
 from whatshap import __version__
 
 logger = logging.getLogger(__name__)
@@ -35,6 +41,14 @@ def add_arguments(parser):
         default=sys.stdout,
         help="Output VCF file. If omitted, use standard output.",
     )
+    add(
+        "--threads",
+        "-t",
+        metavar="THREADS",
+        type=int,
+        default=1,
+        help="Number of threads for BGZF decompression and compression (default: %(default)s).",
+    )
     add("vcf", metavar="VCF", help="VCF file")
     add("hapcut", metavar="HAPCUT-RESULT", help="hapCUT result file")
 
@@ -159,41 +173,104 @@ class HapCutParser:
             yield block
 
     def _by_chromosome(self):
-        for chromosome, block in itertools.groupby(self.parse_blocks(), lambda b: b[0].chromosome):
-            yield chromosome, list(block)
+        for chromosome, blocks in itertools.groupby(self.parse_blocks(), lambda b: b[0].chromosome):
+            yield chromosome, list(blocks)
+
+    def phases_by_chromosome(self):
+        """
+        Yield (chromosome, phases) pairs, where phases maps each phased position to a
+        (haplotype1, haplotype2, component_id) tuple. Only the blocks of the current
+        chromosome are kept in memory.
+        """
+        for chromosome, blocks in itertools.groupby(self.parse_blocks(), lambda b: b[0].chromosome):
+            phases = dict()
+            n_blocks = 0
+            for block in blocks:
+                n_blocks += 1
+                for variant in block:
+                    phases[variant.position] = (
+                        variant.haplotype1,
+                        variant.haplotype2,
+                        variant.component_id,
+                    )
+            logger.info("Read %d phased blocks for chromosome %s", n_blocks, chromosome)
+            yield chromosome, phases
+
+
+class HapCutPhaser:
+    """
+    Set the phases from a HapCUT result on the records of a single-sample VCF.
 
+    Chromosomes must appear in the same order in the VCF and the HapCUT result, which
+    is read incrementally as the records are streamed.
+    """
 
-def run_hapcut2vcf(hapcut, vcf, output=sys.stdout):
+    def __init__(self, parser: HapCutParser, sample: str):
+        self._sample = sample
+        self._chromosomes = iter(parser.phases_by_chromosome())
+        self._next = next(self._chromosomes, None)
+        self._chromosome = None
+        self._phases = dict()
+        self._prev_pos = None
+        self._phase_tag_found_warned = False
+
+    def _switch_chromosome(self, chromosome):
+        self._chromosome = chromosome
+        self._prev_pos = None
+        if self._next is not None and self._next[0] == chromosome:
+            self._phases = self._next[1]
+            self._next = next(self._chromosomes, None)
+        else:
+            self._phases = dict()
+
+    def __call__(self, records):
+        for record in records:
+            if record.chrom != self._chromosome:
+                self._switch_chromosome(record.chrom)
+            call = record.samples[self._sample]
+            unphase_call(call)
+            pos = record.start
+            if not is_phasable_record(record, self._prev_pos, indels=False):
+                continue
+            if pos not in self._phases:
+                continue
+            haplotype1, haplotype2, component_id = self._phases[pos]
+            if haplotype1 not in (0, 1) or haplotype2 not in (0, 1):
+                continue
+            self._prev_pos = pos
+            if call.get("PS") is not None and not self._phase_tag_found_warned:
+                logger.warning(
+                    "Ignoring existing phasing information found in input VCF (PS tag exists)."
+                )
+                self._phase_tag_found_warned = True
+
+            phase = (haplotype1, haplotype2)
+            gt = call["GT"]
+            if gt is None or None in gt or sorted(gt) != sorted(phase):
+                call["GT"] = tuple(sorted(phase))
+            if haplotype1 != haplotype2:
+                set_PS(call, component_id, phase)
+            else:
+                call["PS"] = None
+
+
+def run_hapcut2vcf(hapcut, vcf, output=sys.stdout, threads=1):
     command_line = "(whatshap {}) {}".format(__version__, " ".join(sys.argv[1:]))
     with ExitStack() as stack:
-        if isinstance(output, str):
-            output = stack.enter_context(open(output, "w"))
-
-        writer = PhasedVcfWriter(vcf, command_line, out_file=output)
-        if len(writer.samples) > 1:
+        rewriter = stack.enter_context(VcfRewriter(vcf, output, threads))
+        if len(rewriter.samples) > 1:
             # This would be easy to support with a --sample command-line parameter,
             # but hapCUT does not seem to support multi-sample VCFs, so something
             # must be wrong anyway.
             raise CommandLineError("There is more than one sample in this VCF")
-        sample = writer.samples[0]
+        sample = rewriter.samples[0]
 
-        f = stack.enter_context(open(hapcut))
-        parser = HapCutParser(f)
-        for chromosome, blocks in parser:
-            logger.info("Read %d phased blocks for chromosome %s", len(blocks), chromosome)
+        # Same header modifications as in PhasedVcfWriter
+        repair_header(rewriter.header, vcf, command_line)
+        setup_phasing_header(rewriter.header, "PS")
 
-            # Build one read for each haplotype and the connected components
-            haplotypes = [Read(str(i)) for i in (1, 2)]
-            components = dict()
-            for block in blocks:
-                for variant in block:
-                    haplotypes[0].add_variant(variant.position, variant.haplotype1, 0)
-                    haplotypes[1].add_variant(variant.position, variant.haplotype2, 0)
-                    components[variant.position] = variant.component_id
-
-            sample_superreads = {sample: haplotypes}
-            sample_components = {sample: components}
-            writer.write(chromosome, sample_superreads, sample_components)
+        f = stack.enter_context(open(hapcut))
+        rewriter.rewrite(HapCutPhaser(HapCutParser(f), sample))
 
 
 def main(args):
@@ -10,8 +10,8 @@ import sys
 import platform
 
 from argparse import SUPPRESS
+from bisect import bisect_right
 from collections import defaultdict
-from copy import deepcopy
 
 from contextlib import ExitStack
 from typing import Optional, List, TextIO, Union, Dict
@@ -24,13 +24,15 @@ from whatshap.core import (
     Pedigree,
     PedigreeDPTable,
     NumericSampleIds,
-    PhredGenotypeLikelihoods,
     HapChatCore,
+    ComponentFinder as PositionComponentFinder,
+    set_dp_scratch_directory,
+    classify_genotypes,
+    mendelian_conflict_indices,
 )
 from whatshap.graph import ComponentFinder
 from whatshap.pedigree import (
     PedReader,
-    mendelian_conflict,
     UniformRecombinationCostComputer,
     GeneticMapRecombinationCostComputer,
     find_recombination,
@@ -41,6 +43,9 @@ from whatshap.timer import StageTimer
 from whatshap.utils import plural_s, warn_once
 from whatshap.cli import CommandLineError, log_memory_usage, PhasedInputReader
 from whatshap.merge import ReadMerger, DoNothingReadMerger, ReadMergerBase
+from whatshap.cache import ResultCache, CachedResult, independent_segments, problem_key
+from whatshap.checkpoint import WorkDirectory, WorkDirectoryError, run_fingerprint
+from whatshap.planner import CoveragePlanner, CoveragePlan, parse_size, dp_cost
 
 __author__ = "Murray Patterson, Alexander Schönhuth, Tobias Marschall, Marcel Martin"
 
@@ -53,6 +58,7 @@ def find_components(phased_positions, reads, master_block=None, heterozygous_pos
     Variants are considered to be in the same component if a read exists that
     covers both. A component is identified by the position of its leftmost
     variant.
+    reads -- ReadSet
     master_block -- List of positions in a "master block", i.e. all blocks containing
                     any of these positions are merged into one block.
     heterozygous_positions -- A dictionary mapping numeric sample ids to sets of
@@ -62,29 +68,18 @@ def find_components(phased_positions, reads, master_block=None, heterozygous_pos
     logger.debug("Finding connected components ...")
     assert phased_positions == sorted(phased_positions)
 
-    # Find connected components.
-    # A component is identified by the position of its leftmost variant.
-    component_finder = ComponentFinder(phased_positions)
-    phased_positions = set(phased_positions)
-    for read in reads:
-        if heterozygous_positions is None:
-            positions = [
-                variant.position for variant in read if variant.position in phased_positions
-            ]
-        else:
-            positions = [
-                variant.position
-                for variant in read
-                if (variant.position in phased_positions)
-                and (variant.position in heterozygous_positions[read.sample_id])
-            ]
-        for position in positions[1:]:
-            component_finder.merge(positions[0], position)
+    component_finder = PositionComponentFinder(phased_positions)
+    if heterozygous_positions is not None:
+        for sample_id, positions in heterozygous_positions.items():
+            component_finder.restrict_to_heterozygous(sample_id, positions)
+    return _components_dict(phased_positions, component_finder, reads, master_block)
+
+
+def _components_dict(phased_positions, component_finder, reads, master_block):
+    component_finder.add_reads(reads)
     if master_block is not None:
-        for position in master_block[1:]:
-            component_finder.merge(master_block[0], position)
-    components = {position: component_finder.find(position) for position in phased_positions}
-    return components
+        component_finder.merge_block(master_block)
+    return dict(zip(phased_positions, component_finder.components()))
 
 
 def find_largest_component(components):
@@ -106,24 +101,17 @@ def find_largest_component(components):
 
 def best_case_blocks(reads):
     """
-    Given a list of core reads, determine the number of phased blocks that
+    Given a ReadSet of core reads, determine the number of phased blocks that
     would result if each variant were actually phased.
 
     Return the number of connected components and non-singleton components.
     """
-    positions = set()
-    for read in reads:
-        for variant in read:
-            positions.add(variant.position)
-    component_finder = ComponentFinder(positions)
-    for read in reads:
-        read_positions = [variant.position for variant in read]
-        for position in read_positions[1:]:
-            component_finder.merge(read_positions[0], position)
+    component_finder = PositionComponentFinder(reads.get_positions())
+    component_finder.add_reads(reads)
     # A dict that maps each component to the number of variants it contains
     component_sizes = defaultdict(int)
-    for position in positions:
-        component_sizes[component_finder.find(position)] += 1
+    for component in component_finder.components():
+        component_sizes[component] += 1
     non_singletons = [component for component, size in component_sizes.items() if size > 1]
     return len(component_sizes), len(non_singletons)
 
@@ -143,6 +131,31 @@ def select_reads(readset, max_coverage, preferred_source_ids):
     return selected_reads
 
 
+def select_reads_planned(readset, plan: CoveragePlan, family_size, preferred_source_ids):
+    """
+    Select reads separately for each coverage target of the plan. The per-sample
+    coverage is the planned total coverage divided by the family size.
+    """
+    groups = plan.group_reads(readset)
+    logger.info(
+        "Reducing coverage to the planned %s by selecting most informative reads ...",
+        ", ".join(f"{max(1, c // family_size)}X" for c in sorted(groups)),
+    )
+    selected_indices = []
+    for coverage, indices in groups.items():
+        group_indices = readselection(
+            readset.subset(indices), max(1, coverage // family_size), preferred_source_ids
+        )
+        selected_indices.extend(indices[i] for i in group_indices)
+    selected_reads = readset.subset(selected_indices)
+    logger.info(
+        "Selected %d reads covering %d variants",
+        len(selected_reads),
+        len(selected_reads.get_positions()),
+    )
+    return selected_reads
+
+
 class ReadList:
     """Write a list of reads that have been used for phasing to a file"""
 
@@ -252,6 +265,24 @@ def setup_pedigree(ped_path, samples):
     return trios, pedigree_samples
 
 
+# Parameters of run_whatshap that do not influence the phasing result
+NON_PHASING_PARAMETERS = frozenset(
+    [
+        "phase_input_files",
+        "variant_file",
+        "output",
+        "write_command_line_header",
+        "read_list_filename",
+        "gtchange_list_filename",
+        "recombination_list_filename",
+        "dp_scratch_dir",
+        "cache_dir",
+        "work_dir",
+        "read_merging_threads",
+    ]
+)
+
+
 def run_whatshap(
     phase_input_files: List[str],
     variant_file: str,
@@ -267,6 +298,7 @@ def run_whatshap(
     read_merging_max_error_rate: float = 0.25,
     read_merging_positive_threshold: int = 1000000,
     read_merging_negative_threshold: int = 1000,
+    read_merging_threads: int = 1,
     max_coverage: int = 15,
     distrust_genotypes: bool = False,
     include_homozygous: bool = False,
@@ -283,6 +315,13 @@ def run_whatshap(
     write_command_line_header: bool = True,
     use_ped_samples: bool = False,
     algorithm: str = "whatshap",
+    dp_scratch_dir: Optional[str] = None,
+    dp_memory_budget: Optional[int] = None,
+    dp_time_budget: Optional[float] = None,
+    cache_dir: Optional[str] = None,
+    work_dir: Optional[str] = None,
+    transmission_pruning: Optional[int] = None,
+    preselect: Optional[float] = None,
 ):
     """
     Run WhatsHap.
@@ -300,6 +339,7 @@ def run_whatshap(
     read_merging_max_error_rate -- max error rate on edge of merge graph considered
     read_merging_positive_threshold -- threshold on the ratio of the two probabilities
     read_merging_negative_threshold -- threshold on the opposite ratio of positive threshold
+    read_merging_threads -- number of threads used for scoring pairs of reads when merging
     max_coverage
     distrust_genotypes
     include_homozygous
@@ -312,7 +352,25 @@ def run_whatshap(
     gtchange_list_filename -- filename to write list of changed genotypes to
     default_gq -- genotype likelihood to be used when GL or PL not available
     write_command_line_header -- whether to add a ##commandline header to the output VCF
+    dp_scratch_dir -- directory for scratch files holding large DP table columns
+    dp_memory_budget -- if given, adapt coverage of each read-connected component such that
+        the DP is predicted to use at most this many bytes
+    dp_time_budget -- if given, adapt coverage of each read-connected component such that
+        the DP is predicted to take at most this many seconds
+    cache_dir -- directory in which to cache phasing results; unchanged problems are not
+        recomputed when re-running
+    work_dir -- directory in which finished chromosomes are kept; when re-running an
+        interrupted run with the same work directory, these are not recomputed
+    transmission_pruning -- in pedigree mode, only pursue transmission vectors whose cost is
+        within this margin of the best one in each column (None: no pruning)
+    preselect -- if given, skip alignments before allele detection where variants are
+        already spanned by more than this factor times the maximum coverage per sample
+        (None: detect alleles in all alignments)
     """
+    # Parameters that influence the phasing (used to recognize a run in a work directory)
+    parameters = {
+        name: value for name, value in locals().items() if name not in NON_PHASING_PARAMETERS
+    }
 
     if algorithm == "hapchat" and ped is not None:
         raise CommandLineError("The hapchat algorithm cannot do pedigree phasing")
@@ -333,11 +391,44 @@ def run_whatshap(
             read_merging_max_error_rate,
             read_merging_positive_threshold,
             read_merging_negative_threshold,
+            read_merging_threads,
         )
     else:
         read_merger = DoNothingReadMerger()
 
+    coverage_planner = None
+    if dp_memory_budget is not None or dp_time_budget is not None:
+        coverage_planner = CoveragePlanner(dp_memory_budget, dp_time_budget)
+
+    result_cache = ResultCache(cache_dir) if cache_dir is not None else None
+
+    work_directory = None
+    if work_dir is not None:
+        if read_list_filename or gtchange_list_filename or recombination_list_filename:
+            raise CommandLineError(
+                "Option --work-dir cannot be combined with --output-read-list, "
+                "--changed-genotype-list or --recombination-list"
+            )
+        try:
+            work_directory = WorkDirectory(
+                work_dir,
+                run_fingerprint(
+                    "phase",
+                    # The reference, pedigree and genetic map also determine the result
+                    [variant_file]
+                    + phase_input_files
+                    + [path for path in (reference, ped, genmap) if isinstance(path, str)],
+                    parameters,
+                ),
+                timers,
+            )
+        except (OSError, WorkDirectoryError) as e:
+            raise CommandLineError(e)
+
     with ExitStack() as stack:
+        if dp_scratch_dir is not None:
+            set_dp_scratch_directory(dp_scratch_dir)
+            stack.callback(set_dp_scratch_directory, None)
         try:
             vcf_writer = stack.enter_context(
                 PhasedVcfWriter(
@@ -415,6 +506,11 @@ def run_whatshap(
         components: Dict
         for variant_table in timers.iterate("parse_vcf", vcf_reader):
             chromosome = variant_table.chromosome
+            if work_directory is not None:
+                if work_directory.is_finished(chromosome):
+                    work_directory.skip(chromosome, [vcf_writer])
+                    continue
+                work_directory.begin(chromosome, [vcf_writer])
             if (not chromosomes) or (chromosome in chromosomes):
                 logger.info("======== Working on chromosome %r", chromosome)
             else:
@@ -425,10 +521,14 @@ def run_whatshap(
                 with timers("write_vcf"):
                     superreads, components = dict(), dict()
                     vcf_writer.write(chromosome, superreads, components)
+                if work_directory is not None:
+                    work_directory.finish()
                 continue
 
             # These two variables hold the phasing results for all samples
             superreads, components = dict(), dict()
+            # Statistics about the DPs of all families (kept in the work directory)
+            statistics = {"phased_reads": 0, "dp_cost": 0}
 
             # Iterate over all families to process, i.e. a separate DP table is created
             # for each family.
@@ -448,15 +548,19 @@ def run_whatshap(
                 )
 
                 # Get the reads belonging to each sample
-                readsets = dict()  # TODO this could become a list
+                candidate_reads = dict()
+                preselect_coverage = None
+                if preselect is not None:
+                    preselect_coverage = max(1, round(preselect * max_coverage_per_sample))
+                with timers("read_bam"):
+                    family_readsets = phased_input_reader.read_samples(
+                        chromosome,
+                        phasable_variant_table.variants,
+                        family,
+                        preselect_coverage=preselect_coverage,
+                    )
                 for sample in family:
-                    with timers("read_bam"):
-                        readset, vcf_source_ids = phased_input_reader.read(
-                            chromosome, phasable_variant_table.variants, sample
-                        )
-
-                    # TODO: Read selection done w.r.t. all variants, where using heterozygous
-                    #  variants only would probably give better results.
+                    readset, vcf_source_ids = family_readsets.pop(sample)
                     with timers("select"):
                         readset = readset.subset(
                             [i for i, read in enumerate(readset) if len(read) >= 2]
@@ -465,12 +569,34 @@ def run_whatshap(
                             "Kept %d reads that cover at least two variants each", len(readset)
                         )
                         merged_reads = read_merger.merge(readset)
-                        selected_reads = select_reads(
-                            merged_reads,
-                            max_coverage_per_sample,
-                            preferred_source_ids=vcf_source_ids,
+                    candidate_reads[sample] = (readset, merged_reads, vcf_source_ids)
+
+                plan = None
+                if coverage_planner is not None:
+                    with timers("select"):
+                        plan = coverage_planner.plan(
+                            merge_readsets({s: c[1] for s, c in candidate_reads.items()}),
+                            max_coverage,
+                            len(trios),
                         )
 
+                readsets = dict()  # TODO this could become a list
+                for sample in family:
+                    readset, merged_reads, vcf_source_ids = candidate_reads.pop(sample)
+                    # TODO: Read selection done w.r.t. all variants, where using heterozygous
+                    #  variants only would probably give better results.
+                    with timers("select"):
+                        if plan is None:
+                            selected_reads = select_reads(
+                                merged_reads,
+                                max_coverage_per_sample,
+                                preferred_source_ids=vcf_source_ids,
+                            )
+                        else:
+                            selected_reads = select_reads_planned(
+                                merged_reads, plan, len(family), vcf_source_ids
+                            )
+
                     readsets[sample] = selected_reads
                     if len(family) == 1 and not distrust_genotypes:
                         # When having a pedigree (len(family) > 1), blocks are also merged after
@@ -516,6 +642,7 @@ def run_whatshap(
                 recombination_costs = recombination_cost_computer.compute(accessible_positions)
 
                 # Finally, run phasing algorithm
+                phase_time = -timers.elapsed("phase")
                 with timers("phase"):
                     problem_name = "MEC" if len(family) == 1 else "PedMEC"
                     logger.info(
@@ -525,20 +652,73 @@ def run_whatshap(
                         problem_name,
                     )
 
-                    dp_table: Union[HapChatCore, PedigreeDPTable]
-                    if algorithm == "hapchat":
-                        dp_table = HapChatCore(all_reads)
-                    else:
-                        dp_table = PedigreeDPTable(
+                    dp_table: Union[HapChatCore, PedigreeDPTable, CachedResult, None] = None
+                    if (
+                        result_cache is not None
+                        and algorithm == "whatshap"
+                        and len(family) == 1
+                        and accessible_positions
+                    ):
+                        dp_table = phase_segments_cached(
+                            result_cache,
                             all_reads,
+                            accessible_positions,
                             recombination_costs,
-                            pedigree,
+                            lambda start, stop: create_pedigree(
+                                default_gq,
+                                distrust_genotypes,
+                                family,
+                                gl_regularizer,
+                                numeric_sample_ids,
+                                phasable_variant_table,
+                                trios,
+                                slice(start, stop),
+                            ),
+                            family,
                             distrust_genotypes,
+                            transmission_pruning,
+                        )
+                    elif result_cache is not None:
+                        cache_key = problem_key(
+                            all_reads,
+                            pedigree,
+                            family,
                             accessible_positions,
+                            (
+                                algorithm,
+                                distrust_genotypes,
+                                list(recombination_costs),
+                                [(t.father, t.mother, t.child) for t in trios],
+                                transmission_pruning,
+                            ),
                         )
+                        dp_table = result_cache.get(cache_key)
+                        if dp_table is not None:
+                            logger.info("Using cached result")
+                    if dp_table is None:
+                        if algorithm == "hapchat":
+                            dp_table = HapChatCore(all_reads)
+                        else:
+                            dp_table = PedigreeDPTable(
+                                all_reads,
+                                recombination_costs,
+                                pedigree,
+                                distrust_genotypes,
+                                accessible_positions,
+                                streaming=True,
+                                transmission_cost_margin=transmission_pruning,
+                            )
+                        if result_cache is not None:
+                            dp_table = CachedResult.from_dp_table(dp_table)
+                            result_cache.put(cache_key, dp_table)
 
                     superreads_list, transmission_vector = dp_table.get_super_reads()
                     logger.info("%s cost: %d", problem_name, dp_table.get_optimal_cost())
+                    statistics["phased_reads"] += len(all_reads)
+                    statistics["dp_cost"] += dp_table.get_optimal_cost()
+                phase_time += timers.elapsed("phase")
+                if plan is not None:
+                    log_dp_cost(plan, all_reads, accessible_positions, len(trios), phase_time)
 
                 with timers("components"):
                     overall_components = compute_overall_components(
@@ -597,9 +777,21 @@ def run_whatshap(
                 logger.info("Writing list of changed genotypes to %r", gtchange_list_filename)
                 write_changed_genotypes(gtchange_list_filename, changed_genotypes)
 
+            if work_directory is not None:
+                work_directory.finish(statistics)
             logger.debug("Chromosome %r finished", chromosome)
 
-    log_time_and_memory_usage(timers, show_phase_vcfs=show_phase_vcfs)
+        if work_directory is not None:
+            with timers("write_vcf"):
+                logger.info("======== Concatenating chromosomes from work directory")
+                work_directory.concatenate([vcf_writer])
+
+    log_time_and_memory_usage(
+        timers,
+        show_phase_vcfs=show_phase_vcfs,
+        result_cache=result_cache,
+        work_directory=work_directory,
+    )
 
 
 def compute_overall_components(
@@ -612,34 +804,24 @@ def compute_overall_components(
     numeric_sample_ids,
     superreads_list,
 ):
+    component_finder = PositionComponentFinder(accessible_positions)
     master_block = None
-    heterozygous_positions_by_sample = None
     # If we distrusted genotypes, we need to re-determine which sites are homo-/heterozygous after phasing
     if distrust_genotypes:
         hom_in_any_sample = set()
-        heterozygous_positions_by_sample = {}
-        heterozygous_gts = frozenset({(0, 1), (1, 0)})
-        homozygous_gts = frozenset({(0, 0), (1, 1)})
         for sample, sample_superreads in zip(family, superreads_list):
-            hets = set()
-            for v1, v2 in zip(*sample_superreads):
-                assert v1.position == v2.position
-                if v1.position not in accessible_positions:
-                    continue
-                gt = (v1.allele, v2.allele)
-                if gt in heterozygous_gts:
-                    hets.add(v1.position)
-                elif gt in homozygous_gts:
-                    hom_in_any_sample.add(v1.position)
-            heterozygous_positions_by_sample[numeric_sample_ids[sample]] = hets
+            hom_in_any_sample.update(
+                component_finder.restrict_to_superread_heterozygous(
+                    numeric_sample_ids[sample], sample_superreads
+                )
+            )
         if len(family) > 1 and genetic_haplotyping:
             master_block = sorted(hom_in_any_sample)
     else:
         if len(family) > 1 and genetic_haplotyping:
-            master_block = sorted(set(homozygous_positions).intersection(set(accessible_positions)))
-    return find_components(
-        accessible_positions, all_reads, master_block, heterozygous_positions_by_sample
-    )
+            # positions that are not accessible are ignored
+            master_block = sorted(homozygous_positions)
+    return _components_dict(accessible_positions, component_finder, all_reads, master_block)
 
 
 def log_component_stats(components, n_accessible_positions):
@@ -655,6 +837,21 @@ def log_component_stats(components, n_accessible_positions):
     )
 
 
+def log_dp_cost(plan: CoveragePlan, reads, positions, trio_count, phase_time):
+    """
+    Log predicted versus actual size and running time of the DP. The actual size is
+    estimated from the selected reads.
+    """
+    memory, _ = dp_cost(reads, positions, trio_count)
+    logger.info(
+        "DP size predicted: %.1f MB, %.1f s; actual: %.1f MB, %.1f s",
+        plan.memory / 1e6,
+        plan.time,
+        memory / 1e6,
+        phase_time,
+    )
+
+
 def log_best_case_phasing_info(readset, selected_reads):
     (n_best_case_blocks, n_best_case_nonsingleton_blocks) = best_case_blocks(readset)
     (n_best_case_blocks_cov, n_best_case_nonsingleton_blocks_cov) = best_case_blocks(selected_reads)
@@ -742,23 +939,10 @@ def make_recombination_cost_computer(
 
 
 def find_phaseable_variants(family, include_homozygous: bool, trios, variant_table: VariantTable):
-    # variant indices with at least one missing genotype
-    missing_genotypes = set()
-    # variant indices with at least one heterozygous genotype
-    heterozygous = set()
-    # variant indices with at least one homozygous genotype
-    homozygous = set()
     # determine which variants have missing/heterozygous/homozygous genotypes in any sample
-    for sample in family:
-        genotypes = variant_table.genotypes_of(sample)
-        for index, gt in enumerate(genotypes):
-            if gt.is_none():
-                missing_genotypes.add(index)
-            elif not gt.is_homozygous():
-                heterozygous.add(index)
-            else:
-                assert gt.is_diploid_and_biallelic()
-                homozygous.add(index)
+    missing_genotypes, heterozygous, homozygous = classify_genotypes(
+        [variant_table.genotypes_of(sample) for sample in family]
+    )
     # determine which variants have Mendelian conflicts
     # variant indices with at least one Mendelian conflict
     mendelian_conflicts = find_mendelian_conflicts(trios, variant_table)
@@ -775,9 +959,9 @@ def find_phaseable_variants(family, include_homozygous: bool, trios, variant_tab
     # These are used later to merge blocks containing these variants into one block (since
     # the are connected by "genetic haplotyping").
     homozygous_positions = [
-        variant_table.variants[i].position for i in to_retain.intersection(homozygous)
+        variant_table.variants[i].position for i in sorted(to_retain.intersection(homozygous))
     ]
-    phasable_variant_table = deepcopy(variant_table)
+    phasable_variant_table = variant_table.copy()
     # Remove calls to be discarded from variant table
     phasable_variant_table.remove_rows_by_index(to_discard)
     logger.info("Number of variants skipped due to missing genotypes: %d", len(missing_genotypes))
@@ -798,7 +982,7 @@ def find_phaseable_variants(family, include_homozygous: bool, trios, variant_tab
     return homozygous_positions, phasable_variant_table
 
 
-def log_time_and_memory_usage(timers, show_phase_vcfs):
+def log_time_and_memory_usage(timers, show_phase_vcfs, result_cache=None, work_directory=None):
     total_time = timers.total()
     logger.info("\n== SUMMARY ==")
     log_memory_usage()
@@ -813,6 +997,14 @@ def log_time_and_memory_usage(timers, show_phase_vcfs):
     logger.info("Time spent finding components:               %6.1f s", timers.elapsed("components"))
     logger.info("Time spent on rest:                          %6.1f s", total_time - timers.sum())
     logger.info("Total elapsed time:                          %6.1f s", total_time)
+    if result_cache is not None:
+        logger.info("Phasing results found in cache:              %6d", result_cache.hits)
+        logger.info("Phasing results computed (not in cache):     %6d", result_cache.misses)
+    if work_directory is not None:
+        statistics = work_directory.statistics()
+        logger.info("Chromosomes finished in earlier runs:        %6d", work_directory.resumed)
+        logger.info("Reads used for phasing (all chromosomes):    %6d", statistics.get("phased_reads", 0))
+        logger.info("Sum of MEC/PedMEC costs (all chromosomes):   %6d", statistics.get("dp_cost", 0))
     # fmt: on
 
 
@@ -826,6 +1018,62 @@ def merge_readsets(readsets) -> ReadSet:
     return all_reads
 
 
+def phase_segments_cached(
+    result_cache: ResultCache,
+    readset: ReadSet,
+    positions: List[int],
+    recombination_costs,
+    make_pedigree,
+    family: List[str],
+    distrust_genotypes: bool,
+    transmission_pruning: Optional[int],
+) -> CachedResult:
+    """
+    Solve the MEC problem of a single sample separately for each of its independent
+    segments (see independent_segments()). Results of segments found in the cache are
+    re-used, and the others are added to it.
+
+    make_pedigree -- function that returns a Pedigree for a (start, stop) range of positions
+    """
+    segments = independent_segments(readset, positions)
+    segment_starts = [positions[start] for start, _ in segments]
+    read_indices: List[List[int]] = [[] for _ in segments]
+    for i, read in enumerate(readset):
+        read_indices[bisect_right(segment_starts, read[0].position) - 1].append(i)
+
+    results = []
+    cached = 0
+    for (start, stop), indices in zip(segments, read_indices):
+        reads = readset.subset(indices)
+        pedigree = make_pedigree(start, stop)
+        costs = list(recombination_costs[start:stop])
+        key = problem_key(
+            reads,
+            pedigree,
+            family,
+            positions[start:stop],
+            ("whatshap", distrust_genotypes, costs, [], transmission_pruning),
+        )
+        result = result_cache.get(key)
+        if result is None:
+            dp_table = PedigreeDPTable(
+                reads,
+                costs,
+                pedigree,
+                distrust_genotypes,
+                positions[start:stop],
+                streaming=True,
+                transmission_cost_margin=transmission_pruning,
+            )
+            result = CachedResult.from_dp_table(dp_table)
+            result_cache.put(key, result)
+        else:
+            cached += 1
+        results.append(result)
+    logger.info("Using cached results for %d of %d segments", cached, len(segments))
+    return CachedResult.concatenate(results, read_indices, len(readset))
+
+
 def create_pedigree(
     default_gq,
     distrust_genotypes,
@@ -834,30 +1082,25 @@ def create_pedigree(
     numeric_sample_ids,
     phasable_variant_table,
     trios,
+    variants: slice = slice(None),
 ):
+    """
+    Create a Pedigree for the given slice of the variants in the table
+    """
     pedigree = Pedigree(numeric_sample_ids)
     for sample in family:
-        # If distrusting genotypes, we pass genotype likelihoods on to pedigree object
         if distrust_genotypes:
-            genotype_likelihoods = []
-            for gt, gl in zip(
-                phasable_variant_table.genotypes_of(sample),
-                phasable_variant_table.genotype_likelihoods_of(sample),
-            ):
-                assert gt.is_diploid_and_biallelic()
-                if gl is None:
-                    # all genotypes get default_gq as genotype likelihood, exept the called genotype ...
-                    x = [default_gq] * 3
-                    # ... which gets a 0
-                    x[gt.get_index()] = 0
-                    genotype_likelihoods.append(PhredGenotypeLikelihoods(x))
-                else:
-                    genotype_likelihoods.append(gl.as_phred(regularizer=gl_regularizer))
+            # Pass genotype likelihoods on to the pedigree object. Missing likelihoods
+            # are replaced by default_gq for all genotypes except the called one.
+            pedigree.add_individual_with_log10_likelihoods(
+                sample,
+                phasable_variant_table.genotypes_of(sample)[variants],
+                phasable_variant_table.genotype_likelihoods_of(sample)[variants],
+                default_gq,
+                gl_regularizer,
+            )
         else:
-            genotype_likelihoods = None
-        pedigree.add_individual(
-            sample, phasable_variant_table.genotypes_of(sample), genotype_likelihoods
-        )
+            pedigree.add_individual(sample, phasable_variant_table.genotypes_of(sample)[variants])
     for trio in trios:
         pedigree.add_relationship(father_id=trio.father, mother_id=trio.mother, child_id=trio.child)
     return pedigree
@@ -866,16 +1109,13 @@ def create_pedigree(
 def find_mendelian_conflicts(trios, variant_table):
     mendelian_conflicts = set()
     for trio in trios:
-        genotypes_mother = variant_table.genotypes_of(trio.mother)
-        genotypes_father = variant_table.genotypes_of(trio.father)
-        genotypes_child = variant_table.genotypes_of(trio.child)
-
-        for index, (gt_mother, gt_father, gt_child) in enumerate(
-            zip(genotypes_mother, genotypes_father, genotypes_child)
-        ):
-            if (not gt_mother.is_none()) and (not gt_father.is_none()) and (not gt_child.is_none()):
-                if mendelian_conflict(gt_mother, gt_father, gt_child):
-                    mendelian_conflicts.add(index)
+        mendelian_conflicts.update(
+            mendelian_conflict_indices(
+                variant_table.genotypes_of(trio.mother),
+                variant_table.genotypes_of(trio.father),
+                variant_table.genotypes_of(trio.child),
+            )
+        )
     return mendelian_conflicts
 
 
@@ -980,6 +1220,18 @@ def add_arguments(parser):
         help="Write reads that have been used for phasing to FILE.")
     arg("--algorithm", choices=("whatshap", "hapchat"), default="whatshap",
         help="Phasing algorithm to use (default: %(default)s)")
+    arg("--dp-scratch-dir", metavar="DIR", default=None,
+        help="Keep DP table columns of 1 GiB or more in memory-mapped scratch files in DIR "
+        "instead of in RAM. Useful if a few regions with very high coverage would otherwise "
+        "exhaust memory. (default: keep all columns in RAM)")
+    arg("--cache-dir", metavar="DIR", default=None,
+        help="Cache phasing results in DIR. When re-running on partially changed input, "
+        "results are reused for each chromosome and family whose reads, genotypes and "
+        "parameters are unchanged. (default: no cache)")
+    arg("--work-dir", metavar="DIR", default=None,
+        help="Resumable mode: Keep each finished chromosome in DIR and concatenate them into "
+        "the output at the end. When re-running an interrupted run with the same DIR, "
+        "finished chromosomes are skipped. (default: write output directly)")
 
     arg = parser.add_argument_group("Input pre-processing, selection and filtering").add_argument
     arg("--merge-reads", dest="read_merging", default=False, action="store_true",
@@ -991,6 +1243,19 @@ def add_arguments(parser):
         help="Coverage reduction parameter in the internal core phasing algorithm. "
         "Higher values increase runtime *exponentially* while possibly improving phasing "
         "quality marginally. Avoid using this in the normal case! (default: %(default)s)")
+    arg("--dp-memory-budget", metavar="SIZE", type=parse_size, default=None,
+        help="Raise or lower the coverage reduction parameter separately for each connected "
+        "component of reads such that the core phasing algorithm is predicted to use at most "
+        "SIZE memory (such as 2G or 500M) at any time. Use --internal-downsampling to set "
+        "the starting point for --dp-time-budget. (default: fixed coverage)")
+    arg("--dp-time-budget", metavar="SECONDS", type=float, default=None,
+        help="Like --dp-memory-budget, but for the predicted running time in seconds of the "
+        "core phasing algorithm per chromosome and family. (default: fixed coverage)")
+    arg("--preselect", metavar="FACTOR", type=float, default=None,
+        help="Before detecting alleles, skip alignments at variants already spanned by "
+        "FACTOR times the maximum coverage per sample. Alignments connecting adjacent "
+        "variants are preferred. Speeds up allele detection on deep data; 2 to 3 is a "
+        "reasonable choice. (default: detect alleles in all alignments)")
     arg("--mapping-quality", "--mapq", metavar="QUAL",
         default=20, type=int, help="Minimum mapping quality (default: %(default)s)")
     arg("--indels", dest="indels", default=False, action="store_true",
@@ -1027,6 +1292,10 @@ def add_arguments(parser):
         help="The threshold of the ratio between the probabilities that a pair "
         "of reads come from different haplotypes and the same haplotype in the "
         "read merging model (default: %(default)s).")
+    arg("--merge-reads-threads", dest="read_merging_threads", metavar="THREADS",
+        type=int, default=1,
+        help="Number of threads used for scoring pairs of overlapping reads "
+        "(default: %(default)s).")
 
     arg = parser.add_argument_group(
         "Genotyping",
@@ -1072,6 +1341,10 @@ def add_arguments(parser):
     arg("--use-ped-samples", dest="use_ped_samples",
         action="store_true", default=False,
         help="Only work on samples mentioned in the provided PED file.")
+    arg("--transmission-pruning", metavar="MARGIN", type=int, default=None,
+        help="Only pursue transmission vectors whose cost is at most MARGIN above the best one "
+        "at each variant. Makes phasing of larger pedigrees faster, but the result may no longer "
+        "be optimal. Default: consider all transmission vectors.")
 # fmt: on
 
 
@@ -1091,6 +1364,14 @@ def validate(args, parser):
         parser.error("Option --include-homozygous can only be used with --distrust-genotypes.")
     if args.use_ped_samples and not args.ped:
         parser.error("Option --use-ped-samples can only be used when PED file is provided (--ped).")
+    if args.transmission_pruning is not None and not args.ped:
+        parser.error("Option --transmission-pruning can only be used together with --ped")
+    if args.transmission_pruning is not None and args.transmission_pruning < 0:
+        parser.error("Option --transmission-pruning must not be negative")
+    if args.read_merging_threads < 1:
+        parser.error("Option --merge-reads-threads must be at least 1")
+    if args.preselect is not None and args.preselect < 1:
+        parser.error("Option --preselect must be at least 1")
     if args.use_ped_samples and args.samples:
         parser.error("Option --use-ped-samples cannot be used together with --samples")
     if len(args.phase_input_files) == 0 and not args.ped:
@@ -30,6 +30,7 @@ from whatshap.core import (
     compute_polyploid_genotypes,
     scoreReadsetLocal,
 )
+from whatshap.checkpoint import WorkDirectory, WorkDirectoryError, run_fingerprint
 from whatshap.cli import log_memory_usage, PhasedInputReader, CommandLineError
 from whatshap.polyphaseplots import draw_plots
 from whatshap.threading import (
@@ -104,6 +105,7 @@ def run_polyphase(
     ce_refinements=5,
     block_cut_sensitivity=4,
     threads=1,
+    work_dir=None,
 ):
     """
     Run Polyploid Phasing.
@@ -118,7 +120,15 @@ def run_polyphase(
     mapping_quality -- discard reads below this mapping quality
     tag -- How to store phasing info in the VCF, can be 'PS' or 'HP'
     write_command_line_header -- whether to add a ##commandline header to the output VCF
+    work_dir -- directory in which finished chromosomes are kept; when re-running an
+        interrupted run with the same work directory, these are not recomputed
     """
+    # Parameters that influence the result (used to recognize a run in a work directory)
+    parameters = {
+        name: value
+        for name, value in locals().items()
+        if name not in ("phase_input_files", "variant_file", "output", "threads", "work_dir")
+    }
     timers = StageTimer()
     logger.info(
         "This is WhatsHap (polyploid) %s running under Python %s",
@@ -126,6 +136,22 @@ def run_polyphase(
         platform.python_version(),
     )
     numeric_sample_ids = NumericSampleIds()
+
+    work_directory = None
+    if work_dir is not None:
+        try:
+            work_directory = WorkDirectory(
+                work_dir,
+                run_fingerprint(
+                    "polyphase",
+                    [variant_file] + phase_input_files + ([reference] if reference else []),
+                    parameters,
+                ),
+                timers,
+            )
+        except (OSError, WorkDirectoryError) as e:
+            raise CommandLineError(e)
+
     with ExitStack() as stack:
         assert phase_input_files
         phased_input_reader = stack.enter_context(
@@ -215,6 +241,12 @@ def run_polyphase(
             for variant_table in vcf_reader:
                 chromosome = variant_table.chromosome
                 timers.stop("parse_vcf")
+                if work_directory is not None:
+                    if work_directory.is_finished(chromosome):
+                        work_directory.skip(chromosome, [vcf_writer])
+                        timers.start("parse_vcf")
+                        continue
+                    work_directory.begin(chromosome, [vcf_writer])
                 if (not chromosomes) or (chromosome in chromosomes):
                     logger.info("======== Working on chromosome %r", chromosome)
                 else:
@@ -225,10 +257,15 @@ def run_polyphase(
                     with timers("write_vcf"):
                         superreads, components = dict(), dict()
                         vcf_writer.write(chromosome, superreads, components)
+                    if work_directory is not None:
+                        work_directory.finish()
+                    timers.start("parse_vcf")
                     continue
 
                 # These two variables hold the phasing results for all samples
                 superreads, components, haploid_components = dict(), dict(), dict()
+                # Statistics kept in the work directory
+                statistics = {"phased_reads": 0}
 
                 # Iterate over all samples to process
                 for sample in samples:
@@ -316,6 +353,8 @@ def run_polyphase(
                     )
                     logger.info("Kept %d reads that cover at least two variants each", len(readset))
 
+                    statistics["phased_reads"] += len(readset)
+
                     # Adapt the variant table to the subset of reads
                     phasable_variant_table.subset_rows_by_position(readset.get_positions())
 
@@ -344,9 +383,15 @@ def run_polyphase(
                     # TODO: Use genotype information to polish results
                     # assert len(changed_genotypes) == 0
                     logger.info("Done writing VCF")
+                if work_directory is not None:
+                    work_directory.finish(statistics)
                 logger.debug("Chromosome %r finished", chromosome)
                 timers.start("parse_vcf")
             timers.stop("parse_vcf")
+            if work_directory is not None:
+                with timers("write_vcf"):
+                    logger.info("======== Concatenating chromosomes from work directory")
+                    work_directory.concatenate([vcf_writer])
         except PloidyError as e:
             raise CommandLineError(e)
 
@@ -395,6 +440,12 @@ def run_polyphase(
         "Time spent on rest:                          %6.1f s", timers.total() - timers.sum()
     )
     logger.info("Total elapsed time:                          %6.1f s", timers.total())
+    if work_directory is not None:
+        logger.info("Chromosomes finished in earlier runs:        %6d", work_directory.resumed)
+        logger.info(
+            "Reads used for phasing (all chromosomes):    %6d",
+            work_directory.statistics().get("phased_reads", 0),
+        )
 
 
 def phase_single_individual(readset, phasable_variant_table, sample, phasing_param, output, timers):
@@ -1030,6 +1081,14 @@ def add_arguments(parser):
         help="Reference file. Provide this to detect alleles through re-alignment. "
         "If no index (.fai) exists, it will be created",
     )
+    arg(
+        "--work-dir",
+        metavar="DIR",
+        default=None,
+        help="Resumable mode: Keep each finished chromosome in DIR and concatenate them into "
+        "the output at the end. When re-running an interrupted run with the same DIR, "
+        "finished chromosomes are skipped. (default: write output directly)",
+    )
     arg(
         "--tag",
         choices=("PS", "HP"),
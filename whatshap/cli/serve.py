@@ -0,0 +1,62 @@
+"""
+Run a local server that executes phase, genotype and haplotag jobs
+
+The server listens on a Unix socket. Jobs are submitted with 'whatshap submit'
+(or the faster 'python -m whatshap.service') and run in worker processes that
+keep all modules imported and recently used reference sequences in memory.
+Output that a job writes to standard output and standard error is streamed
+back to the submitting client.
+"""
+import logging
+
+from whatshap.cli import CommandLineError
+from whatshap.service import serve, ServiceError
+from whatshap.utils import enable_reference_cache
+
+logger = logging.getLogger(__name__)
+
+COMMANDS = ("phase", "genotype", "haplotag")
+
+
+# fmt: off
+def add_arguments(parser):
+    add = parser.add_argument
+    add("socket", metavar="SOCKET", help="Path of the Unix socket to listen on")
+    add("--workers", "-j", metavar="N", type=int, default=1,
+        help="Number of jobs that can run in parallel (default: %(default)s)")
+# fmt: on
+
+
+def validate(args, parser):
+    if args.workers < 1:
+        parser.error("Number of workers must be at least 1")
+
+
+class JobRunner:
+    """Parse and run the command line of a job within a worker process"""
+
+    def __init__(self):
+        # Importing here avoids a circular import
+        from whatshap.__main__ import get_argument_parser, run_subcommand
+
+        self._parser = get_argument_parser()
+        self._run_subcommand = run_subcommand
+
+    def __call__(self, argv) -> int:
+        args = self._parser.parse_args(argv)
+        command = getattr(args, "module", None)
+        command_name = command.__name__.rsplit(".", 1)[-1] if command else None
+        if command_name not in COMMANDS:
+            logger.error("The server only runs these commands: %s", ", ".join(COMMANDS))
+            return 2
+        logging.getLogger().setLevel(logging.DEBUG if args.debug else logging.INFO)
+        self._run_subcommand(args)
+        return 0
+
+
+def main(args):
+    job_runner = JobRunner()
+    try:
+        serve(args.socket, args.workers, job_runner, initialize=enable_reference_cache)
+    except (OSError, ServiceError) as e:
+        raise CommandLineError(e)
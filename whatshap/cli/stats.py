@@ -2,12 +2,18 @@
 Print phasing statistics of a single VCF file
 """
 import logging
-from collections import defaultdict
+import itertools
 from contextlib import ExitStack
+from functools import partial
+from multiprocessing import Pool
+from typing import Dict, List, Optional, Tuple
 import dataclasses
 
+from pysam import VariantFile
+
 from ..math import median
-from ..vcf import VcfReader
+from ..utils import warn_once
+from ..vcf import VcfReader, VcfNotSortedError, MixedPhasingError
 
 logger = logging.getLogger(__name__)
 
@@ -28,6 +34,9 @@ def add_arguments(parser):
     add("--chromosome", dest="chromosomes", metavar="CHROMOSOME", default=[], action="append",
         help="Name of chromosome to process. If not given, all chromosomes in the "
         "input VCF are considered. Can be used multiple times")
+    add("--threads", "-t", metavar="THREADS", type=int, default=1,
+        help="Number of chromosomes to process in parallel. Requires an indexed "
+        "VCF/BCF; otherwise, the file is streamed on a single thread (default: %(default)s).")
     add("vcf", metavar="VCF", help="Phased VCF file")
 # fmt: on
 
@@ -36,45 +45,42 @@ def validate(args, parser):
     pass
 
 
-class PhasedBlock:
-    def __init__(self, chromosome=None):
-        self.phases = {}
-        self.leftmost_variant = None
-        self.rightmost_variant = None
-        self.chromosome = chromosome
+class BlockSummary:
+    """
+    Compact summary of a phased block. Only the extent of the block and the number of
+    variants in it are kept, not the variants themselves.
+    """
 
-    def add(self, variant, phase):
-        if len(self.phases) == 0:
-            self.leftmost_variant = variant
-            self.rightmost_variant = variant
-        else:
-            if variant < self.leftmost_variant:
-                self.leftmost_variant = variant
-            if self.rightmost_variant < variant:
-                self.rightmost_variant = variant
-        self.phases[variant] = phase
+    __slots__ = ("chromosome", "block_id", "start", "end", "variants", "snvs")
+
+    def __init__(self, chromosome: str, block_id, position: int, is_snv: bool):
+        self.chromosome = chromosome
+        self.block_id = block_id
+        self.start = position
+        self.end = position
+        self.variants = 1
+        self.snvs = int(is_snv)
+
+    def add(self, position: int, is_snv: bool):
+        # Variants are added in ascending position order
+        self.end = position
+        self.variants += 1
+        self.snvs += int(is_snv)
 
     def span(self):
         """Returns the length of the covered genomic region in bp."""
-        return self.rightmost_variant.position - self.leftmost_variant.position
-
-    def variants(self):
-        return list(sorted(self.phases.keys()))
-
-    def count_snvs(self):
-        return sum(int(variant.is_snv()) for variant in self.phases)
+        return self.end - self.start
 
     def __repr__(self):
-        return "PhasedBlock({})".format(str(self.phases))
+        return "BlockSummary({!r}, {!r}, start={}, end={}, variants={}, snvs={})".format(
+            self.chromosome, self.block_id, self.start, self.end, self.variants, self.snvs
+        )
 
     def __len__(self):
-        return len(self.phases)
+        return self.variants
 
     def __lt__(self, other):
-        return (self.leftmost_variant, self.rightmost_variant) < (
-            other.leftmost_variant,
-            other.rightmost_variant,
-        )
+        return (self.start, self.end) < (other.start, other.end)
 
 
 class GtfWriter:
@@ -125,6 +131,10 @@ class DetailedStats:
 
 
 def compute_n50(blocks, chr_lengths):
+    """
+    Compute the block N50 from a list of BlockSummary objects, which may come from
+    several chromosomes.
+    """
     chromosomes = set(b.chromosome for b in blocks)
     target_length = 0
     for chromosome in sorted(chromosomes):
@@ -137,19 +147,17 @@ def compute_n50(blocks, chr_lengths):
             return float("nan")
 
     # Cut interleaved blocks to avoid inflating N50 in this case
-    pos_sorted = sorted(blocks, key=lambda b: (b.chromosome, b.leftmost_variant.position))
+    pos_sorted = sorted(blocks, key=lambda b: (b.chromosome, b.start))
     block_lengths = []
     for i, block in enumerate(pos_sorted):
         if len(block) < 2:
             continue
-        start, end = block.leftmost_variant.position, block.rightmost_variant.position
+        start, end = block.start, block.end
         if i + 1 < len(pos_sorted):
             next_block = pos_sorted[i + 1]
-            if (end > next_block.leftmost_variant.position) and (
-                block.chromosome == next_block.chromosome
-            ):
-                # logger.warning('Blocks are interleaved, cutting first block: end=%s --> %s',  end, next_block.leftmost_variant.position)
-                end = next_block.leftmost_variant.position
+            if (end > next_block.start) and (block.chromosome == next_block.chromosome):
+                # logger.warning('Blocks are interleaved, cutting first block: end=%s --> %s',  end, next_block.start)
+                end = next_block.start
         block_lengths.append(end - start)
     block_lengths.sort(reverse=True)
     s = 0
@@ -200,7 +208,7 @@ class PhasingStats:
         n_singletons = sum(1 for size in block_sizes if size == 1)
         block_sizes = [size for size in block_sizes if size > 1]
         block_lengths = sorted(block.span() for block in self.blocks if len(block) > 1)
-        phased_snvs = sum(block.count_snvs() for block in self.blocks if len(block) > 1)
+        phased_snvs = sum(block.snvs for block in self.blocks if len(block) > 1)
         if block_sizes:
             return DetailedStats(
                 variants=self.variants,
@@ -299,6 +307,135 @@ def parse_chr_lengths(filename):
     return chr_lengths
 
 
+@dataclasses.dataclass
+class ChromosomeStats:
+    chromosome: str
+    records: int  # number of VCF records seen, including skipped ones
+    stats: PhasingStats
+    gtf_fragments: List[Tuple[int, int, int]]  # (start, stop, block_id), start is 0-based
+    phase_detected: Optional[str]  # "HP" or "GT_PS"
+
+
+def chromosome_stats(chromosome, records, sample, only_snvs=False, gtf=False) -> ChromosomeStats:
+    """
+    Stream the VCF records of a single chromosome and summarize the phasing of
+    the given sample. Only a BlockSummary per phased block is kept in memory.
+
+    The same records as in VcfReader are considered: multi-ALT sites and
+    duplicated positions are skipped.
+    """
+    stats = PhasingStats()
+    blocks: Dict[int, BlockSummary] = {}
+    gtf_fragments = []
+    fragment = None
+    phase_detected = None
+    prev_position = None
+    n_records = 0
+    for record in records:
+        n_records += 1
+        if not record.alts or len(record.alts) > 1:
+            continue
+        pos, ref, alt = record.start, str(record.ref), str(record.alts[0])
+        if only_snvs and not (len(ref) == len(alt) == 1):
+            continue
+        if (prev_position is not None) and (prev_position > pos):
+            raise VcfNotSortedError(
+                "VCF not ordered: {}:{} appears before {}:{}".format(
+                    chromosome, prev_position + 1, chromosome, pos + 1
+                )
+            )
+        if prev_position == pos:
+            warn_once(
+                logger, "Skipping duplicated position %s on chromosome %r", pos + 1, chromosome
+            )
+            continue
+        prev_position = pos
+
+        stats.add_variants(1)
+        call = record.samples[sample]
+        gt = call["GT"]
+        if gt and None not in gt and all(allele == gt[0] for allele in gt):
+            # homozygous
+            continue
+        is_snv = (ref != alt) and (len(ref) == len(alt) == 1)
+        stats.add_heterozygous_variants(1)
+        if is_snv:
+            stats.add_heterozygous_snvs(1)
+
+        phase = None
+        for extract_phase, phase_name in [
+            (VcfReader._extract_HP_phase, "HP"),
+            (VcfReader._extract_GT_PS_phase, "GT_PS"),
+        ]:
+            p = extract_phase(call)
+            if p is not None:
+                if phase_detected is None:
+                    phase_detected = phase_name
+                elif phase_detected != phase_name:
+                    raise MixedPhasingError(
+                        "Mixed phasing information in input VCF (e.g. mixing PS and HP fields)"
+                    )
+                phase = p
+        if phase is None:
+            stats.add_unphased()
+            continue
+
+        block_id = phase.block_id
+        if block_id in blocks:
+            blocks[block_id].add(pos, is_snv)
+        else:
+            blocks[block_id] = BlockSummary(chromosome, block_id, pos, is_snv)
+        if gtf:
+            if fragment is not None and fragment[2] == block_id:
+                fragment[1] = pos + 1
+            else:
+                if fragment is not None:
+                    gtf_fragments.append(tuple(fragment))
+                fragment = [pos, pos + 1, block_id]
+
+    if fragment is not None:
+        gtf_fragments.append(tuple(fragment))
+    stats.add_blocks(blocks.values())
+    return ChromosomeStats(chromosome, n_records, stats, gtf_fragments, phase_detected)
+
+
+def _fetch_chromosome_stats(chromosome, path, sample, only_snvs, gtf) -> ChromosomeStats:
+    """Worker function: Fetch a single chromosome from an indexed VCF and summarize it"""
+    with VariantFile(path) as variant_file:
+        variant_file.subset_samples([sample])
+        return chromosome_stats(
+            chromosome, variant_file.fetch(chromosome), sample, only_snvs=only_snvs, gtf=gtf
+        )
+
+
+def iter_chromosome_stats(path, sample, only_snvs=False, chromosomes=None, threads=1, gtf=False):
+    """
+    Yield a ChromosomeStats object for each chromosome in the VCF, in file order.
+
+    If the VCF is indexed and threads > 1, chromosomes are processed in parallel
+    worker processes. Otherwise, the file is streamed once from start to end.
+    """
+    with VariantFile(path) as variant_file:
+        if threads > 1 and variant_file.index is not None:
+            names = [c for c in variant_file.index if not chromosomes or c in chromosomes]
+            worker = partial(
+                _fetch_chromosome_stats, path=path, sample=sample, only_snvs=only_snvs, gtf=gtf
+            )
+            with Pool(processes=threads) as pool:
+                for chromosome_stats_ in pool.imap(worker, names):
+                    if chromosome_stats_.records > 0:
+                        yield chromosome_stats_
+            return
+
+        if threads > 1:
+            logger.warning("VCF is not indexed, processing it on a single thread")
+        variant_file.subset_samples([sample])
+        for chromosome, records in itertools.groupby(variant_file, lambda record: record.chrom):
+            if chromosomes and chromosome not in chromosomes:
+                continue
+            yield chromosome_stats(chromosome, records, sample, only_snvs=only_snvs, gtf=gtf)
+
+
 def run_stats(
     vcf,
     sample=None,
@@ -308,6 +445,7 @@ def run_stats(
     only_snvs=False,
     chromosomes=None,
     chr_lengths=None,
+    threads=1,
 ):
     gtfwriter = tsv_file = block_list_file = None
     with ExitStack() as stack:
@@ -325,20 +463,21 @@ def run_stats(
         else:
             chr_lengths = None
 
-        vcf_reader = VcfReader(vcf, phases=True, indels=not only_snvs)
-        if len(vcf_reader.samples) == 0:
+        with VariantFile(vcf) as variant_file:
+            samples = list(variant_file.header.samples)
+        if len(samples) == 0:
             logger.error("Input VCF does not contain any sample")
             return 1
         else:
-            logger.info("Found {} sample(s) in input VCF".format(len(vcf_reader.samples)))
+            logger.info("Found {} sample(s) in input VCF".format(len(samples)))
         if sample:
-            if sample in vcf_reader.samples:
+            if sample in samples:
                 sample = sample
             else:
                 logger.error("Requested sample ({}) not found".format(sample))
                 return 1
         else:
-            sample = vcf_reader.samples[0]
+            sample = samples[0]
             logger.info("Reporting results for sample {}".format(sample))
 
         if tsv_file:
@@ -360,76 +499,44 @@ def run_stats(
         print("Phasing statistics for sample {} from file {}".format(sample, vcf))
         total_stats = PhasingStats()
         chromosome_count = 0
-        given_chromosomes = chromosomes
-        for variant_table in vcf_reader:
-            if given_chromosomes:
-                if variant_table.chromosome not in given_chromosomes:
-                    continue
+        phase_detected = None
+        for chromosome_stats_ in iter_chromosome_stats(
+            vcf,
+            sample,
+            only_snvs=only_snvs,
+            chromosomes=chromosomes,
+            threads=threads,
+            gtf=gtfwriter is not None,
+        ):
             chromosome_count += 1
-            chromosome = variant_table.chromosome
-            stats = PhasingStats()
+            chromosome = chromosome_stats_.chromosome
+            stats = chromosome_stats_.stats
+            if chromosome_stats_.phase_detected is not None:
+                if phase_detected is None:
+                    phase_detected = chromosome_stats_.phase_detected
+                elif phase_detected != chromosome_stats_.phase_detected:
+                    raise MixedPhasingError(
+                        "Mixed phasing information in input VCF (e.g. mixing PS and HP fields)"
+                    )
             print("---------------- Chromosome {} ----------------".format(chromosome))
-            genotypes = variant_table.genotypes_of(sample)
-            phases = variant_table.phases_of(sample)
-            assert len(genotypes) == len(phases) == len(variant_table.variants)
-            blocks = defaultdict(PhasedBlock)
-            prev_block_id = None
-            prev_block_fragment_start = None
-            prev_block_fragment_end = None
-            for variant, genotype, phase in zip(variant_table.variants, genotypes, phases):
-                stats.add_variants(1)
-                if genotype.is_homozygous():
-                    continue
-                stats.add_heterozygous_variants(1)
-                if variant.is_snv():
-                    stats.add_heterozygous_snvs(1)
-                if phase is None:
-                    stats.add_unphased()
-                else:
-                    # a phased variant
-                    blocks[phase.block_id].add(variant, phase)
-                    if gtfwriter:
-                        if prev_block_id is None:
-                            prev_block_fragment_start = variant.position
-                            prev_block_fragment_end = variant.position + 1
-                            prev_block_id = phase.block_id
-                        else:
-                            if prev_block_id != phase.block_id:
-                                gtfwriter.write(
-                                    chromosome,
-                                    prev_block_fragment_start,
-                                    prev_block_fragment_end,
-                                    prev_block_id,
-                                )
-                                prev_block_fragment_start = variant.position
-                                prev_block_id = phase.block_id
-                            prev_block_fragment_end = variant.position + 1
-
-            # Add chromosome information to each block. This is needed to
-            # sort blocks later when we compute N50s
-            for block_id, block in blocks.items():
-                block.chromosome = chromosome
-
-            if gtfwriter and prev_block_id is not None:
-                gtfwriter.write(
-                    chromosome, prev_block_fragment_start, prev_block_fragment_end, prev_block_id
-                )
+
+            if gtfwriter:
+                for start, stop, block_id in chromosome_stats_.gtf_fragments:
+                    gtfwriter.write(chromosome, start, stop, block_id)
 
             if block_list_file:
-                block_ids = sorted(blocks.keys())
-                for block_id in block_ids:
+                for block in sorted(stats.blocks, key=lambda b: b.block_id):
                     print(
                         sample,
                         chromosome,
-                        block_id,
-                        blocks[block_id].leftmost_variant.position + 1,
-                        blocks[block_id].rightmost_variant.position + 1,
-                        len(blocks[block_id]),
+                        block.block_id,
+                        block.start + 1,
+                        block.end + 1,
+                        len(block),
                         sep="\t",
                         file=block_list_file,
                     )
 
-            stats.add_blocks(blocks.values())
             stats.print(chr_lengths)
             if tsv_file:
                 print(sample, chromosome, vcf, sep="\t", end="\t", file=tsv_file)
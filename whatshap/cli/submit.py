@@ -0,0 +1,39 @@
+"""
+Submit a job to a server started with 'whatshap serve'
+
+Output of the job is written to standard output and standard error, and the exit
+status of the job becomes the exit status of this command. Example:
+
+    whatshap submit whatshap.sock phase -o phased.vcf --reference ref.fasta input.vcf input.bam
+
+Relative paths are interpreted relative to the current working directory. To avoid
+the start-up time of this command, run 'python -m whatshap.service' with the same
+arguments instead.
+"""
+import sys
+from argparse import REMAINDER
+
+from whatshap.cli import CommandLineError
+from whatshap.service import submit
+
+
+# fmt: off
+def add_arguments(parser):
+    add = parser.add_argument
+    add("socket", metavar="SOCKET", help="Path of the Unix socket the server listens on")
+    add("command", nargs=REMAINDER, metavar="COMMAND",
+        help="WhatsHap command line to run (without the initial 'whatshap')")
+# fmt: on
+
+
+def validate(args, parser):
+    if not args.command:
+        parser.error("Please provide a command to run")
+
+
+def main(args):
+    try:
+        status = submit(args.socket, args.command)
+    except OSError as e:
+        raise CommandLineError("Cannot submit job to {!r}: {}".format(args.socket, e))
+    sys.exit(status)
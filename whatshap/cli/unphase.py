@@ -13,7 +13,8 @@ It is not an error if no phasing information was found.
 """
 import sys
 import logging
-from pysam import VariantFile
+
+from whatshap.vcf import VcfRewriter, unphase_call
 
 
 logger = logging.getLogger(__name__)
@@ -23,6 +24,14 @@ TAGS_TO_REMOVE = frozenset(("HP", "PQ", "PS"))
 
 def add_arguments(parser):
     add = parser.add_argument
+    add(
+        "--threads",
+        "-t",
+        metavar="THREADS",
+        type=int,
+        default=1,
+        help="Number of threads for BGZF decompression and compression (default: %(default)s).",
+    )
     add("vcf", metavar="VCF", help='VCF file. Use "-" to read from standard input')
 
 
@@ -37,32 +46,25 @@ def unphase_header(header):
             header.formats.remove_header(tag)
 
 
-def run_unphase(vcf_path, outfile):
+def unphase_records(records):
+    """Remove phasing information from a list of VariantRecord objects"""
+    for record in records:
+        for tag in TAGS_TO_REMOVE:
+            if tag in record.format:
+                del record.format[tag]
+        for call in record.samples.values():
+            unphase_call(call)
+
+
+def run_unphase(vcf_path, outfile, threads=1):
     """
     Read a VCF file, remove phasing information, and write the result to
     outfile, which must be a file-like object.
     """
-    if vcf_path == "-":
-        reader = VariantFile(sys.stdin)
-    else:
-        reader = VariantFile(vcf_path)
-
-    unphase_header(reader.header)
-    with VariantFile(outfile, mode="w", header=reader.header) as writer:
-        for record in reader:
-            for tag in TAGS_TO_REMOVE:
-                if tag in record.format:
-                    del record.format[tag]
-            for call in record.samples.values():
-                if (
-                    call["GT"] is not None
-                    and call["GT"][0] is not None
-                    and call["GT"][1] is not None
-                ):
-                    call["GT"] = sorted(call["GT"])
-                call.phased = False
-            writer.write(record)
+    with VcfRewriter(sys.stdin if vcf_path == "-" else vcf_path, outfile, threads) as rewriter:
+        unphase_header(rewriter.header)
+        rewriter.rewrite(unphase_records)
 
 
 def main(args):
-    run_unphase(args.vcf, sys.stdout)
+    run_unphase(args.vcf, sys.stdout, args.threads)
@@ -19,6 +19,14 @@ cdef class ReadSet:
 	cdef cpp.ReadSet *thisptr
 
 
+cdef class ComponentFinder:
+	cdef cpp.ComponentFinder *thisptr
+
+
+cdef class GeneticMap:
+	cdef cpp.GeneticMap *thisptr
+
+
 cdef class Pedigree:
 	cdef cpp.Pedigree *thisptr
 	cdef NumericSampleIds numeric_sample_ids
@@ -52,6 +52,28 @@ class ReadSet:
     def subset(self, reads_to_select: Iterable[int]) -> ReadSet: ...
     def get_positions(self) -> List[int]: ...
 
+class ComponentFinder:
+    def __init__(self, positions: Iterable[int]): ...
+    def __len__(self) -> int: ...
+    def merge(self, x: int, y: int) -> None: ...
+    def find(self, x: int) -> int: ...
+    def restrict_to_heterozygous(self, sample_id: int, positions: Iterable[int]) -> None: ...
+    def restrict_to_superread_heterozygous(
+        self, sample_id: int, superreads: ReadSet
+    ) -> List[int]: ...
+    def add_reads(self, reads: ReadSet) -> None: ...
+    def merge_block(self, positions: Iterable[int]) -> None: ...
+    def components(self) -> List[int]: ...
+
+def merge_reads(
+    readset: ReadSet,
+    error_rate: float,
+    max_error_rate: float,
+    positive_threshold: float,
+    negative_threshold: float,
+    threads: int = ...,
+) -> ReadSet: ...
+
 class PedigreeDPTable:
     def __init__(
         self,
@@ -90,6 +112,7 @@ class PhredGenotypeLikelihoods:
     def __eq__(self, other) -> bool: ...
     def genotypes(self) -> List[Genotype]: ...
 
+def set_dp_scratch_directory(directory: Optional[str], threshold: int = ...) -> None: ...
 def binomial_coefficient(n: int, k: int) -> int: ...
 
 class Genotype:
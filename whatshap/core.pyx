@@ -11,11 +11,14 @@ Wrappers for core C++ classes.
 from libcpp cimport bool
 from libcpp.string cimport string
 from libcpp.vector cimport vector
+from libcpp.pair cimport pair
+from libcpp.algorithm cimport lower_bound, sort
 from libc.stdint cimport uint32_t, uint64_t
+from libc.limits cimport UINT_MAX
 from . cimport cpp
 
 from collections import namedtuple
-from cython.operator cimport dereference as deref
+from cython.operator cimport dereference as deref, preincrement as inc
 
 
 # A single variant on a read.
@@ -304,18 +307,258 @@ cdef class ReadSet:
 		return result
 
 
+cdef class ComponentFinder:
+	"""
+	Find connected components of variant positions (phased blocks). Initially, each
+	position is in a separate set. By calling merge(x, y), the two sets containing
+	positions x and y are merged. Calling find(x) returns the smallest position of the
+	set that x is in.
+
+	This is implemented in C++ using union-find over dense position indices.
+	"""
+	def __cinit__(self, positions):
+		cdef vector[unsigned int] c_positions = positions
+		self.thisptr = new cpp.ComponentFinder(c_positions)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	def __len__(self):
+		return self.thisptr.size()
+
+	def merge(self, unsigned int x, unsigned int y):
+		self.thisptr.merge(x, y)
+
+	def find(self, unsigned int x):
+		return self.thisptr.find(x)
+
+	def restrict_to_heterozygous(self, int sample_id, positions):
+		"""
+		Restrict merging by reads of the given sample to the given positions. Once called,
+		reads of samples without such a restriction are no longer used by add_reads().
+		"""
+		cdef vector[unsigned int] c_positions = positions
+		self.thisptr.restrictToHeterozygous(sample_id, c_positions)
+
+	def restrict_to_superread_heterozygous(self, int sample_id, ReadSet superreads):
+		"""
+		Same as restrict_to_heterozygous, but take the heterozygous positions from the
+		given pair of super reads. Return a list of positions at which the super reads
+		are homozygous.
+		"""
+		cdef vector[unsigned int] homozygous
+		self.thisptr.restrictToHeterozygous(sample_id, superreads.thisptr[0], &homozygous)
+		return list(homozygous)
+
+	def add_reads(self, ReadSet reads):
+		"""Merge all positions covered by the same read"""
+		self.thisptr.addReads(reads.thisptr[0])
+
+	def merge_block(self, positions):
+		"""Merge all given positions into one component. Unknown positions are ignored."""
+		cdef vector[unsigned int] c_positions = positions
+		self.thisptr.mergeBlock(c_positions)
+
+	def components(self):
+		"""
+		Return a list that contains, for each position in ascending order, the position
+		of the leftmost variant in its component.
+		"""
+		return list(self.thisptr.getComponents())
+
+
+cdef class GeneticMap:
+	"""
+	Genetic map of a chromosome, given as sorted positions and the cumulative genetic
+	distance (in cM) at each of them
+	"""
+	def __cinit__(self, positions, cumulative_distances):
+		self.thisptr = new cpp.GeneticMap(positions, cumulative_distances)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	def __len__(self):
+		return self.thisptr.size()
+
+	def cumulative_distances(self, positions):
+		"""Return the interpolated cumulative genetic distance at each of the (sorted) positions"""
+		return self.thisptr.cumulative_distances(positions)
+
+	def recombination_costs(self, positions):
+		"""
+		Return a list with the phred-scaled recombination probability between each of the
+		(sorted) positions and the previous one. The first entry is 0.
+		"""
+		return self.thisptr.recombination_costs(positions)
+
+
+def centimorgen_to_phred(double distance):
+	"""Convert a genetic distance (in cM) into a phred-scaled recombination probability"""
+	return cpp.centimorgen_to_phred(distance)
+
+
+def uniform_recombination_costs(double recombination_rate, positions):
+	"""
+	For a list of positions and a constant recombination rate (in cM/Mb), return a list
+	with the phred-scaled recombination probability between each position and the
+	previous one. The first entry is 0.
+	"""
+	return cpp.uniform_recombination_costs(recombination_rate, positions)
+
+
+def merge_reads(ReadSet readset, double error_rate, double max_error_rate, double positive_threshold, double negative_threshold, unsigned int threads=1):
+	"""
+	Merge reads that likely come from the same haplotype into super reads and return
+	the resulting ReadSet. See whatshap.merge.ReadMerger for the meaning of the parameters.
+	threads -- number of threads used for scoring pairs of overlapping reads
+	"""
+	cdef cpp.ReadMerger* merger = new cpp.ReadMerger(error_rate, max_error_rate, positive_threshold, negative_threshold, threads)
+	cdef cpp.ReadSet* merged
+	try:
+		merged = merger.merge(readset.thisptr[0])
+	finally:
+		del merger
+	result = ReadSet()
+	del result.thisptr
+	result.thisptr = merged
+	return result
+
+
+
+def phased_blocks_as_reads(str name_prefix, variants, genotypes, phases, input_variants, int source_id, int sample_id, int default_quality, int mapq):
+	"""
+	Return a ReadSet with one read per phased block of a sample, encoding the phase
+	information as if the block was a single sequencing read. See
+	whatshap.vcf.VariantTable.phased_blocks_as_reads.
+
+	variants -- VcfVariant objects
+	genotypes -- Genotype of the sample for each variant
+	phases -- VariantCallPhase (or None if unphased) of the sample for each variant
+	input_variants -- VcfVariant objects of interest; other variants are ignored
+	"""
+	cdef Genotype genotype
+	cdef vector[unsigned int] positions
+	cdef vector[long] block_ids
+	cdef vector[int] alleles
+	cdef vector[int] qualities
+	cdef string _name_prefix = name_prefix.encode('UTF-8')
+	cdef cpp.ReadSet* reads
+	# (position, index) of the input variants, sorted. Looking up positions in it avoids
+	# calling VcfVariant.__hash__ and __eq__ for every variant.
+	cdef vector[pair[uint32_t, size_t]] input_index
+	cdef vector[pair[uint32_t, size_t]].iterator it
+	cdef uint32_t position
+	if not len(variants) == len(genotypes) == len(phases):
+		raise ValueError("Expected one genotype and one phase per variant")
+	input_variants = list(input_variants)
+	for j in range(len(input_variants)):
+		input_index.push_back(pair[uint32_t, size_t](input_variants[j].position, j))
+	sort(input_index.begin(), input_index.end())
+	for i in range(len(variants)):
+		phase = phases[i]
+		if phase is None:
+			continue
+		genotype = genotypes[i]
+		# only use heterozygous diploid variants
+		if genotype.thisptr.get_ploidy() > 2 or genotype.thisptr.is_homozygous():
+			continue
+		variant = variants[i]
+		position = variant.position
+		it = lower_bound(input_index.begin(), input_index.end(), pair[uint32_t, size_t](position, 0))
+		while it != input_index.end() and deref(it).first == position:
+			other = input_variants[deref(it).second]
+			if variant.reference_allele == other.reference_allele and variant.alternative_allele == other.alternative_allele:
+				break
+			inc(it)
+		else:
+			continue
+		positions.push_back(position)
+		block_ids.push_back(phase.block_id)
+		alleles.push_back(phase.phase[0])
+		qualities.push_back(default_quality if phase.quality is None else phase.quality)
+	with nogil:
+		reads = cpp.phased_blocks_as_reads(_name_prefix, positions, block_ids, alleles, qualities, source_id, sample_id, mapq)
+	result = ReadSet()
+	del result.thisptr
+	result.thisptr = reads
+	return result
+
+
+def build_reads(names, const int[:] mapqs, const int[:] source_ids, const int[:] sample_ids, const int[:] reference_starts, BX_tags, const long[:] variant_offsets, const int[:] positions, const int[:] alleles, const int[:] qualities):
+	"""
+	Return a ReadSet built from flat arrays in a single call. This is much faster than
+	creating Read objects and calling add_variant for every allele.
+
+	Read i has name names[i], mapping quality mapqs[i] (and so on) and the variants with
+	indices variant_offsets[i] to variant_offsets[i+1]-1 in positions, alleles and qualities.
+	The numeric arrays can be array.array objects of type 'i' (and 'l' for variant_offsets).
+
+	Reads with identical name, source id and sample id (the two ends of a paired-end read)
+	are merged as by whatshap.variants.merge_reads. A RuntimeError is raised if a name
+	occurs more than twice.
+	"""
+	cdef vector[string] _names
+	cdef vector[string] _BX_tags
+	cdef vector[size_t] _variant_offsets
+	cdef cpp.ReadSet* reads
+	for name in names:
+		_names.push_back(name.encode('UTF-8'))
+	for BX_tag in BX_tags:
+		_BX_tags.push_back(BX_tag.encode('UTF-8'))
+	for i in range(len(variant_offsets)):
+		_variant_offsets.push_back(variant_offsets[i])
+	cdef vector[int] _mapqs = _int_vector(mapqs)
+	cdef vector[int] _source_ids = _int_vector(source_ids)
+	cdef vector[int] _sample_ids = _int_vector(sample_ids)
+	cdef vector[int] _reference_starts = _int_vector(reference_starts)
+	cdef vector[int] _positions = _int_vector(positions)
+	cdef vector[int] _alleles = _int_vector(alleles)
+	cdef vector[int] _qualities = _int_vector(qualities)
+	with nogil:
+		reads = cpp.build_reads(_names, _mapqs, _source_ids, _sample_ids, _reference_starts, _BX_tags, _variant_offsets, _positions, _alleles, _qualities)
+	result = ReadSet()
+	del result.thisptr
+	result.thisptr = reads
+	return result
+
+
+cdef vector[int] _int_vector(const int[:] values):
+	cdef vector[int] result
+	cdef Py_ssize_t i
+	result.reserve(values.shape[0])
+	for i in range(values.shape[0]):
+		result.push_back(values[i])
+	return result
+
+
 cdef class PedigreeDPTable:
-	def __cinit__(self, ReadSet readset, recombcost, Pedigree pedigree, bool distrust_genotypes = False, positions = None):
+	def __cinit__(self, ReadSet readset, recombcost, Pedigree pedigree, bool distrust_genotypes = False, positions = None, bool streaming = False, transmission_cost_margin = None):
 		"""Build the DP table from the given read set which is assumed to be sorted;
 		that is, the variants in each read must be sorted by position and the reads
 		in the read set must also be sorted (by position of their left-most variant).
+
+		If streaming is True, the optimal path is determined (and the DP tables freed)
+		up to each column that is not spanned by any read as soon as that column has been
+		computed, so that memory depends on the longest read-connected region instead of
+		on the number of columns. The result is the same, and it is only available once
+		the constructor returns.
+
+		If transmission_cost_margin is given, only transmission vectors whose cost is
+		within this margin of the best one in a column are pursued further. This speeds
+		up phasing of large pedigrees, but may give a suboptimal result.
 		"""
+		cdef unsigned int c_margin = UINT_MAX
+		if transmission_cost_margin is not None:
+			if transmission_cost_margin < 0:
+				raise ValueError("transmission_cost_margin must not be negative")
+			c_margin = min(transmission_cost_margin, UINT_MAX)
 		cdef vector[unsigned int]* c_positions = NULL
 		if positions is not None:
 			c_positions = new vector[unsigned int]()
 			for pos in positions:
 				c_positions.push_back(pos)
-		self.thisptr = new cpp.PedigreeDPTable(readset.thisptr, recombcost, pedigree.thisptr, distrust_genotypes, c_positions)
+		self.thisptr = new cpp.PedigreeDPTable(readset.thisptr, recombcost, pedigree.thisptr, distrust_genotypes, c_positions, streaming, c_margin)
 		self.pedigree = pedigree
 
 	def __dealloc__(self):
@@ -383,6 +626,34 @@ cdef class Pedigree:
 				gl_vector.push_back(NULL)
 		self.thisptr.addIndividual(self.numeric_sample_ids[id], gt_vector, gl_vector)
 
+	def add_individual_with_log10_likelihoods(self, id, genotypes, genotype_likelihoods, double default_gq, regularizer=None):
+		"""
+		Add an individual with diploid, biallelic genotypes and genotype likelihoods given as
+		vcf.GenotypeLikelihoods objects (log10-scaled) or None. The conversion to phred scale
+		is done in C++ and gives the same result as GenotypeLikelihoods.as_phred(). Where the
+		likelihoods are None, all genotypes except the given one get a likelihood of default_gq.
+		"""
+		cdef vector[cpp.Genotype] gt_vector
+		cdef vector[double] gl_vector
+		cdef double nan = float("nan")
+		if len(genotypes) != len(genotype_likelihoods):
+			raise ValueError("Expected as many genotype likelihoods as genotypes")
+		gt_vector.reserve(len(genotypes))
+		gl_vector.reserve(3 * len(genotypes))
+		for gt, gl in zip(genotypes, genotype_likelihoods):
+			gt_vector.push_back((<Genotype?>gt).thisptr[0])
+			if gl is None:
+				gl_vector.push_back(nan)
+				gl_vector.push_back(nan)
+				gl_vector.push_back(nan)
+			else:
+				log_probs = gl.log_prob_genotypes
+				if len(log_probs) != 3:
+					raise ValueError("Expected three genotype likelihoods per variant")
+				for log_prob in log_probs:
+					gl_vector.push_back(log_prob)
+		self.thisptr.addIndividual(self.numeric_sample_ids[id], gt_vector, gl_vector, default_gq, -1.0 if regularizer is None else regularizer)
+
 	def add_relationship(self, father_id, mother_id, child_id):
 		self.thisptr.addRelationship(self.numeric_sample_ids[father_id], self.numeric_sample_ids[mother_id], self.numeric_sample_ids[child_id])
 
@@ -409,6 +680,51 @@ cdef class Pedigree:
 		return self.thisptr.toString().decode('utf-8')
 
 
+def mendelian_conflict_indices(genotypes_mother, genotypes_father, genotypes_child):
+	"""
+	Return a list of the indices at which the diploid genotypes of a child are not consistent
+	with Mendelian inheritance from its parents. Indices at which any of the three genotypes
+	is missing are not reported. A child genotype that is not diploid is a conflict.
+	"""
+	cdef Genotype gt_mother, gt_father, gt_child
+	if not len(genotypes_mother) == len(genotypes_father) == len(genotypes_child):
+		raise ValueError("Expected the same number of genotypes for mother, father and child")
+	conflicts = []
+	for i in range(len(genotypes_child)):
+		gt_mother = genotypes_mother[i]
+		gt_father = genotypes_father[i]
+		gt_child = genotypes_child[i]
+		if gt_mother.thisptr.is_none() or gt_father.thisptr.is_none() or gt_child.thisptr.is_none():
+			continue
+		if cpp.mendelian_conflict(gt_mother.thisptr[0], gt_father.thisptr[0], gt_child.thisptr[0]):
+			conflicts.append(i)
+	return conflicts
+
+
+def classify_genotypes(genotype_lists):
+	"""
+	Given one list of genotypes per sample (all of the same length), return three sets
+	with the indices at which at least one sample has a missing genotype, a heterozygous
+	genotype and a homozygous genotype, respectively. Homozygous genotypes must be
+	diploid and biallelic.
+	"""
+	cdef Genotype gt
+	missing = set()
+	heterozygous = set()
+	homozygous = set()
+	for genotypes in genotype_lists:
+		for i in range(len(genotypes)):
+			gt = genotypes[i]
+			if gt.thisptr.is_none():
+				missing.add(i)
+			elif not gt.thisptr.is_homozygous():
+				heterozygous.add(i)
+			else:
+				assert gt.thisptr.is_diploid_and_biallelic()
+				homozygous.add(i)
+	return missing, heterozygous, homozygous
+
+
 cdef class PhredGenotypeLikelihoods:
 	def __cinit__(self, vector[double] gl, unsigned int ploidy=2, unsigned int nr_alleles=2):
 		self.thisptr = new cpp.PhredGenotypeLikelihoods(gl, ploidy, nr_alleles)
@@ -447,6 +763,15 @@ cdef class PhredGenotypeLikelihoods:
 		return result
 	
 	
+def set_dp_scratch_directory(directory, size_t threshold=2**30):
+	"""
+	Store DP table columns of at least threshold bytes in memory-mapped scratch files
+	in the given directory instead of in RAM. Pass None to disable.
+	"""
+	cdef string c_directory = b'' if directory is None else str(directory).encode('UTF-8')
+	cpp.set_scratch_directory(c_directory, threshold)
+
+
 def binomial_coefficient(int n, int k):
 	return cpp.binomial_coefficient(n, k)
 
@@ -517,17 +842,25 @@ def get_max_genotype_alleles():
 
 
 cdef class GenotypeDPTable:
-	def __cinit__(self, numeric_sample_ids, ReadSet readset, recombcost, Pedigree pedigree, positions = None):
+	def __cinit__(self, numeric_sample_ids, ReadSet readset, recombcost, Pedigree pedigree, positions = None, double epsilon = 0.0):
 		"""Build the DP table from the given read set which is assumed to be sorted;
 		that is, the variants in each read must be sorted by position and the reads
 		in the read set must also be sorted (by position of their left-most variant).
+
+		If epsilon is positive, states whose scaled forward or backward probability
+		is below epsilon times that of the most likely state of their column are
+		dropped, which makes genotyping at high coverage much faster at the expense
+		of exactness. The largest fraction of probability mass dropped from a column
+		is returned by get_max_discarded_fraction().
 		"""
+		if epsilon < 0:
+			raise ValueError("epsilon must not be negative")
 		cdef vector[unsigned int]* c_positions = NULL
 		if positions is not None:
 			c_positions = new vector[unsigned int]()
 			for pos in positions:
 				c_positions.push_back(pos)
-		self.thisptr = new cpp.GenotypeDPTable(readset.thisptr, recombcost, pedigree.thisptr, c_positions)
+		self.thisptr = new cpp.GenotypeDPTable(readset.thisptr, recombcost, pedigree.thisptr, c_positions, epsilon)
 		self.pedigree = pedigree
 		self.numeric_sample_ids = numeric_sample_ids
 
@@ -537,6 +870,10 @@ cdef class GenotypeDPTable:
 	def get_genotype_likelihoods(self, sample_id, unsigned int pos):
 		return PhredGenotypeLikelihoods(self.thisptr.get_genotype_likelihoods(self.numeric_sample_ids[sample_id],pos))
 
+	def get_max_discarded_fraction(self):
+		"""Largest fraction of probability mass dropped from a single projection column"""
+		return self.thisptr.get_max_discarded_fraction()
+
 
 def compute_genotypes(ReadSet readset, positions = None):
 	cdef vector[cpp.Genotype]* genotypes_vector = new vector[cpp.Genotype]()
@@ -59,10 +59,50 @@ cdef extern from "../src/readset.h":
 		vector[unsigned int]* get_positions()
 
 
+cdef extern from "../src/componentfinder.h":
+	cdef cppclass ComponentFinder:
+		ComponentFinder(vector[unsigned int]) except +
+		size_t size()
+		void merge(unsigned int, unsigned int) except +
+		unsigned int find(unsigned int) except +
+		void restrictToHeterozygous(int, vector[unsigned int]) except +
+		void restrictToHeterozygous(int, ReadSet, vector[unsigned int]*) except +
+		void addReads(ReadSet) except +
+		void mergeBlock(vector[unsigned int]) except +
+		vector[unsigned int] getComponents() except +
+
+
+cdef extern from "../src/geneticmap.h":
+	cdef cppclass GeneticMap:
+		GeneticMap(vector[unsigned int], vector[double]) except +
+		size_t size()
+		vector[double] cumulative_distances(vector[unsigned int]) except +
+		vector[unsigned int] recombination_costs(vector[unsigned int]) except +
+	double centimorgen_to_phred(double) except +
+	vector[unsigned int] uniform_recombination_costs(double, vector[unsigned int]) except +
+
+
+cdef extern from "../src/phasedblocks.h":
+	ReadSet* phased_blocks_as_reads(string, vector[unsigned int], vector[long], vector[int], vector[int], int, int, int) except + nogil
+
+
+cdef extern from "../src/readbuilder.h":
+	ReadSet* build_reads(vector[string], vector[int], vector[int], vector[int], vector[int], vector[string], vector[size_t], vector[int], vector[int], vector[int]) except + nogil
+
+
+cdef extern from "../src/readmerger.h":
+	cdef cppclass ReadMerger:
+		ReadMerger(double, double, double, double, unsigned int) except +
+		ReadSet* merge(ReadSet) except +
+		int getPositiveDifferenceThreshold()
+		int getNegativeDifferenceThreshold()
+
+
 cdef extern from "../src/pedigree.h":
 	cdef cppclass Pedigree:
 		Pedigree() except +
 		void addIndividual(unsigned int id, vector[Genotype*] genotypes, vector[PhredGenotypeLikelihoods*]) except +
+		void addIndividual(unsigned int id, vector[Genotype] genotypes, vector[double] log10_likelihoods, double default_gq, double regularizer) except +
 		void addRelationship(unsigned int f, unsigned int m, unsigned int c) except +
 		unsigned int size()
 		string toString() except +
@@ -70,16 +110,21 @@ cdef extern from "../src/pedigree.h":
 		const PhredGenotypeLikelihoods* get_genotype_likelihoods_by_id(unsigned int, unsigned int) except +
 		unsigned int get_variant_count() except +
 		unsigned int triple_count() except +
+	bool mendelian_conflict(Genotype, Genotype, Genotype) except +
 
 
 cdef extern from "../src/pedigreedptable.h":
 	cdef cppclass PedigreeDPTable:
-		PedigreeDPTable(ReadSet*, vector[unsigned int], Pedigree* pedigree, bool distrust_genotypes, vector[unsigned int]* positions) except +
+		PedigreeDPTable(ReadSet*, vector[unsigned int], Pedigree* pedigree, bool distrust_genotypes, vector[unsigned int]* positions, bool streaming, unsigned int transmission_cost_margin) except +
 		void get_super_reads(vector[ReadSet*]*, vector[unsigned int]* transmission_vector) except +
 		int get_optimal_score() except +
 		vector[bool]* get_optimal_partitioning()
 		
 		
+cdef extern from "../src/scratchmemory.h":
+	void set_scratch_directory(string directory, size_t threshold) except +
+
+
 cdef extern from "../src/binomial.h":
 	cdef int binomial_coefficient(int n, int k) except +
 		
@@ -106,8 +151,9 @@ cdef extern from "../src/genotype.h":
 
 cdef extern from "../src/genotypedptable.h":
 	cdef cppclass GenotypeDPTable:
-		GenotypeDPTable(ReadSet*, vector[unsigned int], Pedigree* pedigree, vector[unsigned int]* positions) except +
+		GenotypeDPTable(ReadSet*, vector[unsigned int], Pedigree* pedigree, vector[unsigned int]* positions, long double epsilon) except +
 		vector[long double] get_genotype_likelihoods(unsigned int individual, unsigned int position) except +
+		long double get_max_discarded_fraction() except +
 
 cdef extern from "../src/phredgenotypelikelihoods.h":
 	cdef cppclass PhredGenotypeLikelihoods:
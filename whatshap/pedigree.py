@@ -3,12 +3,13 @@ Pedigree-related functions
 """
 from abc import ABC, abstractmethod
 
-import math
 from typing import Optional
 from collections import Counter, OrderedDict, defaultdict
 from dataclasses import dataclass
 import logging
 
+from whatshap.core import GeneticMap, centimorgen_to_phred, uniform_recombination_costs
+
 logger = logging.getLogger(__name__)
 
 
@@ -33,85 +34,15 @@ class RecombinationEvent:
     recombination_cost: float
 
 
-def _interpolate(point, start_pos, end_pos, start_value, end_value):
-    assert start_pos <= point <= end_pos
-    if start_pos == point == end_pos:
-        assert start_value == end_value
-        return start_value
-    return start_value + ((point - start_pos) * (end_value - start_value) / (end_pos - start_pos))
-
-
-MINIMUM_GENETIC_DISTANCE = 1e-10  # cM
-
-
 def recombination_cost_map(genetic_map, positions):
-
+    """
+    Return the phred-scaled recombination costs between consecutive (sorted) positions
+    for a genetic map given as a list of RecombinationMapEntry objects.
+    """
     assert len(genetic_map) > 0
-
-    # Step 1: compute cumulative genetic distances from start of chromosome
-    #         to each position.
-    cumulative_distances = []
-    # i and j are such that genetic_map[i].position <= position <= genetic_map[j].position
-    # i and j are None if no such values exist (because we are at the end of the list)
-    i = None
-    j = 0
-
-    for position in positions:
-        # update i to meet the invariant
-        if (i is None) and (genetic_map[0].position <= position):
-            i = 0
-        while (
-            (i is not None)
-            and (i + 1 < len(genetic_map))
-            and (genetic_map[i + 1].position <= position)
-        ):
-            i += 1
-
-        # update j to meet the invariant
-        while (j is not None) and (genetic_map[j].position < position):
-            if j + 1 < len(genetic_map):
-                j += 1
-            else:
-                j = None
-
-        # interpolate
-        if i is None:
-            assert j is not None
-            d = _interpolate(position, 0, genetic_map[j].position, 0, genetic_map[j].cum_distance)
-        elif j is None:
-            # Point outside the genetic map --> extrapolating using average recombination rate
-            avg_rate = genetic_map[-1].cum_distance / genetic_map[-1].position
-            d = genetic_map[-1].cum_distance + (position - genetic_map[-1].position) * avg_rate
-        else:
-            assert genetic_map[i].position <= position <= genetic_map[j].position
-            d = _interpolate(
-                position,
-                genetic_map[i].position,
-                genetic_map[j].position,
-                genetic_map[i].cum_distance,
-                genetic_map[j].cum_distance,
-            )
-        cumulative_distances.append(d)
-
-    # Step 2: compute costs (= phred-scaled recombination probabilities between two positions)
-    result = [0]
-    for i in range(1, len(cumulative_distances)):
-        d = cumulative_distances[i] - cumulative_distances[i - 1]
-        d = max(d, MINIMUM_GENETIC_DISTANCE)
-        result.append(round(centimorgen_to_phred(d)))
-
-    return result
-
-
-def centimorgen_to_phred(distance):
-    assert distance >= 0
-    if distance == 0:
-        raise ValueError("Cannot convert genetic distance of zero to phred.")
-    elif distance < 1e-10:
-        return -10 * (math.log10(distance) - 2)
-    else:
-        p = (1.0 - math.exp(-(2.0 * distance) / 100)) / 2.0
-        return -10 * math.log10(p)
+    return GeneticMap(
+        [entry.position for entry in genetic_map], [entry.cum_distance for entry in genetic_map]
+    ).recombination_costs(positions)
 
 
 def mendelian_conflict(genotypem, genotypef, genotypec):
@@ -171,7 +102,15 @@ class RecombinationCostComputer(ABC):
 
 class GeneticMapRecombinationCostComputer(RecombinationCostComputer):
     def __init__(self, genetic_map_path):
-        self._genetic_map = self.load_genetic_map(genetic_map_path)
+        genetic_map = self.load_genetic_map(genetic_map_path)
+        # Parsed once and kept as native arrays for all families and chromosomes
+        try:
+            self._genetic_map = GeneticMap(
+                [entry.position for entry in genetic_map],
+                [entry.cum_distance for entry in genetic_map],
+            )
+        except ValueError as e:
+            raise ParseError("Invalid genetic map file '{}': {}".format(genetic_map_path, e))
 
     @staticmethod
     def load_genetic_map(filename):
@@ -213,7 +152,7 @@ class GeneticMapRecombinationCostComputer(RecombinationCostComputer):
         return genetic_map
 
     def compute(self, positions):
-        return recombination_cost_map(self._genetic_map, positions)
+        return self._genetic_map.recombination_costs(positions)
 
 
 class UniformRecombinationCostComputer(RecombinationCostComputer):
@@ -228,10 +167,7 @@ class UniformRecombinationCostComputer(RecombinationCostComputer):
         results[i] is the phred-scaled recombination probability between
         positions[i-1] and positions[i].
         """
-        return [0] + [
-            round(centimorgen_to_phred((positions[i] - positions[i - 1]) * 1e-6 * recombrate))
-            for i in range(1, len(positions))
-        ]
+        return uniform_recombination_costs(recombrate, positions)
 
     def compute(self, positions):
         return self.uniform_recombination_map(self._recombination_rate, positions)
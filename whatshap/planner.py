@@ -0,0 +1,360 @@
+"""
+Choose the read-selection coverage of each read-connected component such that
+the (Ped)MEC dynamic program fits into a memory and time budget.
+
+A DP column that is covered by k reads has 2^k rows, one per bipartition of the
+reads, and each row is computed once per transmission vector (4^t for t trios).
+The running time of PedigreeDPTable is roughly proportional to the number of these
+entries. Columns that are not kept during the forward pass are computed a second
+time during the backtrace. Since components do not share any columns, the total
+time is the sum of the per-component times.
+
+Memory is dominated by the projection columns, which have one row per bipartition
+of the reads that a column shares with the next one. PedigreeDPTable only keeps
+every sqrt(n)-th of them (n columns) during the forward pass. During the backtrace,
+it additionally recomputes the columns from the last kept column onwards. As the
+tables of a component are freed before the next component is computed, the peak
+memory is that of the largest component, and the memory budget applies to each
+component separately.
+"""
+import heapq
+import logging
+import math
+import re
+from collections import defaultdict
+from typing import Dict, List, Optional, Tuple
+
+from whatshap.core import ComponentFinder, ReadSet
+
+logger = logging.getLogger(__name__)
+
+# Approximate number of DP entries processed per second by PedigreeDPTable
+DP_ENTRIES_PER_SECOND = 5_000_000
+
+# Approximate number of bytes kept per projection column entry (index backtrace,
+# transmission backtrace and projection column, each with four bytes per entry)
+DP_BYTES_PER_ENTRY = 12
+
+# Largest total coverage the planner ever assigns to a component
+MAX_PLANNED_COVERAGE = 23
+
+
+def parse_size(s: str) -> int:
+    """
+    Parse a memory size such as "512M" or "4G" (binary units) and return it in bytes
+    """
+    match = re.fullmatch(r"\s*(\d+(?:\.\d+)?)\s*([KMGT]?)i?B?\s*", s, flags=re.IGNORECASE)
+    if not match:
+        raise ValueError(f"Cannot parse memory size {s!r}")
+    number, unit = match.groups()
+    return int(float(number) * 1024 ** " KMGT".index(unit.upper() or " "))
+
+
+def column_coverages(readset: ReadSet, positions: List[int]) -> List[int]:
+    """
+    Return the number of reads spanning each of the given (sorted) positions.
+    Every variant of the reads must be among the positions.
+    """
+    index = {position: i for i, position in enumerate(positions)}
+    delta = [0] * (len(positions) + 1)
+    for read in readset:
+        delta[index[read[0].position]] += 1
+        delta[index[read[len(read) - 1].position] + 1] -= 1
+    coverages = []
+    coverage = 0
+    for d in delta[:-1]:
+        coverage += d
+        coverages.append(coverage)
+    return coverages
+
+
+def shared_read_counts(readset: ReadSet, positions: List[int]) -> List[int]:
+    """
+    Return the number of reads spanning both each of the given (sorted) positions and the
+    next one (zero for the last position).
+    Every variant of the reads must be among the positions.
+    """
+    index = {position: i for i, position in enumerate(positions)}
+    delta = [0] * (len(positions) + 1)
+    for read in readset:
+        delta[index[read[0].position]] += 1
+        delta[index[read[len(read) - 1].position]] -= 1
+    counts = []
+    count = 0
+    for d in delta[:-1]:
+        count += d
+        counts.append(count)
+    return counts
+
+
+def dp_entries(coverages, trio_count: int = 0) -> int:
+    """Number of DP entries for columns with the given coverages"""
+    return sum(2 ** c for c in coverages) * 4 ** trio_count
+
+
+def checkpoint_stride(column_count: int) -> int:
+    """Distance between the columns that PedigreeDPTable keeps during its forward pass"""
+    # As in the C++ code (math.isqrt would need Python 3.8)
+    return max(1, int(math.sqrt(column_count)))
+
+
+class ComponentCost:
+    """
+    DP cost of a read-connected component as a function of its coverage.
+
+    Limiting the coverage to c is assumed to cap the coverage of each column at c, and
+    thereby also the number of reads it shares with the next column.
+    """
+
+    def __init__(
+        self,
+        coverages: List[int],
+        kept: Optional[List[bool]] = None,
+        shared: Optional[List[int]] = None,
+    ):
+        """
+        coverages -- coverage of each column of the component, from left to right
+        kept -- whether PedigreeDPTable keeps each column during its forward pass
+            (default: all columns are kept)
+        shared -- number of reads each column shares with the next one (default: as many
+            as possible)
+        """
+        self.coverages = coverages
+        self.kept = kept if kept is not None else [True] * len(coverages)
+        if shared is None:
+            shared = [min(c, d) for c, d in zip(coverages, coverages[1:])] + [0]
+        self.shared = shared
+        self.max_coverage = max(coverages)
+
+    def entries(self, coverage: int) -> int:
+        """Number of DP entries computed, including those of recomputed columns"""
+        return sum(
+            2 ** min(c, coverage) * (1 if kept else 2) for c, kept in zip(self.coverages, self.kept)
+        )
+
+    def peak_entries(self, coverage: int) -> int:
+        """
+        Largest number of projection column entries stored at the same time: Those of the
+        kept columns and those of the longest run of columns recomputed during the backtrace
+        """
+        kept_entries = 0
+        run = 0
+        longest_run = 0
+        # The last column shares no reads with a next one
+        for i in range(len(self.coverages) - 1):
+            size = 2 ** min(self.shared[i], coverage)
+            if self.kept[i]:
+                kept_entries += size
+                run = 0
+            else:
+                run += size
+                longest_run = max(longest_run, run)
+        return kept_entries + longest_run
+
+
+def component_costs(
+    readset: ReadSet, positions: List[int]
+) -> Tuple[ComponentFinder, Dict[int, ComponentCost]]:
+    """
+    Find the read-connected components of a readset and return them together with a dict
+    that maps each component (its leftmost position) to its ComponentCost.
+    positions must be sorted and contain all variants of the reads.
+    """
+    component_finder = ComponentFinder(positions)
+    component_finder.add_reads(readset)
+    stride = checkpoint_stride(len(positions))
+    coverages_by_component = defaultdict(list)
+    kept_by_component = defaultdict(list)
+    shared_by_component = defaultdict(list)
+    for column, (component, coverage, shared) in enumerate(
+        zip(
+            component_finder.components(),
+            column_coverages(readset, positions),
+            shared_read_counts(readset, positions),
+        )
+    ):
+        kept = kept_by_component[component]
+        # The first column of a component is kept in addition to every stride-th column
+        kept.append(not kept or column % stride == 0)
+        coverages_by_component[component].append(coverage)
+        shared_by_component[component].append(shared)
+    costs = {
+        component: ComponentCost(
+            coverages, kept_by_component[component], shared_by_component[component]
+        )
+        for component, coverages in coverages_by_component.items()
+    }
+    return component_finder, costs
+
+
+def predicted_cost(
+    costs: Dict[int, ComponentCost], coverages: Dict[int, int], trio_count: int = 0
+) -> Tuple[int, float]:
+    """
+    Return predicted peak memory (in bytes) and running time (in seconds) of the DP when
+    each component is limited to the given coverage
+    """
+    transmission_vectors = 4 ** trio_count
+    peak = max((cost.peak_entries(coverages[c]) for c, cost in costs.items()), default=0)
+    entries = sum(cost.entries(coverages[c]) for c, cost in costs.items())
+    return (
+        peak * transmission_vectors * DP_BYTES_PER_ENTRY,
+        entries * transmission_vectors / DP_ENTRIES_PER_SECOND,
+    )
+
+
+def dp_cost(readset: ReadSet, positions: List[int], trio_count: int = 0) -> Tuple[int, float]:
+    """Predicted peak memory and running time of the DP for the given reads (see above)"""
+    _, costs = component_costs(readset, positions)
+    return predicted_cost(costs, {c: cost.max_coverage for c, cost in costs.items()}, trio_count)
+
+
+class CoveragePlan:
+    """Coverage targets for the read-connected components of a set of reads"""
+
+    def __init__(
+        self,
+        component_finder: ComponentFinder,
+        coverages: Dict[int, int],
+        memory: int,
+        time: float,
+    ):
+        self.component_finder = component_finder
+        # maps each component (its leftmost position) to its total coverage target
+        self.coverages = coverages
+        # predicted peak memory (in bytes) and running time (in seconds) of the DP
+        self.memory = memory
+        self.time = time
+
+    def group_reads(self, readset: ReadSet) -> Dict[int, List[int]]:
+        """Return a dict that maps each coverage target to the indices of the reads it applies to"""
+        groups = defaultdict(list)
+        for i, read in enumerate(readset):
+            component = self.component_finder.find(read[0].position)
+            groups[self.coverages[component]].append(i)
+        return groups
+
+
+class CoveragePlanner:
+    """
+    Raise or lower the read-selection coverage of each read-connected component
+    to fill a memory and/or time budget for the DP.
+    """
+
+    def __init__(
+        self,
+        memory_budget: Optional[int] = None,
+        time_budget: Optional[float] = None,
+        min_coverage: int = 2,
+        max_coverage: int = MAX_PLANNED_COVERAGE,
+    ):
+        """
+        memory_budget -- maximum DP memory in bytes
+        time_budget -- maximum DP running time in seconds
+        min_coverage -- coverage targets are never lowered below this
+        max_coverage -- coverage targets are never raised above this
+        """
+        assert memory_budget is not None or time_budget is not None
+        self.memory_budget = memory_budget
+        self.time_budget = time_budget
+        self.min_coverage = min_coverage
+        self.max_coverage = max_coverage
+
+    def plan(self, readset: ReadSet, default_coverage: int, trio_count: int = 0) -> CoveragePlan:
+        """
+        Assign a total coverage target to each read-connected component of the readset,
+        starting from default_coverage.
+
+        Return a CoveragePlan.
+        """
+        positions = sorted(readset.get_positions())
+        component_finder, costs = component_costs(readset, positions)
+        transmission_vectors = 4 ** trio_count
+
+        # Highest coverage of each component; a target above the actual coverage of a
+        # component would have no effect
+        limits = dict()
+        for component, cost in costs.items():
+            limit = max(min(cost.max_coverage, self.max_coverage), self.min_coverage)
+            if self.memory_budget is not None:
+                peak_budget = self.memory_budget // (DP_BYTES_PER_ENTRY * transmission_vectors)
+                while limit > self.min_coverage and cost.peak_entries(limit) > peak_budget:
+                    limit -= 1
+                if cost.peak_entries(limit) > peak_budget:
+                    logger.warning(
+                        "DP memory is predicted to exceed the budget even at a coverage of %dX",
+                        self.min_coverage,
+                    )
+            limits[component] = limit
+
+        if self.time_budget is None:
+            # Only memory is limited, and it is not shared between components
+            targets = limits
+        else:
+            start = max(self.min_coverage, min(default_coverage, self.max_coverage))
+            targets = {component: min(start, limit) for component, limit in limits.items()}
+            targets = self._fit_time_budget(costs, targets, limits, trio_count)
+
+        memory, time = predicted_cost(costs, targets, trio_count)
+        logger.info(
+            "Planned coverage for %d components (%d-%dX); predicted DP size %.1f MB, time %.1f s",
+            len(targets),
+            min(targets.values(), default=self.min_coverage),
+            max(targets.values(), default=self.min_coverage),
+            memory / 1e6,
+            time,
+        )
+        return CoveragePlan(component_finder, targets, memory, time)
+
+    def _fit_time_budget(
+        self,
+        costs: Dict[int, ComponentCost],
+        targets: Dict[int, int],
+        limits: Dict[int, int],
+        trio_count: int,
+    ) -> Dict[int, int]:
+        """
+        Lower and raise the coverage targets such that the total running time fits into
+        the time budget. Targets are never raised above the limits.
+        """
+        budget = int(self.time_budget * DP_ENTRIES_PER_SECOND) // 4 ** trio_count
+        targets = dict(targets)
+        total = sum(cost.entries(targets[component]) for component, cost in costs.items())
+
+        # Lower coverage where that saves most until the DP fits into the budget
+        heap = [
+            (cost.entries(targets[component] - 1) - cost.entries(targets[component]), component)
+            for component, cost in costs.items()
+            if targets[component] > self.min_coverage
+        ]
+        heapq.heapify(heap)
+        while total > budget and heap:
+            negative_saving, component = heapq.heappop(heap)
+            total += negative_saving
+            targets[component] -= 1
+            c = targets[component]
+            if c > self.min_coverage:
+                cost = costs[component]
+                heapq.heappush(heap, (cost.entries(c - 1) - cost.entries(c), component))
+        if total > budget:
+            logger.warning(
+                "DP time is predicted to exceed the budget even at a coverage of %dX",
+                self.min_coverage,
+            )
+
+        # Raise coverage where that is cheapest while the budget allows it
+        heap = [
+            (cost.entries(targets[component] + 1) - cost.entries(targets[component]), component)
+            for component, cost in costs.items()
+            if targets[component] < limits[component]
+        ]
+        heapq.heapify(heap)
+        while heap and total + heap[0][0] <= budget:
+            extra, component = heapq.heappop(heap)
+            total += extra
+            targets[component] += 1
+            c = targets[component]
+            cost = costs[component]
+            if c < limits[component]:
+                heapq.heappush(heap, (cost.entries(c + 1) - cost.entries(c), component))
+        return targets
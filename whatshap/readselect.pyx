@@ -5,7 +5,6 @@ import logging
 from collections import defaultdict
 
 from .coverage import CovMonitor
-from .graph import ComponentFinder
 from .priorityqueue import PriorityQueue
 
 from libcpp.unordered_set cimport unordered_set
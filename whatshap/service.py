@@ -0,0 +1,312 @@
+"""
+Local job server and client communicating over a Unix socket
+
+A server started with 'whatshap serve' forks a fixed number of worker processes
+that accept connections on a shared socket. Each worker has already imported all
+modules and keeps reference sequences in memory between jobs, so a job skips
+most of the start-up work of a separate 'whatshap' invocation.
+
+Protocol: The client sends a single line with a JSON object
+
+    {"argv": ["phase", "-o", "out.vcf", ...], "cwd": "/current/working/directory"}
+
+and the server responds with a sequence of frames. Each frame consists of a
+one-byte type, the payload length as a four-byte big-endian integer and the
+payload. Type O is data written to standard output by the job, type E is data
+written to standard error and type X ends the response; its payload is the exit
+status of the job as a decimal number.
+
+Only the standard library is used here so that the client (python -m whatshap.service)
+starts quickly.
+"""
+import json
+import logging
+import os
+import signal
+import socket
+import stat
+import struct
+import sys
+import threading
+import time
+import traceback
+from typing import Callable, List
+
+logger = logging.getLogger(__name__)
+
+STDOUT = b"O"
+STDERR = b"E"
+EXIT = b"X"
+
+_HEADER = struct.Struct(">cI")
+
+# Exit status of a worker whose initialization failed
+_INITIALIZE_FAILED = 3
+
+# Give up after this many workers in a row failed to initialize. Before each restart,
+# the server waits twice as long as before, starting with INITIALIZE_RETRY_DELAY seconds.
+MAX_INITIALIZE_FAILURES = 5
+INITIALIZE_RETRY_DELAY = 1.0
+
+
+class ServiceError(Exception):
+    pass
+
+
+def _send_frame(conn, kind: bytes, data: bytes) -> None:
+    conn.sendall(_HEADER.pack(kind, len(data)) + data)
+
+
+class _FrameSender:
+    """Send frames from several threads, ignoring a client that has gone away"""
+
+    def __init__(self, conn):
+        self._conn = conn
+        self._lock = threading.Lock()
+        self.connected = True
+
+    def send(self, kind: bytes, data: bytes) -> None:
+        with self._lock:
+            if not self.connected:
+                return
+            try:
+                _send_frame(self._conn, kind, data)
+            except OSError:
+                self.connected = False
+
+
+def _pump(fd: int, kind: bytes, sender: _FrameSender) -> None:
+    """Forward everything read from fd as frames of the given kind until EOF"""
+    with os.fdopen(fd, "rb", buffering=0) as f:
+        while True:
+            data = f.read(65536)
+            if not data:
+                break
+            sender.send(kind, data)
+
+
+def _run_captured(sender: _FrameSender, run_job: Callable[[List[str]], int], argv, cwd) -> int:
+    """
+    Run a job with file descriptors 1 and 2 redirected into frames sent to the client.
+    Return the exit status.
+    """
+    saved_fds = [os.dup(1), os.dup(2)]
+    saved_cwd = os.getcwd()
+    pumps = []
+    for target_fd, kind in ((1, STDOUT), (2, STDERR)):
+        read_fd, write_fd = os.pipe()
+        os.dup2(write_fd, target_fd)
+        os.close(write_fd)
+        pump = threading.Thread(target=_pump, args=(read_fd, kind, sender), daemon=True)
+        pump.start()
+        pumps.append(pump)
+    saved_streams = sys.stdout, sys.stderr
+    sys.stdout = open(1, "w", closefd=False)
+    sys.stderr = open(2, "w", buffering=1, closefd=False)
+    try:
+        if cwd is not None:
+            os.chdir(cwd)
+        status = run_job(argv)
+    except SystemExit as e:
+        if e.code is None:
+            status = 0
+        elif isinstance(e.code, int):
+            status = e.code
+        else:
+            print(e.code, file=sys.stderr)
+            status = 1
+    except Exception:
+        traceback.print_exc()
+        status = 1
+    finally:
+        os.chdir(saved_cwd)
+        sys.stdout.close()
+        sys.stderr.close()
+        sys.stdout, sys.stderr = saved_streams
+        for stream in saved_streams:
+            stream.flush()
+        # Restoring the original descriptors closes the write ends of the pipes
+        for target_fd, saved_fd in zip((1, 2), saved_fds):
+            os.dup2(saved_fd, target_fd)
+            os.close(saved_fd)
+        for pump in pumps:
+            pump.join()
+    return status or 0
+
+
+def _handle_connection(conn, run_job) -> None:
+    with conn.makefile("rb") as f:
+        line = f.readline()
+    sender = _FrameSender(conn)
+    try:
+        request = json.loads(line)
+        argv = [str(arg) for arg in request["argv"]]
+        cwd = request.get("cwd")
+    except (ValueError, KeyError, TypeError) as e:
+        sender.send(STDERR, "Invalid request: {}\n".format(e).encode())
+        sender.send(EXIT, b"2")
+        return
+    status = _run_captured(sender, run_job, argv, cwd)
+    sender.send(EXIT, str(status).encode())
+
+
+def _worker(sock, run_job, initialize) -> None:
+    signal.signal(signal.SIGTERM, signal.SIG_DFL)
+    if initialize is not None:
+        try:
+            initialize()
+        except Exception:
+            traceback.print_exc()
+            os._exit(_INITIALIZE_FAILED)
+    while True:
+        conn, _ = sock.accept()
+        with conn:
+            _handle_connection(conn, run_job)
+
+
+def _spawn_worker(sock, run_job, initialize) -> int:
+    pid = os.fork()
+    if pid == 0:
+        status = 0
+        try:
+            _worker(sock, run_job, initialize)
+        except KeyboardInterrupt:
+            pass
+        except BaseException:
+            traceback.print_exc()
+            status = 1
+        finally:
+            os._exit(status)
+    return pid
+
+
+def _remove_stale_socket(path: str) -> None:
+    try:
+        mode = os.stat(path).st_mode
+    except FileNotFoundError:
+        return
+    if not stat.S_ISSOCK(mode):
+        raise OSError("{!r} exists and is not a socket".format(path))
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as probe:
+        try:
+            probe.connect(path)
+        except (ConnectionRefusedError, FileNotFoundError):
+            os.unlink(path)
+            return
+    raise OSError("A server is already listening on {!r}".format(path))
+
+
+def _terminate(signum, frame):
+    raise SystemExit(0)
+
+
+def serve(
+    socket_path: str,
+    workers: int,
+    run_job: Callable[[List[str]], int],
+    initialize: Callable[[], None] = None,
+) -> None:
+    """
+    Listen on socket_path and run jobs in the given number of worker processes until
+    interrupted or terminated.
+
+    The socket is only accessible to the user running the server since jobs run
+    with that user's privileges.
+
+    run_job -- called in a worker with the argument list of a job; returns the exit status
+    initialize -- called once in each worker process before it accepts jobs
+
+    Raise ServiceError if MAX_INITIALIZE_FAILURES workers in a row fail to initialize.
+    """
+    _remove_stale_socket(socket_path)
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    previous_umask = os.umask(0o077)
+    try:
+        sock.bind(socket_path)
+    finally:
+        os.umask(previous_umask)
+    sock.listen(16)
+    logger.info(
+        "Listening on %s with %d worker%s", socket_path, workers, "" if workers == 1 else "s"
+    )
+    previous_handler = signal.signal(signal.SIGTERM, _terminate)
+    pids = set()
+    initialize_failures = 0
+    try:
+        for _ in range(workers):
+            pids.add(_spawn_worker(sock, run_job, initialize))
+        while True:
+            pid, status = os.wait()
+            pids.discard(pid)
+            if os.WIFEXITED(status) and os.WEXITSTATUS(status) == _INITIALIZE_FAILED:
+                initialize_failures += 1
+                if initialize_failures >= MAX_INITIALIZE_FAILURES:
+                    raise ServiceError(
+                        "{} workers in a row failed to initialize".format(initialize_failures)
+                    )
+                delay = INITIALIZE_RETRY_DELAY * 2 ** (initialize_failures - 1)
+                logger.warning("Worker %d failed to initialize, restarting it in %g s", pid, delay)
+                time.sleep(delay)
+            else:
+                initialize_failures = 0
+                logger.warning(
+                    "Worker %d exited unexpectedly (status %d), restarting it", pid, status
+                )
+            pids.add(_spawn_worker(sock, run_job, initialize))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        signal.signal(signal.SIGTERM, previous_handler)
+        for pid in pids:
+            try:
+                os.kill(pid, signal.SIGTERM)
+                os.waitpid(pid, 0)
+            except (ProcessLookupError, ChildProcessError):
+                pass
+        sock.close()
+        os.unlink(socket_path)
+        logger.info("Server stopped")
+
+
+def submit(socket_path: str, argv: List[str], stdout=None, stderr=None) -> int:
+    """
+    Run a job on the server listening on socket_path, write its output to the
+    given binary streams (standard output and error by default) and return its
+    exit status.
+    """
+    stdout = stdout if stdout is not None else sys.stdout.buffer
+    stderr = stderr if stderr is not None else sys.stderr.buffer
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(socket_path)
+        request = {"argv": list(argv), "cwd": os.getcwd()}
+        sock.sendall(json.dumps(request).encode() + b"\n")
+        with sock.makefile("rb") as f:
+            while True:
+                header = f.read(_HEADER.size)
+                if len(header) < _HEADER.size:
+                    raise ConnectionError("Connection to server closed unexpectedly")
+                kind, length = _HEADER.unpack(header)
+                data = f.read(length)
+                if kind == STDOUT:
+                    stdout.write(data)
+                elif kind == STDERR:
+                    stderr.write(data)
+                    stderr.flush()
+                elif kind == EXIT:
+                    stdout.flush()
+                    return int(data)
+
+
+def main(argv=sys.argv[1:]) -> int:
+    if len(argv) < 2:
+        print("Usage: python -m whatshap.service SOCKET COMMAND [ARGS...]", file=sys.stderr)
+        return 2
+    try:
+        return submit(argv[0], argv[1:])
+    except OSError as e:
+        print("Cannot submit job to {!r}: {}".format(argv[0], e), file=sys.stderr)
+        return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -3,7 +3,14 @@ Utility functions only used by unit tests
 """
 import textwrap
 from collections import defaultdict
-from whatshap.core import Read, ReadSet, Genotype
+from whatshap.core import (
+    Read,
+    ReadSet,
+    Genotype,
+    NumericSampleIds,
+    Pedigree,
+    PhredGenotypeLikelihoods,
+)
 
 
 def string_to_readset(s, w=None, sample_ids=None, source_id=0, scale_quality=None):
@@ -34,6 +41,54 @@ def string_to_readset(s, w=None, sample_ids=None, source_id=0, scale_quality=Non
     return rs
 
 
+def random_family_readset(
+    rng,
+    samples,
+    trios=(),
+    max_variants=30,
+    max_reads=10,
+    max_span=4,
+    qualities=(5, 10, 20),
+    unknown_genotypes=False,
+):
+    """
+    Create a random phasing problem for a family and return a tuple
+    (numeric_sample_ids, pedigree, positions, readset).
+
+    samples -- names of the individuals
+    trios -- (mother, father, child) triples of sample names
+    unknown_genotypes -- if True, genotypes are missing and all genotype likelihoods
+        are equal. Otherwise, all genotypes are heterozygous.
+
+    There are between 1 and max_variants variants and between 1 and max_reads reads.
+    Each read belongs to a random sample and covers between 1 and max_span
+    consecutive variants.
+    """
+    numeric_sample_ids = NumericSampleIds()
+    pedigree = Pedigree(numeric_sample_ids)
+    positions = [10 * (i + 1) for i in range(rng.randint(1, max_variants))]
+    for sample in samples:
+        if unknown_genotypes:
+            pedigree.add_individual(
+                sample,
+                [Genotype([]) for _ in positions],
+                [PhredGenotypeLikelihoods([1 / 3, 1 / 3, 1 / 3]) for _ in positions],
+            )
+        else:
+            pedigree.add_individual(sample, [Genotype([0, 1])] * len(positions))
+    for mother, father, child in trios:
+        pedigree.add_relationship(mother, father, child)
+    readset = ReadSet()
+    for i in range(rng.randint(1, max_reads)):
+        read = Read("read{}".format(i), 60, 0, numeric_sample_ids[rng.choice(samples)])
+        start = rng.randrange(len(positions))
+        for position in positions[start : start + rng.randint(1, max_span)]:
+            read.add_variant(position, rng.randint(0, 1), rng.choice(qualities))
+        readset.add(read)
+    readset.sort()
+    return numeric_sample_ids, pedigree, positions, readset
+
+
 def string_to_readset_pedigree(s, w=None, scaling_quality=None):
     s = textwrap.dedent(s).strip()
     read_sources = []
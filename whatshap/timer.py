@@ -31,6 +31,21 @@ class StageTimer:
         """
         return self._elapsed[stage]
 
+    def elapsed_times(self):
+        """Return a dict that maps each stage to the total time spent in it"""
+        return dict(self._elapsed)
+
+    def add(self, elapsed, total=0.0):
+        """
+        Add times measured elsewhere (for example, in an earlier run of the program).
+
+        elapsed -- dict that maps stages to times
+        total -- added to the overall elapsed time
+        """
+        for stage, t in elapsed.items():
+            self._elapsed[stage] += t
+        self._overall_start_time -= total
+
     def sum(self):
         """Return sum of all times"""
         return sum(self._elapsed.values())
@@ -1,7 +1,8 @@
 import gzip
 import logging
-from collections import defaultdict
-from typing import Optional, DefaultDict
+import os
+from collections import defaultdict, OrderedDict
+from typing import Optional, DefaultDict, Dict
 
 import pyfaidx
 from dataclasses import dataclass
@@ -42,6 +43,15 @@ def detect_file_format(path):
 
 
 def IndexedFasta(path):
+    if _fasta_cache is not None:
+        key = os.path.abspath(path)
+        if key not in _fasta_cache:
+            _fasta_cache[key] = CachedFasta(_open_indexed_fasta(path))
+        return _fasta_cache[key]
+    return _open_indexed_fasta(path)
+
+
+def _open_indexed_fasta(path):
     try:
         f = pyfaidx.Fasta(path, as_raw=True, sequence_always_upper=True, build_index=False)
     except pyfaidx.IndexNotFoundError:
@@ -49,6 +59,51 @@ def IndexedFasta(path):
     return f
 
 
+class CachedFasta:
+    """
+    Wrap an indexed FASTA such that the most recently used sequences are kept in
+    memory as str. close() does nothing, so the object can be used by many jobs.
+    """
+
+    def __init__(self, fasta, max_sequences: int = 2):
+        self._fasta = fasta
+        self._max_sequences = max_sequences
+        self._sequences: "OrderedDict[str, str]" = OrderedDict()
+        self.filename = fasta.filename
+
+    def __getitem__(self, name):
+        try:
+            self._sequences.move_to_end(name)
+        except KeyError:
+            self._sequences[name] = self._fasta[name][:]
+            if len(self._sequences) > self._max_sequences:
+                self._sequences.popitem(last=False)
+        return self._sequences[name]
+
+    def __contains__(self, name):
+        return name in self._fasta
+
+    def keys(self):
+        return self._fasta.keys()
+
+    def close(self):
+        pass
+
+
+# Maps absolute paths to CachedFasta objects if reference caching is enabled
+_fasta_cache: Optional[Dict[str, CachedFasta]] = None
+
+
+def enable_reference_cache():
+    """
+    Make IndexedFasta() return the same CachedFasta object for repeated calls with
+    the same path. This is used by long-running processes that run many jobs.
+    """
+    global _fasta_cache
+    if _fasta_cache is None:
+        _fasta_cache = dict()
+
+
 def plural_s(n: int) -> str:
     return "" if n == 1 else "s"
 
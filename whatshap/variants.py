@@ -1,11 +1,15 @@
 """
 Detect variants in reads.
 """
+import heapq
 import logging
-from collections import defaultdict, Counter
-from typing import Iterable, Iterator, List, Optional
+from array import array
+from bisect import bisect_left, bisect_right
+from collections import Counter, defaultdict, deque
+from functools import lru_cache
+from typing import Deque, Dict, List, Optional, Tuple
 
-from .core import Read, ReadSet, NumericSampleIds
+from .core import Read, ReadSet, NumericSampleIds, build_reads
 from .bam import SampleBamReader, MultiBamReader, BamReader
 from .align import edit_distance, edit_distance_affine_gap
 from ._variants import _iterate_cigar
@@ -13,11 +17,280 @@ from ._variants import _iterate_cigar
 
 logger = logging.getLogger(__name__)
 
+# Windows around variants that are closer than this are fetched together
+FETCH_WINDOW_MAX_GAP = 10000
+
+# Fetch the whole chromosome if windows cover more than this fraction of the variant span
+FETCH_WINDOW_MAX_COVERED_FRACTION = 0.5
+
+# Mates that are not a proper pair are pre-selected together only up to this insert size
+PRESELECT_MAX_INSERT_SIZE = 1000
+
 
 class ReadSetError(Exception):
     pass
 
 
+def variant_windows(
+    variants, max_gap: int = FETCH_WINDOW_MAX_GAP
+) -> Optional[List[Tuple[int, int]]]:
+    """
+    Plan fetching alignments for sparse variants: Return sorted, non-overlapping
+    (start, end) windows such that every alignment that can cover one of the variants
+    overlaps at least one window. Windows less than max_gap apart are merged.
+
+    Return None if the windows would cover most of the region spanned by the
+    variants (or there are no variants). The whole chromosome should then be read.
+    """
+    windows: List[List[int]] = []
+    for variant in sorted(variants, key=lambda v: v.position):
+        # An insertion can be detected in an alignment that ends right before it
+        start = max(0, variant.position - 1)
+        end = variant.position + max(1, len(variant.reference_allele))
+        if windows and start - windows[-1][1] < max_gap:
+            windows[-1][1] = max(windows[-1][1], end)
+        else:
+            windows.append([start, end])
+    if not windows:
+        return None
+    covered = sum(end - start for start, end in windows)
+    if covered > FETCH_WINDOW_MAX_COVERED_FRACTION * (windows[-1][1] - windows[0][0]):
+        return None
+    return [(start, end) for start, end in windows]
+
+
+class ReadBatch:
+    """
+    Collect reads as flat arrays so that they can be turned into a ReadSet with a single
+    call to the native build_reads function instead of one call per allele.
+    """
+
+    def __init__(self):
+        self._names: List[str] = []
+        self._mapqs = array("i")
+        self._source_ids = array("i")
+        self._sample_ids = array("i")
+        self._reference_starts = array("i")
+        self._BX_tags: List[str] = []
+        self._variant_offsets = array("l", [0])
+        self._positions = array("i")
+        self._alleles = array("i")
+        self._qualities = array("i")
+
+    def __len__(self):
+        return len(self._names)
+
+    def add(self, name, mapq, source_id, sample_id, reference_start, BX_tag, positions, detected):
+        """
+        Add a read unless it covers no variants.
+
+        positions -- positions of the variants
+        detected -- (index, allele, quality) triples, where index is into positions
+        """
+        for j, allele, quality in detected:
+            self._positions.append(positions[j])
+            self._alleles.append(allele)
+            self._qualities.append(quality)
+        if len(self._positions) == self._variant_offsets[-1]:
+            return
+        self._names.append(name)
+        self._mapqs.append(mapq)
+        self._source_ids.append(source_id)
+        self._sample_ids.append(sample_id)
+        self._reference_starts.append(reference_start)
+        self._BX_tags.append(BX_tag)
+        self._variant_offsets.append(len(self._positions))
+
+    def build(self) -> ReadSet:
+        """
+        Return a ReadSet with the collected reads. The two ends of paired-end reads
+        (identified by name, source_id and sample_id) are merged into one read as by
+        merge_reads().
+        """
+        try:
+            return build_reads(
+                self._names,
+                self._mapqs,
+                self._source_ids,
+                self._sample_ids,
+                self._reference_starts,
+                self._BX_tags,
+                self._variant_offsets,
+                self._positions,
+                self._alleles,
+                self._qualities,
+            )
+        except RuntimeError as e:
+            raise ReadSetError(e)
+
+
+@lru_cache(maxsize=65536)
+def _window_distance_affine_gap(query, target, default_mismatch, gap_start, gap_extend):
+    """
+    Affine-gap distance between a read window that matches one allele exactly and the
+    window of the other allele. It depends only on the two windows, which recur for
+    many reads, and is therefore cached.
+    """
+    return edit_distance_affine_gap(
+        query, target, [default_mismatch] * len(query), gap_start, gap_extend
+    )
+
+
+class _Template:
+    """Alignments of one read (pair) as seen by the CoveragePreselector"""
+
+    __slots__ = ("group", "covered", "keep")
+
+    def __init__(self, group, covered: List[int]):
+        self.group = group
+        self.covered = covered  # indices of the variants that the alignments may cover
+        self.keep: Optional[bool] = None  # None: not decided yet
+
+
+class CoveragePreselector:
+    """
+    Cheap pre-selection of alignments for phasing before alleles are detected in them.
+
+    Only the span of an alignment (and that of its mate) is used to determine which
+    variants it may cover. Alignments that cover fewer than two variants are discarded
+    since they cannot contribute to phasing. Of the others, an alignment is kept if the
+    first two variants it covers are connected by fewer than coverage kept alignments.
+
+    Otherwise, the decision is postponed until all alignments that could connect any of its
+    variants have been seen. It is then kept only if it connects two variants that are not
+    connected by any kept alignment, so that variants connected by the full set of
+    alignments remain connected.
+
+    Both mates of a proper pair, or of a pair with a small insert, are kept or discarded
+    together. Other mates are treated as separate alignments. Alignments are counted
+    separately for each group (sample).
+    """
+
+    def __init__(
+        self, positions: List[int], coverage: int, max_insert_size: int = PRESELECT_MAX_INSERT_SIZE
+    ):
+        """
+        positions -- sorted variant positions
+        coverage -- number of alignments that should connect adjacent variants
+        max_insert_size -- mates that are not a proper pair are only treated together
+            if their estimated insert size is at most this
+        """
+        self._positions = positions
+        self._coverage = coverage
+        self._max_insert_size = max_insert_size
+        # For each group, the number of kept alignments that connect variants i and i+1
+        self._connections: Dict[object, array] = dict()
+        self.kept: Dict[object, int] = defaultdict(int)
+        self.discarded: Dict[object, int] = defaultdict(int)
+
+    def select(self, items, alignment=lambda item: item.bam_alignment, group=lambda item: None):
+        """
+        Yield those of the given items that are selected, in the original order. Items must
+        be sorted by alignment start.
+
+        alignment -- function that returns the pysam.AlignedSegment of an item
+        group -- function that returns the group (such as the sample) of an item
+        """
+        # Templates whose mate is still to come, by group and name
+        mates: Dict[Tuple[object, str], _Template] = dict()
+        # Undecided templates as (position, counter, template), where position is that of the
+        # last variant they connect to the next one. Once alignments start to the right of
+        # it, no further alignment can connect these variants.
+        undecided: List[Tuple[int, int, _Template]] = []
+        # Items that are not yet yielded or discarded
+        queue: Deque[Tuple[object, _Template]] = deque()
+        for counter, item in enumerate(items):
+            bam_alignment = alignment(item)
+            item_group = group(item)
+            while undecided and undecided[0][0] < bam_alignment.reference_start:
+                self._decide_late(heapq.heappop(undecided)[2])
+            template = mates.pop((item_group, bam_alignment.query_name), None)
+            if template is None:
+                template, mate_follows = self._decide(bam_alignment, item_group)
+                if mate_follows:
+                    mates[(item_group, bam_alignment.query_name)] = template
+                if template.keep is None:
+                    position = self._positions[template.covered[-1] - 1]
+                    heapq.heappush(undecided, (position, counter, template))
+            queue.append((item, template))
+            yield from self._flush(queue)
+        while undecided:
+            self._decide_late(heapq.heappop(undecided)[2])
+        yield from self._flush(queue)
+
+    def _flush(self, queue):
+        while queue and queue[0][1].keep is not None:
+            item, template = queue.popleft()
+            if template.keep:
+                self.kept[template.group] += 1
+                yield item
+            else:
+                self.discarded[template.group] += 1
+
+    def _decide(self, bam_alignment, group) -> Tuple[_Template, bool]:
+        """
+        Return a template for the given alignment, and whether its mate comes later. The
+        template is kept or discarded immediately if possible.
+        """
+        start = bam_alignment.reference_start
+        end = bam_alignment.reference_end
+        lo = bisect_left(self._positions, start)
+        hi = bisect_right(self._positions, end)
+        covered = list(range(lo, hi))
+        mate_follows = (
+            bam_alignment.is_paired
+            and not bam_alignment.mate_is_unmapped
+            and bam_alignment.next_reference_id == bam_alignment.reference_id
+            and bam_alignment.next_reference_start >= start
+            and (
+                bam_alignment.is_proper_pair
+                # Assume the mate has the same length
+                or bam_alignment.next_reference_start + end - 2 * start <= self._max_insert_size
+            )
+        )
+        if mate_follows:
+            mate_start = bam_alignment.next_reference_start
+            mate_lo = max(hi, bisect_left(self._positions, mate_start))
+            mate_hi = bisect_right(self._positions, mate_start + end - start)
+            covered.extend(range(mate_lo, mate_hi))
+        template = _Template(group, covered)
+        if len(covered) < 2:
+            template.keep = False
+        elif (
+            covered[1] == covered[0] + 1
+            and self._group_connections(group)[covered[0]] < self._coverage
+        ):
+            self._keep(template)
+        return template, mate_follows
+
+    def _decide_late(self, template: _Template) -> None:
+        connections = self._group_connections(template.group)
+        covered = template.covered
+        # Keep the template if it connects two variants between which the kept
+        # alignments leave a gap
+        if any(connections[i] == 0 for a, b in zip(covered, covered[1:]) for i in range(a, b)):
+            self._keep(template)
+        else:
+            template.keep = False
+
+    def _keep(self, template: _Template) -> None:
+        # Only adjacent variants that are both covered are connected; the variants
+        # between two mates are not
+        connections = self._group_connections(template.group)
+        covered = template.covered
+        for a, b in zip(covered, covered[1:]):
+            if b == a + 1:
+                connections[a] += 1
+        template.keep = True
+
+    def _group_connections(self, group) -> array:
+        connections = self._connections.get(group)
+        if connections is None:
+            connections = array("i", [0]) * max(0, len(self._positions) - 1)
+            self._connections[group] = connections
+        return connections
+
+
 class ReadSetReader:
     """
     Associate VCF variants with BAM reads.
@@ -67,7 +340,9 @@ class ReadSetReader:
     def n_paths(self):
         return len(self._paths)
 
-    def read(self, chromosome, variants, sample, reference, regions=None) -> ReadSet:
+    def read(
+        self, chromosome, variants, sample, reference, regions=None, preselect_coverage=None
+    ) -> ReadSet:
         """
         Detect alleles and return a ReadSet object containing reads representing
         the given variants.
@@ -85,91 +360,168 @@ class ReadSetReader:
             ignored and all reads in the file are used.
         reference -- reference sequence of the given chromosome (or None)
         regions -- list of start,end tuples (end can be None)
+        preselect_coverage -- if given, skip alignments before detecting alleles in them
+            where variants are already spanned by this many alignments (see
+            CoveragePreselector)
         """
+        self._check_variants(variants)
+        # FIXME hard-coded zero
+        numeric_sample_id = 0 if sample is None else self._numeric_sample_ids[sample]
+        alignments = self._usable_alignments(
+            chromosome, sample, self._plan_fetches(regions, variants)
+        )
+        preselector: Optional[CoveragePreselector] = None
+        if preselect_coverage is not None:
+            preselector = self._make_preselector(variants, preselect_coverage)
+            alignments = preselector.select(alignments)
+        alignments = ((numeric_sample_id, alignment) for alignment in alignments)
+        batch = ReadBatch()
+        self._alignments_to_reads(alignments, variants, reference, {numeric_sample_id: batch})
+        if preselector is not None:
+            self._log_preselection(preselector, None)
+        return batch.build()
+
+    def read_samples(
+        self, chromosome, variants, samples, reference, regions=None, preselect_coverage=None
+    ) -> Dict[str, ReadSet]:
+        """
+        Detect alleles for several samples at once and return a dict that maps each sample
+        to a ReadSet as returned by read(). The alignments are read and processed only once,
+        so this is much faster than calling read() for each sample when the samples share
+        BAM/CRAM files. Samples that do not occur in any of the files are omitted.
+
+        Arguments are as for read(), except that samples is a list of sample names.
+        """
+        self._check_variants(variants)
+        samples = [sample for sample in samples if self._reader.has_sample(sample)]
+        numeric_sample_ids = {sample: self._numeric_sample_ids[sample] for sample in samples}
+        alignments = self._usable_sample_alignments(
+            chromosome, samples, self._plan_fetches(regions, variants)
+        )
+        preselector: Optional[CoveragePreselector] = None
+        if preselect_coverage is not None:
+            preselector = self._make_preselector(variants, preselect_coverage)
+            alignments = preselector.select(
+                alignments, alignment=lambda item: item[1].bam_alignment, group=lambda item: item[0]
+            )
+        alignments = ((numeric_sample_ids[sample], alignment) for sample, alignment in alignments)
+        batches = {numeric_sample_ids[sample]: ReadBatch() for sample in samples}
+        self._alignments_to_reads(alignments, variants, reference, batches)
+        if preselector is not None:
+            for sample in samples:
+                self._log_preselection(preselector, sample)
+        return {sample: batches[numeric_sample_ids[sample]].build() for sample in samples}
+
+    @staticmethod
+    def _make_preselector(variants, coverage) -> CoveragePreselector:
+        return CoveragePreselector(sorted(variant.position for variant in variants), coverage)
+
+    @staticmethod
+    def _log_preselection(preselector: CoveragePreselector, sample) -> None:
+        """Log the numbers of alignments pre-selected for a sample (None if not grouped)"""
+        logger.info(
+            "Pre-selected %d of %d alignments %sfor allele detection",
+            preselector.kept[sample],
+            preselector.kept[sample] + preselector.discarded[sample],
+            "" if sample is None else "of sample {!r} ".format(sample),
+        )
+
+    @staticmethod
+    def _check_variants(variants):
         # Since variants are identified by position, positions must be unique.
         if __debug__ and variants:
             varposc = Counter(variant.position for variant in variants)
             pos, count = varposc.most_common()[0]
             assert count == 1, "Position {} occurs more than once in variant list.".format(pos)
 
-        alignments = self._usable_alignments(chromosome, sample, regions)
-        reads = self._alignments_to_reads(alignments, variants, sample, reference)
-        grouped_reads = self._group_paired_reads(reads)
-        readset = self._make_readset_from_grouped_reads(grouped_reads)
-        return readset
-
     @staticmethod
-    def _make_readset_from_grouped_reads(groups: Iterable[List[Read]]) -> ReadSet:
-        read_set = ReadSet()
-        for group in groups:
-            read_set.add(merge_reads(*group))
-        return read_set
-
-    @staticmethod
-    def _group_paired_reads(reads: Iterable[Read]) -> Iterator[List[Read]]:
-        """
-        Group reads into paired-end read pairs. Uses name, source_id and sample_id
-        as grouping key.
-
-        TODO
-        Grouping by name should be sufficient since the SAM spec states:
-        "Reads/segments having identical QNAME are regarded to come from the same template."
-        """
-        groups = defaultdict(list)
-        for read in reads:
-            groups[(read.source_id, read.name, read.sample_id)].append(read)
-        for group in groups.values():
-            if len(group) > 2:
-                raise ReadSetError(
-                    "Read name {!r} occurs more than twice in the input file".format(group[0].name)
-                )
-            yield group
+    def _plan_fetches(regions, variants) -> List[Tuple[int, Optional[int], int]]:
+        """
+        Return the regions to fetch as (start, end, min_start) tuples. Alignments that
+        start before min_start were already returned by the preceding region and must
+        be skipped.
 
-    def _usable_alignments(self, chromosome, sample, regions=None):
+        If no regions are given, only windows around the variants are fetched (see
+        variant_windows()) unless the variants are dense, in which case the whole
+        chromosome is read.
+        """
+        if regions is not None:
+            return [(s, e, 0) for s, e in regions]
+        windows = variant_windows(variants)
+        if windows is None:
+            return [(0, None, 0)]
+        logger.debug(
+            "Fetching alignments from %d windows around variants spanning %d bp",
+            len(windows),
+            sum(end - start for start, end in windows),
+        )
+        fetches = []
+        min_start = 0
+        for start, end in windows:
+            fetches.append((start, end, min_start))
+            min_start = end
+        return fetches
+
+    def _usable_alignments(self, chromosome, sample, fetches):
         """
         Retrieve usable (suficient mapping quality, not secondary etc.)
         alignments from the alignment file
+
+        fetches -- regions as returned by _plan_fetches()
         """
-        if regions is None:
-            regions = [(0, None)]
-        for s, e in regions:
+        for s, e, min_start in fetches:
             for alignment in self._reader.fetch(
                 reference=chromosome, sample=sample, start=s, end=e
             ):
-                # TODO handle additional alignments correctly!
-                # find out why they are sometimes overlapping/redundant
-                if (
-                    alignment.bam_alignment.flag & 2048 != 0
-                    or alignment.bam_alignment.mapping_quality < self._mapq_threshold
-                    or alignment.bam_alignment.is_secondary
-                    or alignment.bam_alignment.is_unmapped
-                    or alignment.bam_alignment.is_duplicate
-                ):
+                if alignment.bam_alignment.reference_start < min_start:
                     continue
-                yield alignment
+                if self._is_usable(alignment.bam_alignment):
+                    yield alignment
+
+    def _usable_sample_alignments(self, chromosome, samples, fetches):
+        """
+        Retrieve usable alignments of several samples as (sample, alignment) pairs,
+        reading each region only once
+        """
+        for s, e, min_start in fetches:
+            for sample, alignment in self._reader.fetch_samples(chromosome, samples, s, e):
+                if alignment.bam_alignment.reference_start < min_start:
+                    continue
+                if self._is_usable(alignment.bam_alignment):
+                    yield sample, alignment
+
+    def _is_usable(self, bam_alignment) -> bool:
+        # TODO handle additional alignments correctly!
+        # find out why they are sometimes overlapping/redundant
+        return not (
+            bam_alignment.flag & 2048 != 0
+            or bam_alignment.mapping_quality < self._mapq_threshold
+            or bam_alignment.is_secondary
+            or bam_alignment.is_unmapped
+            or bam_alignment.is_duplicate
+        )
 
     def has_reference(self, chromosome):
         return self._reader.has_reference(chromosome)
 
-    def _alignments_to_reads(self, alignments, variants, sample, reference):
+    def _alignments_to_reads(self, alignments, variants, reference, batches):
         """
-        Convert BAM alignments to Read objects.
+        Convert BAM alignments, given as (numeric_sample_id, alignment) pairs, to reads.
 
         If reference is not None, alleles are detected through re-alignment.
 
-        Yield Read objects.
+        Reads are added to batches[numeric_sample_id], which must be a ReadBatch.
         """
-        # FIXME hard-coded zero
-        numeric_sample_id = 0 if sample is None else self._numeric_sample_ids[sample]
         if reference is not None:
             # Copy the pyfaidx.FastaRecord into a str for faster access
             reference = reference[:]
             normalized_variants = variants
         else:
             normalized_variants = [variant.normalized() for variant in variants]
+        positions = [variant.position for variant in variants]
 
         i = 0  # index into variants
-        for alignment in alignments:
+        for numeric_sample_id, alignment in alignments:
             # Skip variants that are to the left of this read
             while (
                 i < len(normalized_variants)
@@ -181,15 +533,6 @@ class ReadSetReader:
             if alignment.bam_alignment.has_tag("BX"):
                 barcode = alignment.bam_alignment.get_tag("BX")
 
-            read = Read(
-                alignment.bam_alignment.qname,
-                alignment.bam_alignment.mapq,
-                alignment.source_id,
-                numeric_sample_id,
-                alignment.bam_alignment.reference_start,
-                barcode,
-            )
-
             if reference is None:
                 detected = self.detect_alleles(normalized_variants, i, alignment.bam_alignment)
             else:
@@ -204,10 +547,16 @@ class ReadSetReader:
                     self._gap_extend,
                     self._default_mismatch,
                 )
-            for j, allele, quality in detected:
-                read.add_variant(variants[j].position, allele, quality)
-            if read:  # At least one variant covered and detected
-                yield read
+            batches[numeric_sample_id].add(
+                alignment.bam_alignment.qname,
+                alignment.bam_alignment.mapq,
+                alignment.source_id,
+                numeric_sample_id,
+                alignment.bam_alignment.reference_start,
+                barcode,
+                positions,
+                detected,
+            )
 
     @staticmethod
     def detect_alleles(variants, j, bam_read):
@@ -494,6 +843,22 @@ class ReadSetReader:
             assert gap_extend is not None
             assert default_mismatch is not None
 
+        # Fast path: Most windows match one of the alleles exactly. The distance to that
+        # allele is zero, and only the distance to the other one may need to be computed.
+        if query == ref or query == alt:
+            if ref == alt:
+                return None, None  # cannot decide
+            allele, other = (0, alt) if query == ref else (1, ref)
+            if not use_affine:
+                return allele, 30
+            base_qual_score = _window_distance_affine_gap(
+                query, other, default_mismatch, gap_start, gap_extend
+            )
+            if base_qual_score == 0:
+                return None, None  # cannot decide
+            return allele, base_qual_score
+
+        if use_affine:
             # get base qualities if present (to be used as mismatch costs)
             base_qualities = [default_mismatch] * len(query)
             # if bam_read.query_qualities != None:
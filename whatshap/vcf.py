@@ -14,12 +14,12 @@ from pysam import VariantFile, VariantHeader, VariantRecord
 from pysam.libcbcf import VariantRecordSample
 
 from .core import (
-    Read,
     ReadSet,
     PhredGenotypeLikelihoods,
     Genotype,
     binomial_coefficient,
     get_max_genotype_ploidy,
+    phased_blocks_as_reads as core_phased_blocks_as_reads,
 )
 from .utils import warn_once
 
@@ -242,16 +242,27 @@ class VariantTable:
         """Return a unique int id of a sample given by name"""
         return self._sample_to_index[sample]
 
+    def copy(self) -> "VariantTable":
+        """
+        Return a copy of this table. The rows are copied, but the objects in them
+        (variants, genotypes etc.) are shared because the table never modifies them.
+        """
+        table = VariantTable(self.chromosome, list(self.samples))
+        table.variants = list(self.variants)
+        table.genotypes = [list(gt) for gt in self.genotypes]
+        table.phases = [list(ph) for ph in self.phases]
+        table.genotype_likelihoods = [list(gl) for gl in self.genotype_likelihoods]
+        return table
+
     def remove_rows_by_index(self, indices: Iterable[int]) -> None:
         """Remove variants given by their index in the variant list"""
-        for i in sorted(indices, reverse=True):
-            del self.variants[i]
-            for gt in self.genotypes:
-                del gt[i]
-            for ph in self.phases:
-                del ph[i]
-            for gl in self.genotype_likelihoods:
-                del gl[i]
+        to_remove = frozenset(indices)
+        if not to_remove:
+            return
+        keep = [i for i in range(len(self.variants)) if i not in to_remove]
+        # Modify the lists in place as they may also be referenced elsewhere
+        for column in [self.variants] + self.genotypes + self.phases + self.genotype_likelihoods:
+            column[:] = [column[i] for i in keep]
 
         for gt in self.genotypes:
             assert len(self.variants) == len(gt)
@@ -281,10 +292,10 @@ class VariantTable:
         numeric_sample_id: int,
         default_quality: int = 20,
         mapq: int = 100,
-    ):
+    ) -> ReadSet:
         """
-        Yields one sorted core.Read object per phased block, encoding the phase information as
-        if this block was a single sequencing read. Reads are yielded in arbitrary order.
+        Return a ReadSet with one sorted core.Read object per phased block, encoding the phase
+        information as if this block was a single sequencing read. Reads are in arbitrary order.
 
         sample -- name of sample to retrieve
         input_variants -- variants of interest, i.e. only these variants will be retrieved
@@ -296,42 +307,18 @@ class VariantTable:
         try:
             sample_index = self._sample_to_index[sample]
         except KeyError:
-            return
-        input_variant_set = set(input_variants)
-        read_map: Dict[int, Read] = {}  # maps block_id core.Read objects
-        assert (
-            len(self.variants)
-            == len(self.genotypes[sample_index])
-            == len(self.phases[sample_index])
+            return ReadSet()
+        return core_phased_blocks_as_reads(
+            "{}_block_".format(sample),
+            self.variants,
+            self.genotypes[sample_index],
+            self.phases[sample_index],
+            input_variants,
+            source_id,
+            numeric_sample_id,
+            default_quality,
+            mapq,
         )
-        for variant, genotype, phase in zip(
-            self.variants, self.genotypes[sample_index], self.phases[sample_index]
-        ):
-            if len(genotype.as_vector()) > 2:
-                # only use diploid variants
-                continue
-            if variant not in input_variant_set:
-                continue
-            if genotype.is_homozygous():
-                continue
-            if phase is None:
-                continue
-            if phase.quality is None:
-                quality = default_quality
-            else:
-                quality = phase.quality
-            if phase.block_id in read_map:
-                read_map[phase.block_id].add_variant(variant.position, phase.phase[0], quality)
-            else:
-                r = Read(
-                    "{}_block_{}".format(sample, phase.block_id), mapq, source_id, numeric_sample_id
-                )
-                r.add_variant(variant.position, phase.phase[0], quality)
-                read_map[phase.block_id] = r
-        for key, read in read_map.items():
-            read.sort()
-            if len(read) > 1:
-                yield read
 
 
 class MixedPhasingError(Exception):
@@ -768,6 +755,94 @@ def missing_headers(path: str) -> Tuple[List[str], List[str], List[str]]:
     return (missing_contigs, incorrect_formats + missing_formats, missing_infos)
 
 
+def repair_header(
+    header: VariantHeader,
+    in_path: str,
+    command_line: Optional[str],
+    include_haploid_phase_sets: bool = False,
+) -> None:
+    """
+    Prepare the header of the VCF at in_path for writing modified records: Add the
+    contigs, FORMATs and INFOs that are missing (see missing_headers()) and add the
+    command line as a header entry (unless it is None).
+    """
+    # TODO This is slow because it reads in the entire VCF one extra time
+    contigs, formats, infos = missing_headers(in_path)
+    # TODO It would actually look nicer if the custom HS header was directly below PS
+    if include_haploid_phase_sets and "HS" not in formats:
+        formats.append("HS")
+    augment_header(header, contigs, formats, infos)
+    if command_line is not None:
+        command_line = '"' + command_line.replace('"', "") + '"'
+        header.add_meta("commandline", command_line)
+
+
+def setup_phasing_header(header: VariantHeader, tag: str = "PS") -> None:
+    """Add the definition of the phasing tag (PS or HP) to a header"""
+    # FreeBayes adds phasing=none to its VCF output - remove that.
+    for hr in header.records:
+        if hr.key == "phasing":
+            hr.remove()
+            break
+
+    header.add_line(PREDEFINED_FORMATS[tag].line())
+
+
+def is_phasable_record(record: VariantRecord, prev_pos: Optional[int], indels: bool) -> bool:
+    """
+    Return whether phasing information can be written to a record. prev_pos is the
+    position of the previously phased record.
+    """
+    if not record.alts:
+        return False
+    if len(record.alts) > 1:
+        # we do not phase multiallelic sites currently
+        return False
+    if record.start == prev_pos:
+        # duplicate position, skip it
+        return False
+    is_indel = len(str(record.ref)) > 1 or len(str(record.alts[0])) > 1
+    if not indels and is_indel:
+        return False
+    return True
+
+
+def set_HP(
+    call: VariantRecordSample,
+    component: int,
+    phase: Tuple[int, ...],
+    haploid_component: Optional[Iterable[int]] = None,
+):
+    """
+    call -- the call to update
+    component -- name of the component
+    phase -- tuple of alleles
+    """
+    assert all(allele in [0, 1] for allele in phase)
+    call["HP"] = ",".join("{}-{}".format(component + 1, allele + 1) for allele in phase)
+    if haploid_component:
+        call["HS"] = [comp + 1 for comp in haploid_component]
+
+
+def set_PS(
+    call: VariantRecordSample,
+    component: int,
+    phase: Tuple[int, ...],
+    haploid_component: Optional[Iterable[int]] = None,
+):
+    """
+    call -- the call to update
+    component -- name of the component
+    phase -- tuple of alleles
+    """
+    assert all(allele in [0, 1] for allele in phase)
+    call["PS"] = component + 1
+    call["GT"] = phase
+    if haploid_component:
+        call["HS"] = [comp + 1 for comp in haploid_component]
+    call.phased = True
+
+
 @dataclass
 class GenotypeChange:
     sample: str
@@ -793,20 +868,14 @@ class VcfAugmenter(ABC):
         tag -- which type of tag to write, either 'PS' or 'HP'. 'PS' is standardized;
             'HP' is compatible with GATK’s ReadBackedPhasing.
         """
-        # TODO This is slow because it reads in the entire VCF one extra time
-        contigs, formats, infos = missing_headers(in_path)
-        # TODO It would actually look nicer if the custom HS header was directly below PS
-        if include_haploid_phase_sets and "HS" not in formats:
-            formats.append("HS")
         # We repair the header (adding missing contigs, formats, infos) of the *input* VCF because
         # we will modify the records that we read, and these are associated with the input file.
         self._reader = VariantFile(in_path)
-        augment_header(self._reader.header, contigs, formats, infos)
-        if command_line is not None:
-            command_line = '"' + command_line.replace('"', "") + '"'
-            self._reader.header.add_meta("commandline", command_line)
+        repair_header(self._reader.header, in_path, command_line, include_haploid_phase_sets)
         self.setup_header(self._reader.header)
         self._writer = VariantFile(out_file, mode="w", header=self._reader.header)
+        # Writer for the final output while records are redirected by begin_part()
+        self._main_writer = None
         self._unprocessed_record = None
         self._reader_iter = iter(self._reader)
 
@@ -856,6 +925,36 @@ class VcfAugmenter(ABC):
         for record in self._iterrecords(chromosome):
             self._writer.write(record)
 
+    def skip(self, chromosome: str) -> None:
+        """
+        Skip all variants on one chromosome without writing them
+        chromosome -- name of chromosome
+        """
+        for _ in self._iterrecords(chromosome):
+            pass
+
+    def begin_part(self, path: str) -> None:
+        """
+        Write records to a separate bgzip-compressed VCF at path (with the same header
+        as the output) instead of the output until end_part() is called.
+        """
+        assert self._main_writer is None
+        self._main_writer = self._writer
+        self._writer = VariantFile(path, mode="wz", header=self._reader.header)
+
+    def end_part(self) -> None:
+        assert self._main_writer is not None
+        self._writer.close()
+        self._writer = self._main_writer
+        self._main_writer = None
+
+    def append_part(self, path: str) -> None:
+        """Copy all records of a VCF written between begin_part() and end_part() to the output"""
+        assert self._main_writer is None
+        with VariantFile(path) as part:
+            for record in part:
+                self._writer.write(record)
+
 
 class PhasedVcfWriter(VcfAugmenter):
     """
@@ -889,55 +988,12 @@ class PhasedVcfWriter(VcfAugmenter):
         self.ploidy = ploidy
         super().__init__(in_path, command_line, out_file, include_haploid_sets)
         self._phase_tag_found_warned = False
-        self._set_phasing_tags = self._set_HP if tag == "HP" else self._set_PS
+        self._set_phasing_tags = set_HP if tag == "HP" else set_PS
         self._indels = indels
 
     def setup_header(self, header: VariantHeader):
         """Called by baseclass constructor"""
-
-        # FreeBayes adds phasing=none to its VCF output - remove that.
-        for hr in header.records:
-            if hr.key == "phasing":
-                hr.remove()
-                break
-
-        header.add_line(PREDEFINED_FORMATS[self.tag].line())
-
-    def _set_HP(
-        self,
-        call: VariantRecordSample,
-        component: int,
-        phase: Tuple[int, ...],
-        haploid_component: Optional[Iterable[int]] = None,
-    ):
-        """
-        values -- tag dict to update
-        component -- name of the component
-        phase -- tuple of alleles
-        """
-        assert all(allele in [0, 1] for allele in phase)
-        call["HP"] = ",".join("{}-{}".format(component + 1, allele + 1) for allele in phase)
-        if haploid_component:
-            call["HS"] = [comp + 1 for comp in haploid_component]
-
-    def _set_PS(
-        self,
-        call: VariantRecordSample,
-        component: int,
-        phase: Tuple[int, ...],
-        haploid_component: Optional[Iterable[int]] = None,
-    ):
-        """
-        values -- tag dict to update
-        component -- name of the component
-        phase -- tuple of alleles
-        """
-        assert all(allele in [0, 1] for allele in phase)
-        call["PS"] = component + 1
-        call["GT"] = phase
-        if haploid_component:
-            call["HS"] = [comp + 1 for comp in haploid_component]
-        call.phased = True
+        setup_phasing_header(header, self.tag)
 
     def write(
         self,
@@ -985,16 +1041,7 @@ class PhasedVcfWriter(VcfAugmenter):
         for record in self._record_modifier(chromosome):
             self._remove_existing_phasing(record, list(sample_superreads))
             pos = record.start
-            if not record.alts:
-                continue
-            if len(record.alts) > 1:
-                # we do not phase multiallelic sites currently
-                continue
-            if pos == prev_pos:
-                # duplicate position, skip it
-                continue
-            is_indel = len(str(record.ref)) > 1 or len(str(record.alts[0])) > 1
-            if not self._indels and is_indel:
+            if not is_phasable_record(record, prev_pos, self._indels):
                 continue
 
             # Determine whether the variant is phased in any sample
@@ -1061,10 +1108,7 @@ class PhasedVcfWriter(VcfAugmenter):
     def _remove_existing_phasing(self, record: VariantRecord, samples: Iterable[str]):
         if self.tag == "PS":
             for sample in samples:
-                call = record.samples[sample]
-                call.phased = False
-                if call["GT"] is not None and all(allele is not None for allele in call["GT"]):
-                    call["GT"] = sorted(call["GT"])
+                unphase_call(record.samples[sample])
 
 
 def genotype_code(gt: Optional[Tuple[Optional[int], ...]]) -> Genotype:
@@ -1181,3 +1225,89 @@ class GenotypeVcfWriter(VcfAugmenter):
                 # delete all other genotype information that might have been present before
                 for tag in set(call.keys()) - GT_GL_GQ:
                     del call[tag]
+
+
+def unphase_call(call: VariantRecordSample) -> None:
+    """
+    Remove phasing from the GT field of a call. The alleles are sorted in ascending order,
+    that is, 1|0 becomes 0/1. The GT field is only written to if it needs to change.
+    """
+    gt = call["GT"]
+    if gt is not None and all(allele is not None for allele in gt):
+        sorted_gt = sorted(gt)
+        if list(gt) != sorted_gt:
+            call["GT"] = sorted_gt
+    if call.phased:
+        call.phased = False
+
+
+class VcfRewriter:
+    """
+    Stream all records of a VCF/BCF file to an output file, applying edits to chunks of
+    records on the way. Nothing but the current chunk is kept in memory.
+
+    With threads > 1, BGZF decompression of the input and compression of the output
+    run on additional threads.
+    """
+
+    def __init__(
+        self,
+        in_path: Union[str, PathLike, TextIO],
+        out_file: Union[str, PathLike, TextIO] = sys.stdout,
+        threads: int = 1,
+        chunk_size: int = 1000,
+    ):
+        """
+        in_path -- Path to input VCF (or an open file-like object)
+        out_file -- Path to output VCF or file-like object. Add .gz to the file name to get
+            compressed output.
+        """
+        self._reader = VariantFile(in_path, threads=threads)
+        self._out_file = out_file
+        self._threads = threads
+        self._chunk_size = chunk_size
+
+    @property
+    def header(self) -> VariantHeader:
+        """Header of the input file. Changes to it are written to the output file."""
+        return self._reader.header
+
+    @property
+    def samples(self) -> List[str]:
+        return list(self._reader.header.samples)
+
+    def close(self):
+        self._reader.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def chunks(self) -> Iterator[List[VariantRecord]]:
+        """Yield lists of consecutive records"""
+        records = iter(self._reader)
+        while True:
+            chunk = list(itertools.islice(records, self._chunk_size))
+            if not chunk:
+                return
+            yield chunk
+
+    def rewrite(self, edit_chunk) -> int:
+        """
+        Call edit_chunk on each chunk of records (a list of VariantRecord objects) and then
+        write the records to the output file. The records are modified in place.
+
+        Return the number of records written.
+        """
+        n = 0
+        with VariantFile(
+            self._out_file, mode="w", header=self._reader.header, threads=self._threads
+        ) as writer:
+            for chunk in self.chunks():
+                edit_chunk(chunk)
+                for record in chunk:
+                    writer.write(record)
+                n += len(chunk)
+        return n